@@ -1,11 +1,18 @@
 #include <iostream>
 #include <vector>
+#include <array>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <numeric>
 #include <memory>
+#include <list>
+#include <deque>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
+#include <string_view>
 #include <optional>
 #include <stdexcept>
 #include <iomanip>
@@ -14,55 +21,380 @@
 #include <chrono>
 #include <locale>
 #include <cctype>
+#include <cstdint>
+#include <cmath>
+#include <climits>
+#include <cstring>
+#include <charconv>
+#include <system_error>
+#include <cerrno>
+#include <csignal>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <filesystem>
+#include <type_traits>
+#include <queue>
+#include <tuple>
+#include <functional>
+#include <utility>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
-class TrieNode {
+class EscritorInstantanea;
+class LectorInstantanea;
+
+// Trie compacto (radix): cada nodo guarda un tramo de la palabra en un único
+// bloque de etiquetas y los hijos en un arreglo ordenado por su primer carácter.
+// Los nodos viven en un vector y se refieren por índice. Las búsquedas son
+// const y nunca crean nodos.
+//
+// Cada id lleva un peso (la popularidad) y cada nodo el mayor peso de su
+// subárbol, lo que permite sacar los k mejores de un prefijo sin recorrerlo entero.
+class TrieCompacto {
 public:
-    unordered_map<char, unique_ptr<TrieNode>> hijos;
-    vector<string> track_ids;
-    bool fin_palabra = false;
+    struct Entrada {
+        string palabra;
+        uint32_t id;
+        uint8_t peso;
+    };
+
+    TrieCompacto() : nodos(1) {}
+
+    void insertar(const string& palabra, uint32_t id, uint8_t peso = 0) {
+        insertar_minusculas(a_minusculas(palabra), id, peso);
+    }
+
+    // Inserción en lote. Con `ordenadas` se omite el ordenamiento (entradas ya
+    // ordenadas en minúsculas); así cada hijo nuevo queda al final de su arreglo.
+    void insertar_lote(vector<Entrada>& entradas, bool ordenadas = false) {
+        for (auto& entrada : entradas) {
+            entrada.palabra = a_minusculas(entrada.palabra);
+        }
+        if (!ordenadas) {
+            stable_sort(entradas.begin(), entradas.end(),
+                [](const Entrada& a, const Entrada& b) { return a.palabra < b.palabra; });
+        }
+        for (const auto& entrada : entradas) {
+            insertar_minusculas(entrada.palabra, entrada.id, entrada.peso);
+        }
+    }
+
+    // Quita el id de la palabra. Los nodos que quedan sin ids ni hijos se
+    // liberan y un nodo intermedio con un solo hijo se fusiona con él, así que
+    // el trie queda igual que si la palabra nunca se hubiera insertado.
+    bool eliminar(const string& palabra, uint32_t id) {
+        string buscada = a_minusculas(palabra);
+        vector<uint32_t> camino{0};
+        size_t i = 0;
+        while (i < buscada.size()) {
+            uint32_t hijo = buscar_hijo(camino.back(), static_cast<unsigned char>(buscada[i]));
+            if (hijo == SIN_NODO || nodos[hijo].largo > buscada.size() - i ||
+                etiquetas.compare(nodos[hijo].inicio, nodos[hijo].largo, buscada, i, nodos[hijo].largo) != 0) {
+                return false;
+            }
+            camino.push_back(hijo);
+            i += nodos[hijo].largo;
+        }
+        vector<uint32_t>& ids = nodos[camino.back()].ids;
+        auto it = find(ids.begin(), ids.end(), id);
+        if (it == ids.end()) {
+            return false;
+        }
+        ids.erase(it);
+
+        // Podar hacia arriba los nodos vacíos
+        while (camino.size() > 1 && nodos[camino.back()].ids.empty() &&
+               nodos[camino.back()].hijos.empty()) {
+            uint32_t nodo = camino.back();
+            camino.pop_back();
+            vector<uint32_t>& hermanos = nodos[camino.back()].hijos;
+            hermanos.erase(hermanos.begin() + posicion_hijo(camino.back(), primer_caracter(nodo)));
+            liberar(nodo);
+        }
+
+        // Un nodo sin ids con un único hijo se fusiona con él
+        uint32_t nodo = camino.back();
+        if (camino.size() > 1 && nodos[nodo].ids.empty() && nodos[nodo].hijos.size() == 1) {
+            uint32_t hijo = nodos[nodo].hijos[0];
+            if (nodos[nodo].inicio + nodos[nodo].largo != nodos[hijo].inicio) {
+                // Las etiquetas no son contiguas: se copia la unión al final
+                uint32_t inicio = static_cast<uint32_t>(etiquetas.size());
+                etiquetas.append(etiquetas, nodos[nodo].inicio, nodos[nodo].largo);
+                etiquetas.append(etiquetas, nodos[hijo].inicio, nodos[hijo].largo);
+                etiquetas_sin_uso += nodos[nodo].largo + nodos[hijo].largo;
+                nodos[nodo].inicio = inicio;
+            }
+            nodos[nodo].largo += nodos[hijo].largo;
+            nodos[nodo].hijos = move(nodos[hijo].hijos);
+            nodos[nodo].ids = move(nodos[hijo].ids);
+            nodos[hijo].largo = 0;  // su tramo ya forma parte de la etiqueta fusionada
+            liberar(hijo);
+        }
+
+        // Recalcular el mayor peso de los subárboles del camino
+        for (auto n = camino.rbegin(); n != camino.rend(); ++n) {
+            NodoTrie& actual = nodos[*n];
+            uint8_t mejor = 0;
+            for (uint32_t otro : actual.ids) {
+                mejor = max(mejor, pesos[otro]);
+            }
+            for (uint32_t hijo : actual.hijos) {
+                mejor = max(mejor, nodos[hijo].mejor);
+            }
+            actual.mejor = mejor;
+        }
 
-    void insertar(const string& palabra, const string& track_id) {
-        TrieNode* nodo_actual = this;
-        for (char c : palabra) {
-            c = tolower(c);
-            if (!nodo_actual->hijos[c]) {
-                nodo_actual->hijos[c] = make_unique<TrieNode>();
+        if (etiquetas_sin_uso > 4096 && etiquetas_sin_uso * 2 > etiquetas.size()) {
+            compactar_etiquetas();
+        }
+        return true;
+    }
+
+    // Ids de las palabras que empiezan por el prefijo, en orden alfabético
+    vector<uint32_t> buscar_prefijo(const string& prefijo) const {
+        uint32_t nodo = nodo_de_prefijo(a_minusculas(prefijo));
+        return nodo == SIN_NODO ? vector<uint32_t>() : recolectar_ids(nodo);
+    }
+
+    // Los k ids de mayor peso que empiezan por el prefijo, de mayor a menor.
+    // Recorrido de mejor primero: un nodo entra a la cola con el mayor peso de
+    // su subárbol y solo se expande al salir, así que el costo depende de k y
+    // no de cuántas palabras coinciden. `aceptar` descarta ids sin gastar cupo.
+    template <typename Filtro>
+    vector<uint32_t> buscar_top_k(const string& prefijo, size_t k, Filtro&& aceptar) const {
+        vector<uint32_t> resultados;
+        uint32_t inicio = nodo_de_prefijo(a_minusculas(prefijo));
+        if (inicio == SIN_NODO || k == 0) {
+            return resultados;
+        }
+
+        // (peso, es_nodo, índice): a igual peso salen antes los ids que los nodos
+        using Candidato = tuple<uint8_t, bool, uint32_t>;
+        auto peor = [](const Candidato& a, const Candidato& b) {
+            return get<0>(a) != get<0>(b) ? get<0>(a) < get<0>(b) : get<1>(a) && !get<1>(b);
+        };
+        priority_queue<Candidato, vector<Candidato>, decltype(peor)> cola(peor);
+        cola.emplace(nodos[inicio].mejor, true, inicio);
+        while (!cola.empty() && resultados.size() < k) {
+            auto [peso, es_nodo, indice] = cola.top();
+            cola.pop();
+            if (!es_nodo) {
+                if (aceptar(indice)) {
+                    resultados.push_back(indice);
+                }
+                continue;
+            }
+            const NodoTrie& n = nodos[indice];
+            for (uint32_t id : n.ids) {
+                cola.emplace(pesos[id], false, id);
+            }
+            for (uint32_t hijo : n.hijos) {
+                cola.emplace(nodos[hijo].mejor, true, hijo);
             }
-            nodo_actual = nodo_actual->hijos[c].get();
         }
-        nodo_actual->fin_palabra = true;
-        nodo_actual->track_ids.push_back(track_id);
+        return resultados;
+    }
+
+    vector<uint32_t> buscar_top_k(const string& prefijo, size_t k) const {
+        return buscar_top_k(prefijo, k, [](uint32_t) { return true; });
+    }
+
+    size_t total_nodos() const {
+        return nodos.size() - libres.size();
     }
 
-    vector<string> buscar_prefijo(const string& prefijo) {
-        TrieNode* nodo_actual = this;
-        for (char c : prefijo) {
-            c = tolower(c);
-            if (!nodo_actual->hijos[c]) return {};
-            nodo_actual = nodo_actual->hijos[c].get();
+    // Guarda los nodos ya armados para no reinsertar las palabras al abrir
+    // una instantánea. Definidas después de LectorInstantanea.
+    void guardar(EscritorInstantanea& escritor) const;
+    // Lanza runtime_error si el contenido no es un trie coherente o tiene
+    // algún id mayor o igual que `limite`
+    void cargar(LectorInstantanea& lector, size_t limite);
+
+    // Memoria reservada por el trie, en bytes
+    size_t memoria() const {
+        size_t bytes = nodos.capacity() * sizeof(NodoTrie) + etiquetas.capacity() + pesos.capacity();
+        for (const NodoTrie& n : nodos) {
+            bytes += (n.hijos.capacity() + n.ids.capacity()) * sizeof(uint32_t);
         }
-        return recolectar_ids(nodo_actual);
+        return bytes;
     }
 
 private:
-    vector<string> recolectar_ids(TrieNode* nodo) {
-        vector<string> resultados;
-        if (nodo->fin_palabra) {
-            resultados.insert(
-                resultados.end(), 
-                nodo->track_ids.begin(), 
-                nodo->track_ids.end()
-            );
-        }
-        for (auto& par : nodo->hijos) {
-            auto ids_hijo = recolectar_ids(par.second.get());
-            resultados.insert(
-                resultados.end(), 
-                ids_hijo.begin(), 
-                ids_hijo.end()
-            );
+    static constexpr uint32_t SIN_NODO = UINT32_MAX;
+
+    struct NodoTrie {
+        uint32_t inicio = 0;       // tramo de la palabra dentro de `etiquetas`
+        uint32_t largo = 0;
+        uint8_t mejor = 0;         // mayor peso del subárbol
+        vector<uint32_t> hijos;    // ordenados por su primer carácter
+        vector<uint32_t> ids;      // canciones cuya palabra termina aquí
+    };
+
+    vector<NodoTrie> nodos;        // nodos[0] es la raíz (etiqueta vacía)
+    vector<uint32_t> libres;       // posiciones de `nodos` para reutilizar
+    string etiquetas;
+    size_t etiquetas_sin_uso = 0;  // bytes de `etiquetas` que ya no usa ningún nodo
+    vector<uint8_t> pesos;         // peso de cada id
+
+    static string a_minusculas(const string& palabra) {
+        string resultado = palabra;
+        for (char& c : resultado) {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+        return resultado;
+    }
+
+    unsigned char primer_caracter(uint32_t nodo) const {
+        return static_cast<unsigned char>(etiquetas[nodos[nodo].inicio]);
+    }
+
+    // Posición del primer hijo cuyo primer carácter no es menor que c
+    size_t posicion_hijo(uint32_t nodo, unsigned char c) const {
+        const vector<uint32_t>& hijos = nodos[nodo].hijos;
+        return partition_point(hijos.begin(), hijos.end(), [&](uint32_t hijo) {
+            return primer_caracter(hijo) < c;
+        }) - hijos.begin();
+    }
+
+    uint32_t buscar_hijo(uint32_t nodo, unsigned char c) const {
+        size_t pos = posicion_hijo(nodo, c);
+        const vector<uint32_t>& hijos = nodos[nodo].hijos;
+        return pos < hijos.size() && primer_caracter(hijos[pos]) == c ? hijos[pos] : SIN_NODO;
+    }
+
+    // Nodo cuyo subárbol contiene exactamente las palabras con ese prefijo
+    // (el prefijo puede terminar a mitad de su etiqueta)
+    uint32_t nodo_de_prefijo(const string& buscado) const {
+        uint32_t nodo = 0;
+        size_t i = 0;
+        while (i < buscado.size()) {
+            uint32_t hijo = buscar_hijo(nodo, static_cast<unsigned char>(buscado[i]));
+            if (hijo == SIN_NODO) {
+                return SIN_NODO;
+            }
+            const NodoTrie& n = nodos[hijo];
+            size_t largo = min<size_t>(n.largo, buscado.size() - i);
+            if (etiquetas.compare(n.inicio, largo, buscado, i, largo) != 0) {
+                return SIN_NODO;
+            }
+            nodo = hijo;
+            i += largo;
+        }
+        return nodo;
+    }
+
+    uint32_t nuevo_nodo(uint32_t inicio, uint32_t largo) {
+        uint32_t nodo;
+        if (!libres.empty()) {
+            nodo = libres.back();
+            libres.pop_back();
+        } else {
+            nodo = static_cast<uint32_t>(nodos.size());
+            nodos.emplace_back();
+        }
+        nodos[nodo].inicio = inicio;
+        nodos[nodo].largo = largo;
+        return nodo;
+    }
+
+    void liberar(uint32_t nodo) {
+        etiquetas_sin_uso += nodos[nodo].largo;
+        nodos[nodo] = NodoTrie();
+        libres.push_back(nodo);
+    }
+
+    // Copia las etiquetas en uso a un bloque nuevo, sin los tramos liberados
+    void compactar_etiquetas() {
+        string compactas;
+        compactas.reserve(etiquetas.size() - etiquetas_sin_uso);
+        vector<uint32_t> pendientes{0};
+        while (!pendientes.empty()) {
+            NodoTrie& n = nodos[pendientes.back()];
+            pendientes.pop_back();
+            uint32_t inicio = static_cast<uint32_t>(compactas.size());
+            compactas.append(etiquetas, n.inicio, n.largo);
+            n.inicio = inicio;
+            pendientes.insert(pendientes.end(), n.hijos.begin(), n.hijos.end());
+        }
+        etiquetas = move(compactas);
+        etiquetas_sin_uso = 0;
+    }
+
+    void insertar_minusculas(const string& palabra, uint32_t id, uint8_t peso) {
+        if (id >= pesos.size()) {
+            pesos.resize(id + 1);
+        }
+        pesos[id] = peso;
+
+        uint32_t nodo = 0;
+        size_t i = 0;
+        while (true) {
+            nodos[nodo].mejor = max(nodos[nodo].mejor, peso);
+            if (i == palabra.size()) {
+                break;
+            }
+            unsigned char c = static_cast<unsigned char>(palabra[i]);
+            size_t pos = posicion_hijo(nodo, c);
+            if (pos == nodos[nodo].hijos.size() || primer_caracter(nodos[nodo].hijos[pos]) != c) {
+                // Resto de la palabra como hoja nueva
+                uint32_t hoja = nuevo_nodo(static_cast<uint32_t>(etiquetas.size()),
+                                           static_cast<uint32_t>(palabra.size() - i));
+                etiquetas.append(palabra, i, string::npos);
+                nodos[hoja].mejor = peso;
+                nodos[hoja].ids.push_back(id);
+                nodos[nodo].hijos.insert(nodos[nodo].hijos.begin() + pos, hoja);
+                return;
+            }
+
+            uint32_t hijo = nodos[nodo].hijos[pos];
+            uint32_t largo = nodos[hijo].largo;
+            uint32_t comun = 1;
+            while (comun < largo && i + comun < palabra.size() &&
+                   etiquetas[nodos[hijo].inicio + comun] == palabra[i + comun]) {
+                comun++;
+            }
+            if (comun < largo) {
+                // Dividir la etiqueta: el tramo común pasa a un nodo intermedio
+                uint32_t medio = nuevo_nodo(nodos[hijo].inicio, comun);
+                nodos[medio].mejor = nodos[hijo].mejor;
+                nodos[hijo].inicio += comun;
+                nodos[hijo].largo -= comun;
+                nodos[medio].hijos.push_back(hijo);
+                nodos[nodo].hijos[pos] = medio;
+                hijo = medio;
+            }
+            nodo = hijo;
+            i += comun;
+        }
+        nodos[nodo].ids.push_back(id);
+    }
+
+    // Recorrido en preorden con pila explícita; los hijos se apilan al revés
+    // para visitarlos en orden alfabético
+    vector<uint32_t> recolectar_ids(uint32_t inicio) const {
+        vector<uint32_t> resultados;
+        vector<uint32_t> pendientes{inicio};
+        while (!pendientes.empty()) {
+            const NodoTrie& n = nodos[pendientes.back()];
+            pendientes.pop_back();
+            resultados.insert(resultados.end(), n.ids.begin(), n.ids.end());
+            pendientes.insert(pendientes.end(), n.hijos.rbegin(), n.hijos.rend());
         }
         return resultados;
     }
@@ -118,657 +450,8185 @@ public:
     }
 };
 
-// Clase Nodo optimizada
-class Nodo {
+// Fila de canción sin copias: las cadenas apuntan a memoria ajena
+struct FilaCancion {
+    string_view artist_name;
+    string_view track_name;
+    string_view track_id;
+    int popularity = 0;
+    int anio = 0;
+    string_view genre;
+    float danceability = 0;
+    float energy = 0;
+    int key = 0;
+    float loudness = 0;
+    int mode = 0;
+    float speechiness = 0;
+    float acousticness = 0;
+    float instrumentalness = 0;
+    float liveness = 0;
+    float valence = 0;
+    float tempo = 0;
+    int duration_ms = 0;
+    int time_signature = 4;
+};
+
+// Archivo de solo lectura proyectado en memoria. Donde no hay mmap se lee
+// completo a un búfer, con la misma interfaz.
+class ArchivoMapeado {
 public:
-    vector<Cancion> canciones;
-    vector<unique_ptr<Nodo>> hijos;
-    const int tamano_maximo;
-    bool es_hoja;
+    explicit ArchivoMapeado(const string& file_path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(file_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("No se pudo abrir el archivo: " + file_path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw runtime_error("No se pudo leer el tamaño de: " + file_path);
+        }
+        tamano_ = static_cast<size_t>(info.st_size);
+        if (tamano_ > 0) {
+            void* mapa = mmap(nullptr, tamano_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapa == MAP_FAILED) {
+                close(fd);
+                throw runtime_error("No se pudo proyectar en memoria: " + file_path);
+            }
+            madvise(mapa, tamano_, MADV_SEQUENTIAL);
+            datos_ = static_cast<const char*>(mapa);
+        }
+        close(fd);
+#else
+        ifstream file(file_path, ios::binary | ios::ate);
+        if (!file.is_open()) {
+            throw runtime_error("No se pudo abrir el archivo: " + file_path);
+        }
+        tamano_ = static_cast<size_t>(file.tellg());
+        file.seekg(0, ios::beg);
+        bufer_.resize(tamano_);
+        file.read(bufer_.data(), tamano_);
+        datos_ = bufer_.data();
+#endif
+    }
 
-    explicit Nodo(int tam_max) : tamano_maximo(tam_max), es_hoja(true) {
-        canciones.reserve(tam_max);
-        hijos.reserve(tam_max + 1);
+    ~ArchivoMapeado() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (datos_) {
+            munmap(const_cast<char*>(datos_), tamano_);
+        }
+#endif
     }
 
-    void insertar_no_lleno(const Cancion& cancion) {
-        int i = static_cast<int>(canciones.size()) - 1;
+    ArchivoMapeado(const ArchivoMapeado&) = delete;
+    ArchivoMapeado& operator=(const ArchivoMapeado&) = delete;
 
-        if (es_hoja) {
-            while (i >= 0 && canciones[i] > cancion) {
-                i--;
-            }
-            canciones.insert(canciones.begin() + i + 1, cancion);
-        } else {
-            while (i >= 0 && canciones[i] > cancion) {
-                i--;
-            }
-            i++;
-            if (hijos[i]->canciones.size() == tamano_maximo) {
-                dividir_hijo(i);
-                if (cancion > canciones[i]) {
-                    i++;
-                }
-            }
-            hijos[i]->insertar_no_lleno(cancion);
+    const char* datos() const { return datos_; }
+    size_t tamano() const { return tamano_; }
+
+private:
+    const char* datos_ = nullptr;
+    size_t tamano_ = 0;
+#if !(defined(__unix__) || defined(__APPLE__))
+    vector<char> bufer_;
+#endif
+};
+
+// Suma de verificación de 64 bits sobre palabras de 8 bytes, con cuatro
+// carriles independientes para no encadenar todas las multiplicaciones
+class SumaVerificacion {
+public:
+    // `bytes` debe ser múltiplo de 8
+    void agregar(const char* datos, size_t bytes) {
+        for (size_t i = 0; i + 8 <= bytes; i += 8) {
+            uint64_t palabra;
+            memcpy(&palabra, datos + i, 8);
+            uint64_t& carril = carriles[palabras++ & 3];
+            carril = (carril ^ palabra) * 0x9E3779B97F4A7C15ULL;
+            carril ^= carril >> 29;
+        }
+    }
+
+    uint64_t valor() const {
+        uint64_t resultado = palabras;
+        for (uint64_t carril : carriles) {
+            resultado = (resultado ^ carril) * 0xC2B2AE3D27D4EB4FULL;
+            resultado ^= resultado >> 31;
         }
+        return resultado;
     }
 
-    void dividir_hijo(int indice) {
-        auto& hijo = hijos[indice];
-        auto nuevo_hijo = make_unique<Nodo>(tamano_maximo);
-        nuevo_hijo->es_hoja = hijo->es_hoja;
+private:
+    uint64_t carriles[4] = {1, 2, 3, 4};
+    uint64_t palabras = 0;
+};
 
-        // Mover la mitad de las canciones al nuevo hijo
-        int mitad = tamano_maximo / 2;
-        nuevo_hijo->canciones.assign(
-            make_move_iterator(hijo->canciones.begin() + mitad),
-            make_move_iterator(hijo->canciones.end())
-        );
-        hijo->canciones.resize(mitad);
+constexpr uint32_t VERSION_INSTANTANEA = 4;  // 3: time_signature se lee del CSV; 4: tries y filtros armados
+constexpr uint32_t MARCA_ORDEN_BYTES = 0x01020304;
+
+// Cabecera de una instantánea binaria. El contenido que sigue es una serie
+// de bloques [tamaño de 8 bytes][datos rellenados a múltiplo de 8].
+struct CabeceraInstantanea {
+    char magia[8];
+    uint32_t version;
+    uint32_t orden_bytes;
+    uint64_t tamano_csv;
+    int64_t modificacion_csv;
+    uint64_t tamano_contenido;
+    uint64_t suma_verificacion;
+};
+
+// Identifica la versión del CSV del que salió una instantánea
+struct FirmaArchivo {
+    uint64_t tamano = 0;
+    int64_t modificacion = 0;
+    bool existe = false;
+
+    bool misma(const FirmaArchivo& otra) const {
+        return existe == otra.existe && tamano == otra.tamano && modificacion == otra.modificacion;
+    }
+};
+
+FirmaArchivo firma_archivo(const string& file_path) {
+    FirmaArchivo firma;
+    error_code error;
+    auto tamano = filesystem::file_size(file_path, error);
+    if (error) {
+        return firma;
+    }
+    auto modificacion = filesystem::last_write_time(file_path, error);
+    if (error) {
+        return firma;
+    }
+    firma.tamano = tamano;
+    firma.modificacion = static_cast<int64_t>(modificacion.time_since_epoch().count());
+    firma.existe = true;
+    return firma;
+}
 
-        // Si no es hoja, mover también los hijos correspondientes
-        if (!hijo->es_hoja) {
-            nuevo_hijo->hijos.assign(
-                make_move_iterator(hijo->hijos.begin() + mitad),
-                make_move_iterator(hijo->hijos.end())
-            );
-            hijo->hijos.resize(mitad);
+class EscritorInstantanea {
+public:
+    EscritorInstantanea(const string& ruta, const FirmaArchivo& csv)
+        : ruta(ruta), archivo(ruta + ".tmp", ios::binary | ios::trunc) {
+        if (!archivo.is_open()) {
+            throw runtime_error("No se pudo crear la instantánea: " + ruta);
         }
+        memcpy(cabecera.magia, "GRCSNAP", 8);
+        cabecera.version = VERSION_INSTANTANEA;
+        cabecera.orden_bytes = MARCA_ORDEN_BYTES;
+        cabecera.tamano_csv = csv.tamano;
+        cabecera.modificacion_csv = csv.modificacion;
+        cabecera.tamano_contenido = 0;
+        cabecera.suma_verificacion = 0;
+        archivo.write(reinterpret_cast<const char*>(&cabecera), sizeof(cabecera));
+    }
 
-        // Insertar la canción del medio en el nodo actual
-        canciones.insert(canciones.begin() + indice, move(hijo->canciones.back()));
-        hijo->canciones.pop_back();
+    template <typename T>
+    void escribir_arreglo(const vector<T>& valores) {
+        static_assert(is_trivially_copyable<T>::value, "Solo tipos de tamaño fijo");
+        escribir_bloque(valores.data(), valores.size() * sizeof(T));
+    }
 
-        // Insertar el nuevo hijo
-        hijos.insert(hijos.begin() + indice + 1, move(nuevo_hijo));
+    template <typename T>
+    void escribir_valor(const T& valor) {
+        static_assert(is_trivially_copyable<T>::value, "Solo tipos de tamaño fijo");
+        escribir_bloque(&valor, sizeof(T));
     }
 
-    optional<Cancion> buscar(const string& track_id) const {
-        auto it = find_if(canciones.begin(), canciones.end(),
-            [&track_id](const Cancion& c) { return c.track_id == track_id; });
-        
-        if (it != canciones.end()) {
-            return *it;
+    // Completa la cabecera y reemplaza la instantánea anterior de forma atómica
+    void cerrar() {
+        cabecera.suma_verificacion = suma.valor();
+        archivo.seekp(0);
+        archivo.write(reinterpret_cast<const char*>(&cabecera), sizeof(cabecera));
+        archivo.close();
+        if (!archivo) {
+            throw runtime_error("No se pudo escribir la instantánea: " + ruta);
         }
+        filesystem::rename(ruta + ".tmp", ruta);
+    }
 
-        if (!es_hoja) {
-            for (const auto& hijo : hijos) {
-                auto resultado = hijo->buscar(track_id);
-                if (resultado.has_value()) {
-                    return resultado;
-                }
-            }
+private:
+    string ruta;
+    ofstream archivo;
+    CabeceraInstantanea cabecera;
+    SumaVerificacion suma;
+
+    void escribir_bloque(const void* datos, size_t bytes) {
+        uint64_t tamano = bytes;
+        emitir(reinterpret_cast<const char*>(&tamano), sizeof(tamano));
+        emitir(static_cast<const char*>(datos), bytes);
+    }
+
+    // Escribe y rellena con ceros hasta múltiplo de 8
+    void emitir(const char* datos, size_t bytes) {
+        archivo.write(datos, bytes);
+        size_t completos = bytes - bytes % 8;
+        suma.agregar(datos, completos);
+        if (completos < bytes) {
+            char ultima[8] = {};
+            memcpy(ultima, datos + completos, bytes - completos);
+            archivo.write(ultima + (bytes - completos), 8 - (bytes - completos));
+            suma.agregar(ultima, 8);
         }
+        cabecera.tamano_contenido += (bytes + 7) / 8 * 8;
+    }
+};
 
-        return nullopt;
+// Lee los bloques de una instantánea ya proyectada en memoria. Lanza
+// runtime_error si el contenido no tiene la forma esperada.
+class LectorInstantanea {
+public:
+    LectorInstantanea(const char* datos, size_t tamano) : actual(datos), fin(datos + tamano) {}
+
+    template <typename T>
+    void leer_arreglo(vector<T>& valores) {
+        static_assert(is_trivially_copyable<T>::value, "Solo tipos de tamaño fijo");
+        size_t bytes = leer_tamano();
+        if (bytes % sizeof(T) != 0) {
+            throw runtime_error("Instantánea corrupta");
+        }
+        valores.resize(bytes / sizeof(T));
+        if (bytes > 0) {
+            memcpy(valores.data(), actual, bytes);
+        }
+        avanzar(bytes);
     }
 
-    bool eliminar(const string& track_id) {
-        auto it = find_if(canciones.begin(), canciones.end(),
-            [&track_id](const Cancion& c) { return c.track_id == track_id; });
-        
-        if (it != canciones.end()) {
-            canciones.erase(it);
-            return true;
+    template <typename T>
+    void leer_valor(T& valor) {
+        static_assert(is_trivially_copyable<T>::value, "Solo tipos de tamaño fijo");
+        if (leer_tamano() != sizeof(T)) {
+            throw runtime_error("Instantánea corrupta");
         }
+        memcpy(&valor, actual, sizeof(T));
+        avanzar(sizeof(T));
+    }
 
-        if (!es_hoja) {
-            for (auto& hijo : hijos) {
-                if (hijo->eliminar(track_id)) {
-                    return true;
-                }
-            }
+private:
+    const char* actual;
+    const char* fin;
+
+    size_t leer_tamano() {
+        uint64_t bytes;
+        if (fin - actual < 8) {
+            throw runtime_error("Instantánea truncada");
+        }
+        memcpy(&bytes, actual, 8);
+        actual += 8;
+        if (bytes > static_cast<uint64_t>(fin - actual)) {
+            throw runtime_error("Instantánea truncada");
         }
+        return static_cast<size_t>(bytes);
+    }
 
-        return false;
+    void avanzar(size_t bytes) {
+        actual += min<size_t>((bytes + 7) / 8 * 8, fin - actual);
     }
 };
 
-vector<Cancion> cargar_csv_por_prefijo(const string& file_path, const string& prefijo, bool por_artista) {
-    vector<Cancion> canciones;
-    ifstream file(file_path, ios::binary);
-   
-    if (!file.is_open()) {
-        throw runtime_error("No se pudo abrir el archivo: " + file_path);
+// Cada nodo se guarda con sus campos fijos y cuántos hijos e ids tiene; los
+// hijos y los ids de todos los nodos van seguidos en dos arreglos
+struct NodoTrieGuardado {
+    uint32_t inicio;
+    uint32_t largo;
+    uint32_t hijos;
+    uint32_t ids;
+    uint8_t mejor;
+    uint8_t relleno[3];
+};
+
+void TrieCompacto::guardar(EscritorInstantanea& escritor) const {
+    vector<NodoTrieGuardado> planos(nodos.size());
+    vector<uint32_t> hijos;
+    vector<uint32_t> ids;
+    for (size_t i = 0; i < nodos.size(); ++i) {
+        const NodoTrie& n = nodos[i];
+        planos[i] = {n.inicio, n.largo, static_cast<uint32_t>(n.hijos.size()),
+                     static_cast<uint32_t>(n.ids.size()), n.mejor, {}};
+        hijos.insert(hijos.end(), n.hijos.begin(), n.hijos.end());
+        ids.insert(ids.end(), n.ids.begin(), n.ids.end());
     }
+    escritor.escribir_arreglo(planos);
+    escritor.escribir_arreglo(hijos);
+    escritor.escribir_arreglo(ids);
+    escritor.escribir_arreglo(libres);
+    escritor.escribir_arreglo(vector<char>(etiquetas.begin(), etiquetas.end()));
+    escritor.escribir_valor(static_cast<uint64_t>(etiquetas_sin_uso));
+    escritor.escribir_arreglo(pesos);
+}
 
-    string linea;
-    getline(file, linea); // Saltar encabezado
+void TrieCompacto::cargar(LectorInstantanea& lector, size_t limite) {
+    vector<NodoTrieGuardado> planos;
+    vector<uint32_t> hijos;
+    vector<uint32_t> ids;
+    vector<char> texto;
+    uint64_t sin_uso = 0;
+    TrieCompacto leido;
+    lector.leer_arreglo(planos);
+    lector.leer_arreglo(hijos);
+    lector.leer_arreglo(ids);
+    lector.leer_arreglo(leido.libres);
+    lector.leer_arreglo(texto);
+    lector.leer_valor(sin_uso);
+    lector.leer_arreglo(leido.pesos);
+
+    bool coherente = !planos.empty() && sin_uso <= texto.size();
+    size_t siguiente_hijo = 0;
+    size_t siguiente_id = 0;
+    leido.nodos.resize(planos.size());
+    for (size_t i = 0; coherente && i < planos.size(); ++i) {
+        const NodoTrieGuardado& plano = planos[i];
+        coherente = uint64_t{plano.inicio} + plano.largo <= texto.size() &&
+            plano.hijos <= hijos.size() - siguiente_hijo && plano.ids <= ids.size() - siguiente_id;
+        if (!coherente) {
+            break;
+        }
+        NodoTrie& n = leido.nodos[i];
+        n.inicio = plano.inicio;
+        n.largo = plano.largo;
+        n.mejor = plano.mejor;
+        n.hijos.assign(hijos.begin() + siguiente_hijo, hijos.begin() + siguiente_hijo + plano.hijos);
+        n.ids.assign(ids.begin() + siguiente_id, ids.begin() + siguiente_id + plano.ids);
+        siguiente_hijo += plano.hijos;
+        siguiente_id += plano.ids;
+        coherente = all_of(n.hijos.begin(), n.hijos.end(),
+                           [&](uint32_t hijo) { return hijo != 0 && hijo < planos.size(); }) &&
+            all_of(n.ids.begin(), n.ids.end(),
+                   [&](uint32_t id) { return id < leido.pesos.size() && id < limite; });
+    }
+    coherente = coherente && siguiente_hijo == hijos.size() && siguiente_id == ids.size() &&
+        all_of(leido.libres.begin(), leido.libres.end(),
+               [&](uint32_t nodo) { return nodo != 0 && nodo < planos.size(); });
+    if (!coherente) {
+        throw runtime_error("trie inconsistente");
+    }
+    leido.etiquetas.assign(texto.begin(), texto.end());
+    leido.etiquetas_sin_uso = sin_uso;
+    *this = move(leido);
+}
 
-    // Crear una localización para la conversión a minúsculas
-    std::locale loc;
+// Cadenas de longitud variable guardadas una tras otra en un único bloque
+class ColumnaCadenas {
+public:
+    vector<char> datos;
+    vector<uint32_t> desplazamientos{0};
 
-    while (getline(file, linea)) {
-        vector<string> campos;
-        size_t pos = 0;
-        size_t next_pos = 0;
-        while ((next_pos = linea.find(',', pos)) != string::npos) {
-            campos.push_back(linea.substr(pos, next_pos - pos));
-            pos = next_pos + 1;
+    uint32_t agregar(string_view texto) {
+        if (datos.size() + texto.size() > UINT32_MAX) {
+            throw length_error("La columna de cadenas supera los 4 GB");
         }
-        campos.push_back(linea.substr(pos));
+        datos.insert(datos.end(), texto.begin(), texto.end());
+        desplazamientos.push_back(static_cast<uint32_t>(datos.size()));
+        return static_cast<uint32_t>(desplazamientos.size() - 2);
+    }
 
-        // Verificar si comienza con el prefijo
-        string texto_busqueda = por_artista ? campos[1] : campos[2];
-       
-        // Convertir a minúsculas para búsqueda insensible a mayúsculas
-        transform(texto_busqueda.begin(), texto_busqueda.end(), texto_busqueda.begin(),
-                  [&loc](char c) { return std::tolower(c, loc); });
-        string prefijo_lower = prefijo;
-        transform(prefijo_lower.begin(), prefijo_lower.end(), prefijo_lower.begin(),
-                  [&loc](char c) { return std::tolower(c, loc); });
-
-        // Solo agregar si comienza con el prefijo
-        if (texto_busqueda.substr(0, prefijo_lower.length()) == prefijo_lower) {
-            try {
-                auto safe_stoi = [](const string& s) {
-                    return s.empty() ? 0 : stoi(s);
-                };
-
-                auto safe_stof = [](const string& s) {
-                    return s.empty() ? 0.0f : stof(s);
-                };
-
-                canciones.emplace_back(
-                    move(campos[1]), // artist_name
-                    move(campos[2]), // track_name
-                    move(campos[3]), // track_id
-                    safe_stoi(campos[4]), // popularity
-                    safe_stoi(campos[5]), // anio
-                    move(campos[6]), // genre
-                    safe_stof(campos[7]), // danceability
-                    safe_stof(campos[8]), // energy
-                    safe_stoi(campos[9]), // key
-                    safe_stof(campos[10]), // loudness
-                    safe_stoi(campos[11]), // mode
-                    safe_stof(campos[12]), // speechiness
-                    safe_stof(campos[13]), // acousticness
-                    safe_stof(campos[14]), // instrumentalness
-                    safe_stof(campos[15]), // liveness
-                    safe_stof(campos[16]), // valence
-                    safe_stof(campos[17]), // tempo
-                    safe_stoi(campos[18]), // duration_ms
-                    4 // default time_signature
-                );
-            } catch (const exception& e) {
-                // Ignorar errores de conversión
-            }
-        }
+    string_view obtener(uint32_t i) const {
+        return string_view(datos.data() + desplazamientos[i],
+                           desplazamientos[i + 1] - desplazamientos[i]);
     }
 
-    return canciones;
-}
+    size_t size() const {
+        return desplazamientos.size() - 1;
+    }
 
-// Clase BTree optimizada
-class BTree {
-public:
-    unique_ptr<Nodo> raiz;
-    const int tamano_maximo;
-    unordered_map<string, size_t> indice_por_id;
+    void anexar(const ColumnaCadenas& otra) {
+        size_t base = datos.size();
+        if (base + otra.datos.size() > UINT32_MAX) {
+            throw length_error("La columna de cadenas supera los 4 GB");
+        }
+        datos.insert(datos.end(), otra.datos.begin(), otra.datos.end());
+        desplazamientos.reserve(desplazamientos.size() + otra.size());
+        for (size_t i = 1; i < otra.desplazamientos.size(); ++i) {
+            desplazamientos.push_back(static_cast<uint32_t>(base + otra.desplazamientos[i]));
+        }
+    }
 
-    explicit BTree(int tam_max) : tamano_maximo(tam_max) {
-        raiz = make_unique<Nodo>(tam_max);
+    void reservar(size_t cadenas, size_t bytes) {
+        desplazamientos.reserve(cadenas + 1);
+        datos.reserve(bytes);
     }
 
-    void insertar(const Cancion& cancion) {
-        if (raiz->canciones.size() == tamano_maximo) {
-            auto nuevo_raiz = make_unique<Nodo>(tamano_maximo);
-            nuevo_raiz->es_hoja = false;
-            nuevo_raiz->hijos.push_back(move(raiz));
-            raiz = move(nuevo_raiz);
-            raiz->dividir_hijo(0);
+    void guardar(EscritorInstantanea& escritor) const {
+        escritor.escribir_arreglo(datos);
+        escritor.escribir_arreglo(desplazamientos);
+    }
+
+    void cargar(LectorInstantanea& lector) {
+        lector.leer_arreglo(datos);
+        lector.leer_arreglo(desplazamientos);
+        if (desplazamientos.empty() || desplazamientos.front() != 0 ||
+            desplazamientos.back() != datos.size()) {
+            throw runtime_error("Instantánea corrupta");
         }
-        raiz->insertar_no_lleno(cancion);
-        indice_por_id[cancion.track_id] = indice_por_id.size();
     }
+};
+
+// Tabla hash de direccionamiento abierto que guarda ids de 32 bits.
+// No almacena texto: `clave_de(id)` devuelve la cadena de cada id.
+class TablaIds {
+public:
+    static constexpr uint32_t VACIA = UINT32_MAX;
+    static constexpr uint32_t BORRADA = UINT32_MAX - 1;
 
-    bool eliminar(const string& track_id) {
-        bool resultado = raiz->eliminar(track_id);
-        if (resultado) {
-            indice_por_id.erase(track_id);
+    template <typename ClaveDe>
+    uint32_t buscar(string_view clave, const ClaveDe& clave_de) const {
+        if (ranuras.empty()) {
+            return VACIA;
+        }
+        size_t mascara = ranuras.size() - 1;
+        for (size_t i = hash<string_view>{}(clave) & mascara;; i = (i + 1) & mascara) {
+            uint32_t id = ranuras[i];
+            if (id == VACIA) {
+                return VACIA;
+            }
+            if (id != BORRADA && clave_de(id) == clave) {
+                return id;
+            }
         }
-        return resultado;
     }
 
-    optional<Cancion> buscar(const string& track_id) const {
-        return raiz->buscar(track_id);
+    // El id no debe estar ya en la tabla
+    template <typename ClaveDe>
+    void insertar(uint32_t id, const ClaveDe& clave_de) {
+        if ((usadas + 1) * 4 > ranuras.size() * 3) {
+            rehacer(ocupadas + 1, clave_de);
+        }
+        colocar(id, clave_de(id));
     }
 
-    void mover_cancion(const string& track_id, size_t nueva_posicion) {
-        auto cancion_opt = buscar(track_id);
-        if (!cancion_opt) {
-            throw runtime_error("Canción no encontrada");
+    // Inserta id_nuevo con la clave dada salvo que ya exista; en ese caso
+    // devuelve el id existente (VACIA si se insertó). Un solo sondeo.
+    template <typename ClaveDe>
+    uint32_t insertar_si_ausente(string_view clave, uint32_t id_nuevo, const ClaveDe& clave_de) {
+        if ((usadas + 1) * 4 > ranuras.size() * 3) {
+            rehacer(ocupadas + 1, clave_de);
+        }
+        size_t mascara = ranuras.size() - 1;
+        size_t libre = SIZE_MAX;
+        for (size_t i = hash<string_view>{}(clave) & mascara;; i = (i + 1) & mascara) {
+            uint32_t id = ranuras[i];
+            if (id == VACIA) {
+                if (libre == SIZE_MAX) {
+                    libre = i;
+                    usadas++;
+                }
+                break;
+            }
+            if (id == BORRADA) {
+                if (libre == SIZE_MAX) {
+                    libre = i;
+                }
+            } else if (clave_de(id) == clave) {
+                return id;
+            }
         }
+        ranuras[libre] = id_nuevo;
+        ocupadas++;
+        return VACIA;
+    }
 
-        if (nueva_posicion >= indice_por_id.size()) {
-            throw runtime_error("Posición inválida");
+    template <typename ClaveDe>
+    bool borrar(string_view clave, const ClaveDe& clave_de) {
+        if (ranuras.empty()) {
+            return false;
+        }
+        size_t mascara = ranuras.size() - 1;
+        for (size_t i = hash<string_view>{}(clave) & mascara;; i = (i + 1) & mascara) {
+            uint32_t id = ranuras[i];
+            if (id == VACIA) {
+                return false;
+            }
+            if (id != BORRADA && clave_de(id) == clave) {
+                ranuras[i] = BORRADA;
+                ocupadas--;
+                return true;
+            }
         }
+    }
 
-        eliminar(track_id);
-        insertar(cancion_opt.value());
-        // Actualizar índices
-        size_t idx = 0;
-        for (const auto& cancion : listar()) {
-            indice_por_id[cancion.track_id] = idx++;
+    template <typename ClaveDe>
+    void reservar(size_t cantidad, const ClaveDe& clave_de) {
+        if (cantidad * 4 > ranuras.size() * 3) {
+            rehacer(cantidad, clave_de);
         }
     }
 
-    vector<Cancion> listar() const {
-        vector<Cancion> resultado;
-        resultado.reserve(indice_por_id.size());
-        _listar(raiz.get(), resultado);
-        return resultado;
+    size_t size() const {
+        return ocupadas;
     }
 
-    vector<Cancion> listar_por_popularidad(bool ascendente = true) const {
-        auto canciones = listar();
-        sort(canciones.begin(), canciones.end(),
-            [ascendente](const Cancion& a, const Cancion& b) {
-                return ascendente ? 
-                    a.popularity < b.popularity : 
-                    a.popularity > b.popularity;
-            });
-        return canciones;
+    void limpiar() {
+        ranuras.clear();
+        ocupadas = 0;
+        usadas = 0;
     }
 
-    vector<Cancion> obtener_por_anio(int anio) const {
-        vector<Cancion> resultado;
-        auto todas = listar();
-        copy_if(todas.begin(), todas.end(), back_inserter(resultado),
-            [anio](const Cancion& c) { return c.anio == anio; });
-        return resultado;
+    // Se guarda la tabla tal cual: al abrirla no hay que recalcular hashes
+    void guardar(EscritorInstantanea& escritor) const {
+        escritor.escribir_arreglo(ranuras);
+        escritor.escribir_valor(static_cast<uint64_t>(ocupadas));
+        escritor.escribir_valor(static_cast<uint64_t>(usadas));
     }
 
-    vector<Cancion> listar_por_duracion(bool ascendente = true) const {
-        auto canciones = listar();
-        sort(canciones.begin(), canciones.end(),
-            [ascendente](const Cancion& a, const Cancion& b) {
-                return ascendente ? 
-                    a.duration_ms < b.duration_ms : 
-                    a.duration_ms > b.duration_ms;
-            });
-        return canciones;
+    void cargar(LectorInstantanea& lector) {
+        uint64_t ocupadas_leidas = 0;
+        uint64_t usadas_leidas = 0;
+        lector.leer_arreglo(ranuras);
+        lector.leer_valor(ocupadas_leidas);
+        lector.leer_valor(usadas_leidas);
+        if ((ranuras.size() & (ranuras.size() - 1)) != 0 || usadas_leidas >= ranuras.size() + 1) {
+            throw runtime_error("Instantánea corrupta");
+        }
+        ocupadas = ocupadas_leidas;
+        usadas = usadas_leidas;
     }
 
 private:
-    void _listar(const Nodo* nodo, vector<Cancion>& resultado) const {
-        if (!nodo) return;
-
-        for (size_t i = 0; i < nodo->canciones.size(); i++) {
-            if (!nodo->es_hoja && i < nodo->hijos.size()) {
-                _listar(nodo->hijos[i].get(), resultado);
-            }
-            resultado.push_back(nodo->canciones[i]);
+    vector<uint32_t> ranuras;
+    size_t ocupadas = 0;  // ids presentes
+    size_t usadas = 0;    // ids presentes + ranuras borradas
+
+    void colocar(uint32_t id, string_view clave) {
+        size_t mascara = ranuras.size() - 1;
+        size_t i = hash<string_view>{}(clave) & mascara;
+        while (ranuras[i] != VACIA && ranuras[i] != BORRADA) {
+            i = (i + 1) & mascara;
+        }
+        if (ranuras[i] == VACIA) {
+            usadas++;
         }
+        ranuras[i] = id;
+        ocupadas++;
+    }
 
-        if (!nodo->es_hoja && !nodo->hijos.empty()) {
-            _listar(nodo->hijos.back().get(), resultado);
+    // Redimensiona (y descarta las ranuras borradas) para `cantidad` ids
+    template <typename ClaveDe>
+    void rehacer(size_t cantidad, const ClaveDe& clave_de) {
+        size_t capacidad = 16;
+        while (capacidad * 3 < cantidad * 4 + 4) {
+            capacidad *= 2;
+        }
+        vector<uint32_t> anteriores = move(ranuras);
+        ranuras.assign(capacidad, VACIA);
+        ocupadas = 0;
+        usadas = 0;
+        for (uint32_t id : anteriores) {
+            if (id != VACIA && id != BORRADA) {
+                colocar(id, clave_de(id));
+            }
         }
     }
 };
 
-// Clase ListaReproduccion combinada
-class ListaReproduccion {
+// Diccionario de cadenas internadas: cada texto distinto se guarda una sola vez
+class DiccionarioCadenas {
 public:
-    BTree bTree;
-    TrieNode trie_artistas;
-    TrieNode trie_canciones;
-    size_t total_canciones;
-    vector<Cancion> csv_canciones;
-
-    explicit ListaReproduccion(int tamano_maximo = 3) 
-        : bTree(tamano_maximo), total_canciones(0) {}
-
-    // New method to find songs in the loaded CSV data
-    vector<Cancion> buscar_canciones_por_prefijo_en_csv(const string& prefijo, bool por_artista = false) {
-        string file_path = "spotify_data.csv";
-       
-        try {
-            return cargar_csv_por_prefijo(file_path, prefijo, por_artista);
-        } catch (const runtime_error& e) {
-            cerr << e.what() << '\n';
-            return {};
+    uint32_t internar(string_view texto) {
+        auto clave_de = [this](uint32_t id) { return cadenas.obtener(id); };
+        uint32_t id = tabla.buscar(texto, clave_de);
+        if (id == TablaIds::VACIA) {
+            id = cadenas.agregar(texto);
+            tabla.insertar(id, clave_de);
         }
+        return id;
     }
 
-    void agregar_cancion(const Cancion& cancion) {
-        bTree.insertar(cancion);
-        trie_artistas.insertar(cancion.artist_name, cancion.track_id);
-        trie_canciones.insertar(cancion.track_name, cancion.track_id);
-        total_canciones++;
+    // TablaIds::VACIA si la cadena no está
+    uint32_t buscar(string_view texto) const {
+        return tabla.buscar(texto, [this](uint32_t id) { return cadenas.obtener(id); });
     }
 
-    vector<Cancion> listar_canciones() const {
-        return bTree.listar();
+    string_view obtener(uint32_t id) const {
+        return cadenas.obtener(id);
     }
 
-    vector<Cancion> listar_por_popularidad(bool ascendente = true) const {
-        return bTree.listar_por_popularidad(ascendente);
+    size_t size() const {
+        return cadenas.size();
     }
 
-    vector<Cancion> obtener_por_anio(int anio) const {
-        return bTree.obtener_por_anio(anio);
+    void guardar(EscritorInstantanea& escritor) const {
+        cadenas.guardar(escritor);
+        tabla.guardar(escritor);
     }
 
-    bool eliminar_cancion(const string& track_id) {
-        if (bTree.eliminar(track_id)) {
-            total_canciones--;
-            return true;
-        }
-        return false;
+    void cargar(LectorInstantanea& lector) {
+        cadenas.cargar(lector);
+        tabla.cargar(lector);
     }
 
-    void reproducir_aleatoria() const {
-        auto canciones = listar_canciones();
-        if (canciones.empty()) {
-            cout << "La lista de reproducción está vacía." << endl;
-            return;
-        }
-        
-        srand(static_cast<unsigned>(time(nullptr)));
-        int indice_aleatorio = rand() % canciones.size();
-        const Cancion& cancion = canciones[indice_aleatorio];
-        
-        cout << "Reproduciendo: " << cancion.track_name 
-             << " - " << cancion.artist_name << endl;
-    }
-    
-        // En la clase ListaReproduccion
+private:
+    ColumnaCadenas cadenas;
+    TablaIds tabla;
+};
 
-    vector<Cancion> buscar_canciones_por_trie(const string& prefijo, bool por_artista = false) {
-        vector<Cancion> resultados_playlist;
-        TrieNode& trie = por_artista ? trie_artistas : trie_canciones;
+// Catálogo de canciones por columnas (estructura de arreglos). Cada canción
+// se identifica con un id de 32 bits que indexa todas las columnas; artistas
+// y géneros se guardan internados y las demás cadenas en bloques contiguos.
+class CatalogoColumnar {
+    // Resuelve el track_id de un id para la tabla hash del índice
+    struct ClaveTrackId {
+        const ColumnaCadenas* columna;
+        string_view operator()(uint32_t id) const { return columna->obtener(id); }
+    };
 
-        // Obtener IDs de canciones usando el Trie
-        vector<string> track_ids = trie.buscar_prefijo(prefijo);
+public:
+    static constexpr uint32_t SIN_CANCION = UINT32_MAX;
+
+    // Columnas numéricas
+    vector<uint8_t> popularity;
+    vector<int16_t> anio;
+    vector<float> danceability;
+    vector<float> energy;
+    vector<int8_t> key;
+    vector<float> loudness;
+    vector<int8_t> mode;
+    vector<float> speechiness;
+    vector<float> acousticness;
+    vector<float> instrumentalness;
+    vector<float> liveness;
+    vector<float> valence;
+    vector<float> tempo;
+    vector<int32_t> duration_ms;
+    vector<int8_t> time_signature;
+
+    // Columnas de texto
+    vector<uint32_t> artista;  // id en `artistas`
+    vector<uint32_t> genero;   // id en `generos`
+    ColumnaCadenas nombres;    // track_name
+    ColumnaCadenas ids_pista;  // track_id
+    DiccionarioCadenas artistas;
+    DiccionarioCadenas generos;
+
+    // 0 para las canciones eliminadas (su id no se reutiliza hasta compactar)
+    vector<uint8_t> vivo;
+
+    // Índice track_id -> id de canción (solo canciones vivas)
+    TablaIds indice_por_id;
+
+    // true si cada valor entero de la fila cabe en el tipo de su columna
+    static bool cabe_en_columnas(const FilaCancion& fila) {
+        auto cabe = [](int valor, auto tipo) {
+            using T = decltype(tipo);
+            return valor >= numeric_limits<T>::min() && valor <= numeric_limits<T>::max();
+        };
+        return cabe(fila.popularity, uint8_t{}) && cabe(fila.anio, int16_t{}) &&
+               cabe(fila.key, int8_t{}) && cabe(fila.mode, int8_t{}) &&
+               cabe(fila.time_signature, int8_t{});
+    }
 
-        for (const auto& track_id : track_ids) {
-            auto cancion = bTree.buscar(track_id);
-            if (cancion) {
-                // Verificar si la cadena comienza exactamente con el prefijo
-                bool cumple_prefijo = por_artista ?
-                    (cancion->artist_name.substr(0, prefijo.length()) == prefijo) :
-                    (cancion->track_name.substr(0, prefijo.length()) == prefijo);
+    // El track_id de la fila no debe estar ya en el catálogo. Lanza
+    // out_of_range, sin agregar nada, si algún valor no cabe en su columna.
+    uint32_t agregar(const FilaCancion& fila) {
+        comprobar_rangos(fila);
+        uint32_t id = agregar_columnas(fila);
+        indice_por_id.insertar(id, clave_track_id());
+        return id;
+    }
 
-                if (cumple_prefijo) {
-                    resultados_playlist.push_back(*cancion);
-                }
-            }
+    // Agrega la fila solo si su track_id no está; si no, devuelve SIN_CANCION.
+    // Lanza out_of_range como agregar.
+    uint32_t agregar_si_nueva(const FilaCancion& fila) {
+        comprobar_rangos(fila);
+        uint32_t id = static_cast<uint32_t>(vivo.size());
+        if (indice_por_id.insertar_si_ausente(fila.track_id, id, clave_track_id()) != TablaIds::VACIA) {
+            return SIN_CANCION;
         }
+        return agregar_columnas(fila);
+    }
 
-        return resultados_playlist;
+    uint32_t agregar(const Cancion& cancion) {
+        return agregar(fila_de(cancion));
+    }
+
+    uint32_t agregar_si_nueva(const Cancion& cancion) {
+        return agregar_si_nueva(fila_de(cancion));
+    }
+
+    static FilaCancion fila_de(const Cancion& cancion) {
+        FilaCancion fila;
+        fila.artist_name = cancion.artist_name;
+        fila.track_name = cancion.track_name;
+        fila.track_id = cancion.track_id;
+        fila.popularity = cancion.popularity;
+        fila.anio = cancion.anio;
+        fila.genre = cancion.genre;
+        fila.danceability = cancion.danceability;
+        fila.energy = cancion.energy;
+        fila.key = cancion.key;
+        fila.loudness = cancion.loudness;
+        fila.mode = cancion.mode;
+        fila.speechiness = cancion.speechiness;
+        fila.acousticness = cancion.acousticness;
+        fila.instrumentalness = cancion.instrumentalness;
+        fila.liveness = cancion.liveness;
+        fila.valence = cancion.valence;
+        fila.tempo = cancion.tempo;
+        fila.duration_ms = cancion.duration_ms;
+        fila.time_signature = cancion.time_signature;
+        return fila;
+    }
+
+    void eliminar(uint32_t id) {
+        if (id < vivo.size() && vivo[id]) {
+            indice_por_id.borrar(track_id(id), clave_track_id());
+            vivo[id] = 0;
+            vivas--;
+        }
+    }
+
+    // Id de la canción viva con ese track_id, o SIN_CANCION
+    uint32_t buscar_id(string_view track_id) const {
+        uint32_t id = indice_por_id.buscar(track_id, clave_track_id());
+        return id == TablaIds::VACIA ? SIN_CANCION : id;
+    }
+
+    bool esta_viva(uint32_t id) const {
+        return id < vivo.size() && vivo[id];
+    }
+
+    string_view track_name(uint32_t id) const { return nombres.obtener(id); }
+    string_view track_id(uint32_t id) const { return ids_pista.obtener(id); }
+    string_view artist_name(uint32_t id) const { return artistas.obtener(artista[id]); }
+    string_view genre(uint32_t id) const { return generos.obtener(genero[id]); }
+
+    // Orden del árbol: por track_name
+    bool mayor(uint32_t a, uint32_t b) const {
+        return track_name(a) > track_name(b);
+    }
+
+    // Vista de la fila sin copiar cadenas (válida mientras el catálogo no cambie)
+    FilaCancion fila(uint32_t id) const {
+        FilaCancion f;
+        f.artist_name = artist_name(id);
+        f.track_name = track_name(id);
+        f.track_id = track_id(id);
+        f.popularity = popularity[id];
+        f.anio = anio[id];
+        f.genre = genre(id);
+        f.danceability = danceability[id];
+        f.energy = energy[id];
+        f.key = key[id];
+        f.loudness = loudness[id];
+        f.mode = mode[id];
+        f.speechiness = speechiness[id];
+        f.acousticness = acousticness[id];
+        f.instrumentalness = instrumentalness[id];
+        f.liveness = liveness[id];
+        f.valence = valence[id];
+        f.tempo = tempo[id];
+        f.duration_ms = duration_ms[id];
+        f.time_signature = time_signature[id];
+        return f;
+    }
+
+    // Reconstruye una Cancion completa (solo para mostrarla o exportarla)
+    Cancion obtener(uint32_t id) const {
+        return Cancion(
+            string(artist_name(id)), string(track_name(id)), string(track_id(id)),
+            popularity[id], anio[id], string(genre(id)), danceability[id],
+            energy[id], key[id], loudness[id], mode[id], speechiness[id],
+            acousticness[id], instrumentalness[id], liveness[id], valence[id],
+            tempo[id], duration_ms[id], time_signature[id]
+        );
+    }
+
+    void reservar(size_t cantidad) {
+        popularity.reserve(cantidad);
+        anio.reserve(cantidad);
+        danceability.reserve(cantidad);
+        energy.reserve(cantidad);
+        key.reserve(cantidad);
+        loudness.reserve(cantidad);
+        mode.reserve(cantidad);
+        speechiness.reserve(cantidad);
+        acousticness.reserve(cantidad);
+        instrumentalness.reserve(cantidad);
+        liveness.reserve(cantidad);
+        valence.reserve(cantidad);
+        tempo.reserve(cantidad);
+        duration_ms.reserve(cantidad);
+        time_signature.reserve(cantidad);
+        artista.reserve(cantidad);
+        genero.reserve(cantidad);
+        nombres.reservar(cantidad, cantidad * 20);
+        ids_pista.reservar(cantidad, cantidad * 22);
+        vivo.reserve(cantidad);
+        indice_por_id.reservar(cantidad, clave_track_id());
+    }
+
+    // Agrega al final todas las filas de otro catálogo, traduciendo los ids de
+    // artistas y géneros. Las filas cuyo track_id ya estaba quedan eliminadas;
+    // devuelve cuántas fueron.
+    size_t anexar(const CatalogoColumnar& otro) {
+        uint32_t base = static_cast<uint32_t>(size());
+        auto concatenar = [](auto& destino, const auto& origen) {
+            destino.insert(destino.end(), origen.begin(), origen.end());
+        };
+        concatenar(popularity, otro.popularity);
+        concatenar(anio, otro.anio);
+        concatenar(danceability, otro.danceability);
+        concatenar(energy, otro.energy);
+        concatenar(key, otro.key);
+        concatenar(loudness, otro.loudness);
+        concatenar(mode, otro.mode);
+        concatenar(speechiness, otro.speechiness);
+        concatenar(acousticness, otro.acousticness);
+        concatenar(instrumentalness, otro.instrumentalness);
+        concatenar(liveness, otro.liveness);
+        concatenar(valence, otro.valence);
+        concatenar(tempo, otro.tempo);
+        concatenar(duration_ms, otro.duration_ms);
+        concatenar(time_signature, otro.time_signature);
+
+        auto traducir = [](DiccionarioCadenas& destino, const DiccionarioCadenas& origen,
+                           vector<uint32_t>& columna, const vector<uint32_t>& ids) {
+            vector<uint32_t> traduccion(origen.size());
+            for (uint32_t i = 0; i < origen.size(); ++i) {
+                traduccion[i] = destino.internar(origen.obtener(i));
+            }
+            columna.reserve(columna.size() + ids.size());
+            for (uint32_t id : ids) {
+                columna.push_back(traduccion[id]);
+            }
+        };
+        traducir(artistas, otro.artistas, artista, otro.artista);
+        traducir(generos, otro.generos, genero, otro.genero);
+        nombres.anexar(otro.nombres);
+        ids_pista.anexar(otro.ids_pista);
+
+        size_t repetidas = 0;
+        indice_por_id.reservar(vivas + otro.vivas, clave_track_id());
+        vivo.reserve(vivo.size() + otro.size());
+        for (uint32_t i = 0; i < otro.size(); ++i) {
+            uint32_t id = base + i;
+            bool nueva = otro.vivo[i] &&
+                indice_por_id.insertar_si_ausente(track_id(id), id, clave_track_id()) == TablaIds::VACIA;
+            if (otro.vivo[i] && !nueva) {
+                repetidas++;
+            }
+            vivo.push_back(nueva ? 1 : 0);
+            vivas += nueva ? 1 : 0;
+        }
+        return repetidas;
+    }
+
+    // Copia solo las filas vivas, con ids consecutivos
+    CatalogoColumnar compactado() const {
+        CatalogoColumnar copia;
+        copia.reservar(vivas);
+        for (uint32_t id = 0; id < size(); ++id) {
+            if (vivo[id]) {
+                copia.agregar(fila(id));
+            }
+        }
+        return copia;
+    }
+
+    void guardar(EscritorInstantanea& escritor) const {
+        escritor.escribir_arreglo(popularity);
+        escritor.escribir_arreglo(anio);
+        escritor.escribir_arreglo(danceability);
+        escritor.escribir_arreglo(energy);
+        escritor.escribir_arreglo(key);
+        escritor.escribir_arreglo(loudness);
+        escritor.escribir_arreglo(mode);
+        escritor.escribir_arreglo(speechiness);
+        escritor.escribir_arreglo(acousticness);
+        escritor.escribir_arreglo(instrumentalness);
+        escritor.escribir_arreglo(liveness);
+        escritor.escribir_arreglo(valence);
+        escritor.escribir_arreglo(tempo);
+        escritor.escribir_arreglo(duration_ms);
+        escritor.escribir_arreglo(time_signature);
+        escritor.escribir_arreglo(artista);
+        escritor.escribir_arreglo(genero);
+        nombres.guardar(escritor);
+        ids_pista.guardar(escritor);
+        artistas.guardar(escritor);
+        generos.guardar(escritor);
+        escritor.escribir_arreglo(vivo);
+        indice_por_id.guardar(escritor);
+    }
+
+    void cargar(LectorInstantanea& lector) {
+        lector.leer_arreglo(popularity);
+        lector.leer_arreglo(anio);
+        lector.leer_arreglo(danceability);
+        lector.leer_arreglo(energy);
+        lector.leer_arreglo(key);
+        lector.leer_arreglo(loudness);
+        lector.leer_arreglo(mode);
+        lector.leer_arreglo(speechiness);
+        lector.leer_arreglo(acousticness);
+        lector.leer_arreglo(instrumentalness);
+        lector.leer_arreglo(liveness);
+        lector.leer_arreglo(valence);
+        lector.leer_arreglo(tempo);
+        lector.leer_arreglo(duration_ms);
+        lector.leer_arreglo(time_signature);
+        lector.leer_arreglo(artista);
+        lector.leer_arreglo(genero);
+        nombres.cargar(lector);
+        ids_pista.cargar(lector);
+        artistas.cargar(lector);
+        generos.cargar(lector);
+        lector.leer_arreglo(vivo);
+        indice_por_id.cargar(lector);
+
+        size_t n = vivo.size();
+        bool tamanos_ok =
+            popularity.size() == n && anio.size() == n && danceability.size() == n &&
+            energy.size() == n && key.size() == n && loudness.size() == n &&
+            mode.size() == n && speechiness.size() == n && acousticness.size() == n &&
+            instrumentalness.size() == n && liveness.size() == n && valence.size() == n &&
+            tempo.size() == n && duration_ms.size() == n && time_signature.size() == n &&
+            artista.size() == n && genero.size() == n && nombres.size() == n &&
+            ids_pista.size() == n;
+        bool ids_ok = all_of(artista.begin(), artista.end(),
+                             [this](uint32_t a) { return a < artistas.size(); }) &&
+                      all_of(genero.begin(), genero.end(),
+                             [this](uint32_t g) { return g < generos.size(); });
+        if (!tamanos_ok || !ids_ok) {
+            throw runtime_error("Instantánea corrupta");
+        }
+        vivas = static_cast<size_t>(count(vivo.begin(), vivo.end(), 1));
+    }
+
+    // Cantidad de ids asignados (incluye eliminados)
+    size_t size() const {
+        return vivo.size();
+    }
+
+    size_t total_vivas() const {
+        return vivas;
+    }
+
+private:
+    size_t vivas = 0;
+
+    ClaveTrackId clave_track_id() const {
+        return {&ids_pista};
+    }
+
+    static void comprobar_rangos(const FilaCancion& fila) {
+        if (!cabe_en_columnas(fila)) {
+            throw out_of_range("Valor fuera de rango en la canción " + string(fila.track_id));
+        }
+    }
+
+    uint32_t agregar_columnas(const FilaCancion& fila) {
+        uint32_t id = static_cast<uint32_t>(vivo.size());
+        popularity.push_back(static_cast<uint8_t>(fila.popularity));
+        anio.push_back(static_cast<int16_t>(fila.anio));
+        danceability.push_back(fila.danceability);
+        energy.push_back(fila.energy);
+        key.push_back(static_cast<int8_t>(fila.key));
+        loudness.push_back(fila.loudness);
+        mode.push_back(static_cast<int8_t>(fila.mode));
+        speechiness.push_back(fila.speechiness);
+        acousticness.push_back(fila.acousticness);
+        instrumentalness.push_back(fila.instrumentalness);
+        liveness.push_back(fila.liveness);
+        valence.push_back(fila.valence);
+        tempo.push_back(fila.tempo);
+        duration_ms.push_back(fila.duration_ms);
+        time_signature.push_back(static_cast<int8_t>(fila.time_signature));
+        artista.push_back(artistas.internar(fila.artist_name));
+        genero.push_back(generos.internar(fila.genre));
+        nombres.agregar(fila.track_name);
+        ids_pista.agregar(fila.track_id);
+        vivo.push_back(1);
+        vivas++;
+        return id;
+    }
+};
+
+// Reservas de memoria de una arena y de los pools que reparten desde ella
+struct EstadisticasMemoria {
+    size_t bloques = 0;             // pedidos al sistema
+    size_t bytes_reservados = 0;
+    size_t nodos_creados = 0;       // trozos nuevos tomados de la arena
+    size_t nodos_reutilizados = 0;  // trozos tomados de la lista de libres
+};
+
+// Arena por bloques: pide memoria al sistema en bloques que crecen al doble
+// (hasta 1 MB) y la reparte avanzando un puntero. No libera piezas sueltas;
+// `vaciar` y el destructor devuelven todos los bloques de una vez.
+class Arena {
+public:
+    explicit Arena(size_t bloque_inicial = 4096) : bloque_inicial(bloque_inicial), siguiente_bloque(bloque_inicial) {}
+
+    void* reservar(size_t bytes, size_t alineacion = alignof(max_align_t)) {
+        size_t desfase = desfase_para(alineacion);
+        if (!actual || desfase + bytes > disponible) {
+            nuevo_bloque(bytes + alineacion);
+            desfase = desfase_para(alineacion);
+        }
+        char* pieza = actual + desfase;
+        actual = pieza + bytes;
+        disponible -= desfase + bytes;
+        return pieza;
+    }
+
+    void vaciar() {
+        bloques.clear();
+        actual = nullptr;
+        disponible = 0;
+        siguiente_bloque = bloque_inicial;
+    }
+
+    size_t memoria() const {
+        return memoria_actual;
+    }
+
+    EstadisticasMemoria estadisticas;
+
+private:
+    vector<unique_ptr<char[]>> bloques;
+    char* actual = nullptr;
+    size_t disponible = 0;
+    size_t memoria_actual = 0;
+    size_t bloque_inicial;
+    size_t siguiente_bloque;
+
+    size_t desfase_para(size_t alineacion) const {
+        return (alineacion - reinterpret_cast<uintptr_t>(actual) % alineacion) % alineacion;
+    }
+
+    void nuevo_bloque(size_t minimo) {
+        size_t tam = max(siguiente_bloque, minimo);
+        bloques.emplace_back(new char[tam]);
+        actual = bloques.back().get();
+        disponible = tam;
+        siguiente_bloque = min<size_t>(siguiente_bloque * 2, 1 << 20);
+        memoria_actual += tam;
+        estadisticas.bloques++;
+        estadisticas.bytes_reservados += tam;
+    }
+};
+
+// Arreglo de capacidad fija cuyo espacio pertenece a otro (la arena del árbol):
+// solo guarda el puntero y el tamaño, así que no reserva ni libera nada.
+// Quien lo usa garantiza que no supere la capacidad.
+template <typename T>
+class ArregloEnArena {
+    static_assert(is_trivially_copyable_v<T>, "ArregloEnArena solo copia bytes");
+
+public:
+    void asignar_espacio(T* espacio) {
+        datos = espacio;
+        cantidad = 0;
+    }
+
+    size_t size() const { return cantidad; }
+    bool empty() const { return cantidad == 0; }
+    T* data() { return datos; }
+    const T* data() const { return datos; }
+    T* begin() { return datos; }
+    T* end() { return datos + cantidad; }
+    const T* begin() const { return datos; }
+    const T* end() const { return datos + cantidad; }
+    reverse_iterator<const T*> rbegin() const { return reverse_iterator<const T*>(end()); }
+    reverse_iterator<const T*> rend() const { return reverse_iterator<const T*>(begin()); }
+    T& operator[](size_t i) { return datos[i]; }
+    const T& operator[](size_t i) const { return datos[i]; }
+    T& front() { return datos[0]; }
+    T& back() { return datos[cantidad - 1]; }
+    const T& front() const { return datos[0]; }
+    const T& back() const { return datos[cantidad - 1]; }
+
+    void clear() { cantidad = 0; }
+    void push_back(T valor) { datos[cantidad++] = valor; }
+    void pop_back() { cantidad--; }
+
+    void insert(T* pos, T valor) {
+        move_backward(pos, end(), end() + 1);
+        *pos = valor;
+        cantidad++;
+    }
+
+    template <typename Iterador>
+    void insert(T* pos, Iterador primero, Iterador ultimo) {
+        size_t n = static_cast<size_t>(distance(primero, ultimo));
+        move_backward(pos, end(), end() + n);
+        copy(primero, ultimo, pos);
+        cantidad += static_cast<uint32_t>(n);
+    }
+
+    void erase(T* pos) {
+        copy(pos + 1, end(), pos);
+        cantidad--;
+    }
+
+    template <typename Iterador>
+    void assign(Iterador primero, Iterador ultimo) {
+        cantidad = static_cast<uint32_t>(copy(primero, ultimo, datos) - datos);
+    }
+
+    void resize(size_t n) {
+        if (n > cantidad) {
+            fill(end(), datos + n, T{});
+        }
+        cantidad = static_cast<uint32_t>(n);
+    }
+
+private:
+    T* datos = nullptr;
+    uint32_t cantidad = 0;
+};
+
+// Nodo de árbol B+ con ids de canción del catálogo. Las hojas guardan los ids
+// en orden y están enlazadas entre sí; los nodos internos guardan separadores
+// (claves[i] es la menor clave bajo hijos[i + 1]) y cuántas canciones hay bajo
+// cada hijo, lo que permite llegar a la posición k sin recorrer el árbol.
+// prefijos[i] resume claves[i] en 64 bits para buscar sin ir al catálogo.
+// Los nodos y sus arreglos viven en la arena del árbol (ver `PoolNodos`).
+class Nodo {
+public:
+    ArregloEnArena<uint32_t> claves;
+    ArregloEnArena<uint64_t> prefijos;
+    ArregloEnArena<Nodo*> hijos;
+    ArregloEnArena<uint32_t> cuentas;   // canciones bajo cada hijo
+    bool es_hoja = true;
+    Nodo* anterior = nullptr;   // hojas vecinas
+    Nodo* siguiente = nullptr;
+
+    size_t cantidad() const {
+        if (es_hoja) {
+            return claves.size();
+        }
+        size_t suma = 0;
+        for (uint32_t cuenta : cuentas) {
+            suma += cuenta;
+        }
+        return suma;
+    }
+};
+
+// Nodos de un árbol B+ con capacidad fija. Cada nodo y sus arreglos ocupan un
+// solo trozo contiguo de la arena: la construcción masiva los deja uno tras
+// otro en memoria y con altas y bajas los trozos liberados se reutilizan.
+// Como Nodo no tiene destructor, desarmar el árbol es devolver los bloques.
+class PoolNodos {
+    static_assert(is_trivially_destructible_v<Nodo>, "los nodos se descartan sin destruirlos");
+
+public:
+    // Las hojas admiten una clave de más y los nodos internos un hijo de más
+    // antes de dividirse
+    explicit PoolNodos(size_t claves_por_hoja) : capacidad(claves_por_hoja + 1) {}
+
+    Nodo* crear(bool hoja) {
+        vector<Nodo*>& libres = hoja ? libres_hojas : libres_internos;
+        Nodo* nodo;
+        if (!libres.empty()) {
+            nodo = libres.back();
+            libres.pop_back();
+            nodo->claves.clear();
+            nodo->prefijos.clear();
+            nodo->hijos.clear();
+            nodo->cuentas.clear();
+            nodo->anterior = nullptr;
+            nodo->siguiente = nullptr;
+            arena.estadisticas.nodos_reutilizados++;
+            return nodo;
+        }
+
+        size_t hijos = hoja ? 0 : capacidad + 1;
+        size_t bytes = sizeof(Nodo) + capacidad * sizeof(uint64_t) + hijos * sizeof(Nodo*) +
+                       capacidad * sizeof(uint32_t) + hijos * sizeof(uint32_t);
+        char* trozo = static_cast<char*>(arena.reservar(bytes, alignof(Nodo)));
+        nodo = new (trozo) Nodo();
+        nodo->es_hoja = hoja;
+        char* espacio = trozo + sizeof(Nodo);
+        nodo->prefijos.asignar_espacio(reinterpret_cast<uint64_t*>(espacio));
+        espacio += capacidad * sizeof(uint64_t);
+        nodo->hijos.asignar_espacio(reinterpret_cast<Nodo**>(espacio));
+        espacio += hijos * sizeof(Nodo*);
+        nodo->claves.asignar_espacio(reinterpret_cast<uint32_t*>(espacio));
+        espacio += capacidad * sizeof(uint32_t);
+        nodo->cuentas.asignar_espacio(reinterpret_cast<uint32_t*>(espacio));
+        arena.estadisticas.nodos_creados++;
+        return nodo;
+    }
+
+    void liberar(Nodo* nodo) {
+        (nodo->es_hoja ? libres_hojas : libres_internos).push_back(nodo);
+    }
+
+    void vaciar() {
+        arena.vaciar();
+        libres_hojas.clear();
+        libres_internos.clear();
+    }
+
+    const EstadisticasMemoria& estadisticas() const {
+        return arena.estadisticas;
+    }
+
+    size_t memoria() const {
+        return arena.memoria();
+    }
+
+private:
+    Arena arena;
+    size_t capacidad;   // claves por nodo, contando la de más
+    vector<Nodo*> libres_hojas;
+    vector<Nodo*> libres_internos;
+};
+
+// Claves por hoja de los árboles de la lista. Con 32 claves los prefijos de un
+// nodo ocupan 4 líneas de caché y los ids 2, y un millón de canciones caben en
+// 4 o 5 niveles en lugar de los ~15 que daba la capacidad 3.
+constexpr int CLAVES_POR_NODO = 32;
+
+#if defined(__SSE2__)
+// a < b sin signo en cada mitad de 64 bits, armado con comparaciones de 32
+// bits (SSE2 no compara enteros de 64). El resultado queda en toda la mitad.
+inline __m128i menor_u64(__m128i a, __m128i b) {
+    const __m128i signo = _mm_set1_epi32(INT32_MIN);
+    __m128i menor = _mm_cmpgt_epi32(_mm_xor_si128(b, signo), _mm_xor_si128(a, signo));
+    __m128i igual = _mm_cmpeq_epi32(a, b);
+    // palabra alta menor, o alta igual y baja menor
+    __m128i baja_menor = _mm_shuffle_epi32(menor, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i resultado = _mm_or_si128(menor, _mm_and_si128(igual, baja_menor));
+    return _mm_shuffle_epi32(resultado, _MM_SHUFFLE(3, 3, 1, 1));
+}
+#endif
+
+// Tramo [desde, hasta) de prefijos (ordenados) iguales a `prefijo`: antes de
+// `desde` todos son menores y desde `hasta` todos mayores. Se recorre el nodo
+// completo de a dos prefijos por instrucción, sin saltos que predecir.
+inline pair<size_t, size_t> tramo_de_prefijo(const uint64_t* prefijos, size_t n, uint64_t prefijo) {
+    size_t menores = 0;
+    size_t mayores = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i buscado = _mm_set1_epi64x(static_cast<long long>(prefijo));
+    for (; i + 2 <= n; i += 2) {
+        __m128i bloque = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefijos + i));
+        int mascara_menores = _mm_movemask_pd(_mm_castsi128_pd(menor_u64(bloque, buscado)));
+        int mascara_mayores = _mm_movemask_pd(_mm_castsi128_pd(menor_u64(buscado, bloque)));
+        menores += (mascara_menores & 1) + (mascara_menores >> 1);
+        mayores += (mascara_mayores & 1) + (mascara_mayores >> 1);
+    }
+#endif
+    for (; i < n; ++i) {
+        menores += prefijos[i] < prefijo;
+        mayores += prefijos[i] > prefijo;
+    }
+    return {menores, n - mayores};
+}
+
+// Primeros 8 bytes del texto como entero big-endian (con ceros al final si es
+// más corto): si un texto va antes que otro, su prefijo no es mayor
+inline uint64_t prefijo_de_texto(string_view texto) {
+    uint64_t valor = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        valor = (valor << 8) | (i < texto.size() ? static_cast<unsigned char>(texto[i]) : 0u);
+    }
+    return valor;
+}
+
+// Orden sin distinguir mayúsculas; coincide con string::operator< sobre las
+// cadenas ya pasadas a minúsculas (las claves del trie)
+bool menor_sin_mayusculas(string_view a, string_view b) {
+    return lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+        [](char x, char y) {
+            return tolower(static_cast<unsigned char>(x)) <
+                   tolower(static_cast<unsigned char>(y));
+        });
+}
+
+// Ordena ids por artista o por nombre sin distinguir mayúsculas. Los empates
+// conservan el orden recibido.
+void ordenar_sin_mayusculas(const CatalogoColumnar& catalogo, vector<uint32_t>& ids, bool por_artista) {
+    stable_sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b) {
+        return por_artista ?
+            menor_sin_mayusculas(catalogo.artist_name(a), catalogo.artist_name(b)) :
+            menor_sin_mayusculas(catalogo.track_name(a), catalogo.track_name(b));
+    });
+}
+
+// Órdenes ya calculados que la instantánea guarda junto al catálogo
+struct OrdenesInstantanea {
+    vector<uint32_t> arbol;        // (track_name, id)
+    vector<uint32_t> artistas;     // artista sin distinguir mayúsculas
+    vector<uint32_t> nombres;      // nombre sin distinguir mayúsculas
+    vector<uint32_t> popularidad;  // (popularity, track_id)
+    vector<uint32_t> duracion;     // (duration_ms, track_id)
+};
+
+// Comprueba la cabecera y la suma de verificación de una instantánea ya
+// proyectada y devuelve un lector sobre su contenido, o nullopt si el CSV
+// cambió desde que se guardó. Lanza runtime_error si el archivo está dañado.
+optional<LectorInstantanea> abrir_contenido_instantanea(const ArchivoMapeado& archivo,
+                                                        const string& ruta_csv) {
+    CabeceraInstantanea cabecera;
+    if (archivo.tamano() < sizeof(cabecera)) {
+        throw runtime_error("archivo demasiado corto");
+    }
+    memcpy(&cabecera, archivo.datos(), sizeof(cabecera));
+    if (memcmp(cabecera.magia, "GRCSNAP", 8) != 0 ||
+        cabecera.version != VERSION_INSTANTANEA ||
+        cabecera.orden_bytes != MARCA_ORDEN_BYTES ||
+        cabecera.tamano_contenido != archivo.tamano() - sizeof(cabecera)) {
+        throw runtime_error("formato o versión incompatible");
+    }
+    FirmaArchivo csv = firma_archivo(ruta_csv);
+    if (csv.existe && (csv.tamano != cabecera.tamano_csv ||
+                       csv.modificacion != cabecera.modificacion_csv)) {
+        return nullopt;
+    }
+    const char* contenido = archivo.datos() + sizeof(cabecera);
+    SumaVerificacion suma;
+    suma.agregar(contenido, cabecera.tamano_contenido);
+    if (suma.valor() != cabecera.suma_verificacion) {
+        throw runtime_error("suma de verificación incorrecta");
+    }
+    return LectorInstantanea(contenido, cabecera.tamano_contenido);
+}
+
+// Lee una instantánea creada con ListaReproduccion::guardar_instantanea.
+// Devuelve false si no existe, está dañada o el CSV cambió desde entonces.
+// `leer_indices`, si se pasa, lee los índices guardados después de los
+// órdenes mientras el archivo sigue proyectado; puede lanzar runtime_error.
+bool leer_instantanea(const string& ruta, const string& ruta_csv, CatalogoColumnar& catalogo,
+                      OrdenesInstantanea& ordenes,
+                      const function<void(LectorInstantanea&, const CatalogoColumnar&)>& leer_indices = nullptr) {
+    error_code error;
+    if (!filesystem::exists(ruta, error)) {
+        return false;
+    }
+    try {
+        ArchivoMapeado archivo(ruta);
+        optional<LectorInstantanea> contenido = abrir_contenido_instantanea(archivo, ruta_csv);
+        if (!contenido) {
+            cout << "La instantánea está desactualizada; se leerá el CSV.\n";
+            return false;
+        }
+
+        LectorInstantanea& lector = *contenido;
+        CatalogoColumnar leido;
+        OrdenesInstantanea leidos;
+        leido.cargar(lector);
+        auto todos = {&leidos.arbol, &leidos.artistas, &leidos.nombres,
+                      &leidos.popularidad, &leidos.duracion};
+        for (auto* orden : todos) {
+            lector.leer_arreglo(*orden);
+        }
+        for (const auto* orden : todos) {
+            if (orden->size() != leidos.arbol.size() ||
+                !all_of(orden->begin(), orden->end(),
+                        [&leido](uint32_t id) { return leido.esta_viva(id); })) {
+                throw runtime_error("índices inconsistentes");
+            }
+        }
+        if (leer_indices) {
+            leer_indices(lector, leido);
+        }
+        catalogo = move(leido);
+        ordenes = move(leidos);
+        return true;
+    } catch (const exception& e) {
+        cerr << "No se pudo usar la instantánea " << ruta << ": " << e.what() << '\n';
+        return false;
+    }
+}
+
+// Índice de prefijos sobre el catálogo completo del CSV. Se construye una sola
+// vez: guarda los ids ordenados por artista y por nombre sin distinguir
+// mayúsculas, y cada consulta son dos búsquedas binarias (O(log n + k)).
+// El catálogo puede ser propio o el de la lista, si esta salió del mismo CSV.
+class IndicePrefijos {
+public:
+    bool cargado() const {
+        return listo;
+    }
+
+    const CatalogoColumnar& catalogo() const {
+        return externo ? *externo : completo;
+    }
+
+    // true si el índice consulta ese catálogo sin tener copia propia
+    bool usa(const CatalogoColumnar& catalogo) const {
+        return listo && externo == &catalogo;
+    }
+
+    void construir(CatalogoColumnar&& catalogo) {
+        vector<uint32_t> ids;
+        ids.reserve(catalogo.total_vivas());
+        for (uint32_t id = 0; id < catalogo.size(); ++id) {
+            if (catalogo.esta_viva(id)) {
+                ids.push_back(id);
+            }
+        }
+        completo = move(catalogo);
+        externo = nullptr;
+        ordenar(move(ids));
+    }
+
+    // Recibe los órdenes ya calculados (por ejemplo, leídos de una instantánea)
+    void construir(CatalogoColumnar&& catalogo, vector<uint32_t>&& artistas, vector<uint32_t>&& nombres) {
+        completo = move(catalogo);
+        externo = nullptr;
+        por_artista = move(artistas);
+        por_nombre = move(nombres);
+        listo = true;
+    }
+
+    // Indexa `ids` de un catálogo ajeno, que debe seguir vivo y sin cambiar
+    // sus ids mientras el índice esté cargado
+    void construir_sobre(const CatalogoColumnar& catalogo, vector<uint32_t>&& ids) {
+        completo = CatalogoColumnar();
+        externo = &catalogo;
+        ordenar(move(ids));
+    }
+
+    void construir_sobre(const CatalogoColumnar& catalogo, vector<uint32_t>&& artistas,
+                         vector<uint32_t>&& nombres) {
+        completo = CatalogoColumnar();
+        externo = &catalogo;
+        por_artista = move(artistas);
+        por_nombre = move(nombres);
+        listo = true;
+    }
+
+    void vaciar() {
+        *this = IndicePrefijos();
+    }
+
+    // Ids cuyo artista o nombre empieza por el prefijo, sin distinguir mayúsculas
+    vector<uint32_t> buscar(string_view prefijo, bool artista) const {
+        const vector<uint32_t>& orden = artista ? por_artista : por_nombre;
+        auto texto = [&](uint32_t id) {
+            return artista ? catalogo().artist_name(id) : catalogo().track_name(id);
+        };
+        auto inicio = partition_point(orden.begin(), orden.end(), [&](uint32_t id) {
+            return menor_sin_mayusculas(texto(id), prefijo);
+        });
+        auto fin = partition_point(inicio, orden.end(), [&](uint32_t id) {
+            // Los textos que empiezan por el prefijo son contiguos en el orden
+            return !menor_sin_mayusculas(prefijo, texto(id).substr(0, prefijo.size()));
+        });
+        return vector<uint32_t>(inicio, fin);
+    }
+
+private:
+    void ordenar(vector<uint32_t>&& ids) {
+        por_artista = ids;
+        ordenar_sin_mayusculas(catalogo(), por_artista, true);
+        ordenar_sin_mayusculas(catalogo(), ids, false);
+        por_nombre = move(ids);
+        listo = true;
+    }
+
+    CatalogoColumnar completo;
+    const CatalogoColumnar* externo = nullptr;
+    vector<uint32_t> por_artista;
+    vector<uint32_t> por_nombre;
+    bool listo = false;
+};
+
+// Órdenes para los árboles B+. Comparan ids del catálogo y desempatan para
+// que cada clave sea única.
+struct OrdenPorNombre {
+    const CatalogoColumnar* catalogo;
+    bool operator()(uint32_t a, uint32_t b) const {
+        int comparacion = catalogo->track_name(a).compare(catalogo->track_name(b));
+        return comparacion < 0 || (comparacion == 0 && a < b);
+    }
+    uint64_t prefijo(uint32_t id) const {
+        return prefijo_de_texto(catalogo->track_name(id));
+    }
+};
+
+struct OrdenPorPopularidad {
+    const CatalogoColumnar* catalogo;
+    bool operator()(uint32_t a, uint32_t b) const {
+        uint8_t popularidad_a = catalogo->popularity[a];
+        uint8_t popularidad_b = catalogo->popularity[b];
+        return popularidad_a != popularidad_b ? popularidad_a < popularidad_b :
+                                                catalogo->track_id(a) < catalogo->track_id(b);
+    }
+    // popularidad y los primeros 7 bytes del track_id
+    uint64_t prefijo(uint32_t id) const {
+        return (uint64_t{catalogo->popularity[id]} << 56) | (prefijo_de_texto(catalogo->track_id(id)) >> 8);
+    }
+};
+
+struct OrdenPorDuracion {
+    const CatalogoColumnar* catalogo;
+    bool operator()(uint32_t a, uint32_t b) const {
+        int32_t duracion_a = catalogo->duration_ms[a];
+        int32_t duracion_b = catalogo->duration_ms[b];
+        return duracion_a != duracion_b ? duracion_a < duracion_b :
+                                          catalogo->track_id(a) < catalogo->track_id(b);
+    }
+    // duración (con el signo invertido para ordenar sin signo) y 4 bytes del track_id
+    uint64_t prefijo(uint32_t id) const {
+        uint32_t duracion = static_cast<uint32_t>(catalogo->duration_ms[id]) ^ 0x80000000u;
+        return (uint64_t{duracion} << 32) | (prefijo_de_texto(catalogo->track_id(id)) >> 32);
+    }
+};
+
+// Árbol B+ de estadísticas de orden sobre ids del catálogo, ordenados con
+// `Orden`. Con la cantidad de canciones de cada subárbol se obtiene la canción
+// en la posición k o una página completa en O(log n + página), en ambos sentidos.
+// `Orden::prefijo` debe respetar el orden: si a va antes que b, prefijo(a) <= prefijo(b).
+template <typename Orden>
+class ArbolBMas {
+    PoolNodos nodos;
+
+public:
+    Nodo* raiz;
+    const int tamano_maximo;    // claves por hoja; un nodo interno admite tamano_maximo + 1 hijos
+    const CatalogoColumnar& catalogo;
+    size_t total = 0;
+
+    ArbolBMas(int tam_max, const CatalogoColumnar& catalogo)
+        : nodos(tam_max), raiz(nodos.crear(true)), tamano_maximo(tam_max), catalogo(catalogo), orden{&catalogo} {}
+
+    bool antes(uint32_t a, uint32_t b) const {
+        return orden(a, b);
+    }
+
+    uint64_t prefijo(uint32_t id) const {
+        return orden.prefijo(id);
+    }
+
+    bool contiene(uint32_t id) const {
+        if (id >= catalogo.size()) {
+            return false;
+        }
+        uint64_t clave = prefijo(id);
+        const Nodo* nodo = raiz;
+        while (!nodo->es_hoja) {
+            nodo = nodo->hijos[buscar_en_nodo(nodo, id, clave, true)];
+        }
+        size_t pos = buscar_en_nodo(nodo, id, clave, false);
+        return pos < nodo->claves.size() && nodo->claves[pos] == id;
+    }
+
+    // Devuelve false si la canción ya está en el árbol
+    bool insertar(uint32_t id) {
+        Nodo* hermano = nullptr;
+        uint32_t separador = 0;
+        if (!_insertar(raiz, id, prefijo(id), hermano, separador)) {
+            return false;
+        }
+        if (hermano) {
+            Nodo* nueva_raiz = nodos.crear(false);
+            poner_clave(nueva_raiz, 0, separador);
+            nueva_raiz->cuentas.push_back(static_cast<uint32_t>(raiz->cantidad()));
+            nueva_raiz->cuentas.push_back(static_cast<uint32_t>(hermano->cantidad()));
+            nueva_raiz->hijos.push_back(raiz);
+            nueva_raiz->hijos.push_back(hermano);
+            raiz = nueva_raiz;
+        }
+        total++;
+        return true;
+    }
+
+    // Construcción ascendente a partir de ids ya ordenados con `antes`.
+    // Reemplaza el contenido actual del árbol (la arena se vacía de una vez).
+    // Las hojas quedan llenas salvo por el reparto en partes iguales, y cada
+    // nivel se arma sobre el anterior.
+    void construir_desde_ordenado(vector<uint32_t>&& ids) {
+        nodos.vaciar();
+        total = ids.size();
+        size_t capacidad = static_cast<size_t>(tamano_maximo);
+        size_t num_hojas = max<size_t>(1, (ids.size() + capacidad - 1) / capacidad);
+
+        vector<Nodo*> nivel;
+        vector<uint32_t> minimos;   // menor clave de cada nodo del nivel
+        vector<uint32_t> cuentas;
+        size_t pos = 0;
+        Nodo* anterior = nullptr;
+        for (size_t h = 0; h < num_hojas; ++h) {
+            size_t tam = ids.size() / num_hojas + (h < ids.size() % num_hojas ? 1 : 0);
+            Nodo* hoja = nodos.crear(true);
+            hoja->claves.assign(ids.begin() + pos, ids.begin() + pos + tam);
+            for (uint32_t id : hoja->claves) {
+                hoja->prefijos.push_back(prefijo(id));
+            }
+            hoja->anterior = anterior;
+            if (anterior) {
+                anterior->siguiente = hoja;
+            }
+            anterior = hoja;
+            minimos.push_back(tam ? ids[pos] : 0);
+            cuentas.push_back(static_cast<uint32_t>(tam));
+            nivel.push_back(hoja);
+            pos += tam;
+        }
+
+        while (nivel.size() > 1) {
+            size_t num_padres = (nivel.size() + capacidad) / (capacidad + 1);
+            vector<Nodo*> padres;
+            vector<uint32_t> minimos_padres;
+            vector<uint32_t> cuentas_padres;
+            size_t hijo = 0;
+            for (size_t p = 0; p < num_padres; ++p) {
+                size_t tam = nivel.size() / num_padres + (p < nivel.size() % num_padres ? 1 : 0);
+                Nodo* padre = nodos.crear(false);
+                minimos_padres.push_back(minimos[hijo]);
+                uint32_t suma = 0;
+                for (size_t i = 0; i < tam; ++i, ++hijo) {
+                    if (i > 0) {
+                        poner_clave(padre, padre->claves.size(), minimos[hijo]);
+                    }
+                    padre->cuentas.push_back(cuentas[hijo]);
+                    suma += cuentas[hijo];
+                    padre->hijos.push_back(nivel[hijo]);
+                }
+                cuentas_padres.push_back(suma);
+                padres.push_back(padre);
+            }
+            nivel = move(padres);
+            minimos = move(minimos_padres);
+            cuentas = move(cuentas_padres);
+        }
+        raiz = nivel[0];
+    }
+
+    bool eliminar(uint32_t id) {
+        if (id >= catalogo.size() || !_eliminar(raiz, id, prefijo(id))) {
+            return false;
+        }
+        // La raíz interna que quedó con un solo hijo se reemplaza por él
+        if (!raiz->es_hoja && raiz->hijos.size() == 1) {
+            Nodo* vieja = raiz;
+            raiz = raiz->hijos[0];
+            nodos.liberar(vieja);
+        }
+        total--;
+        return true;
+    }
+
+    size_t size() const {
+        return total;
+    }
+
+    // Id de la canción en la posición k (0 es la primera)
+    uint32_t seleccionar(size_t k) const {
+        if (k >= total) {
+            throw out_of_range("Posición fuera del árbol");
+        }
+        auto [hoja, pos] = ubicar(k);
+        return hoja->claves[pos];
+    }
+
+    // Hasta `cantidad` ids a partir de la posición `inicio`: se baja una vez
+    // hasta la hoja y luego se avanza por la lista de hojas. En orden
+    // descendente `inicio` se cuenta desde el final y se avanza hacia atrás.
+    vector<uint32_t> rango(size_t inicio, size_t cantidad, bool ascendente = true) const {
+        vector<uint32_t> resultado;
+        if (inicio >= total) {
+            return resultado;
+        }
+        cantidad = min(cantidad, total - inicio);
+        resultado.reserve(cantidad);
+        if (ascendente) {
+            auto [hoja, pos] = ubicar(inicio);
+            while (hoja && resultado.size() < cantidad) {
+                size_t tomar = min(hoja->claves.size() - pos, cantidad - resultado.size());
+                resultado.insert(resultado.end(), hoja->claves.begin() + pos,
+                                 hoja->claves.begin() + pos + tomar);
+                hoja = hoja->siguiente;
+                pos = 0;
+            }
+        } else {
+            // pos_fin es una posición después de la última clave a tomar de la hoja
+            auto [hoja, pos] = ubicar(total - 1 - inicio);
+            size_t pos_fin = pos + 1;
+            while (hoja && resultado.size() < cantidad) {
+                size_t tomar = min(pos_fin, cantidad - resultado.size());
+                resultado.insert(resultado.end(), hoja->claves.rbegin() + (hoja->claves.size() - pos_fin),
+                                 hoja->claves.rbegin() + (hoja->claves.size() - pos_fin) + tomar);
+                hoja = hoja->anterior;
+                pos_fin = hoja ? hoja->claves.size() : 0;
+            }
+        }
+        return resultado;
+    }
+
+    vector<uint32_t> listar() const {
+        return rango(0, total);
+    }
+
+    const EstadisticasMemoria& estadisticas_memoria() const {
+        return nodos.estadisticas();
+    }
+
+    size_t memoria() const {
+        return nodos.memoria();
+    }
+
+    size_t altura() const {
+        size_t niveles = 1;
+        for (const Nodo* nodo = raiz; !nodo->es_hoja; nodo = nodo->hijos[0]) {
+            niveles++;
+        }
+        return niveles;
+    }
+
+    // Recorre el árbol entero comprobando sus invariantes: claves en orden a
+    // lo largo de las hojas y dentro de los separadores, cuentas iguales al
+    // tamaño de cada subárbol, ocupación entre el mínimo y el máximo fuera de
+    // la raíz, prefijos al día, hojas a la misma profundidad y enlaces entre
+    // hojas consistentes. Devuelve la primera que no se cumple, o una cadena
+    // vacía. Lo usa --pruebas.
+    string revisar() const {
+        Revision revision;
+        size_t cantidad = revisar_nodo(raiz, 1, nullptr, nullptr, revision);
+        if (revision.error.empty() && revision.ultima_hoja && revision.ultima_hoja->siguiente) {
+            revision.error = "la última hoja tiene siguiente";
+        }
+        if (revision.error.empty() && cantidad != total) {
+            revision.error = "total " + to_string(total) + " pero hay " + to_string(cantidad) + " claves";
+        }
+        return revision.error;
+    }
+
+private:
+    Orden orden;
+
+    struct Revision {
+        size_t profundidad_hojas = 0;
+        const Nodo* ultima_hoja = nullptr;
+        optional<uint32_t> ultima_clave;
+        string error;
+    };
+
+    // Claves del subárbol; las de `nodo` deben quedar en [desde, hasta)
+    size_t revisar_nodo(const Nodo* nodo, size_t nivel, const uint32_t* desde, const uint32_t* hasta,
+                        Revision& revision) const {
+        auto fallar = [&revision, nivel](const string& motivo) {
+            if (revision.error.empty()) {
+                revision.error = motivo + " (nivel " + to_string(nivel) + ")";
+            }
+            return size_t{0};
+        };
+        if (nodo != raiz && ocupacion(nodo) < minimo(nodo)) {
+            return fallar("nodo por debajo del mínimo");
+        }
+        for (uint32_t id : nodo->claves) {
+            if ((desde && antes(id, *desde)) || (hasta && !antes(id, *hasta))) {
+                return fallar("clave fuera de los separadores del padre");
+            }
+        }
+        for (size_t i = 1; i < nodo->claves.size(); ++i) {
+            if (!antes(nodo->claves[i - 1], nodo->claves[i])) {
+                return fallar("claves desordenadas dentro del nodo");
+            }
+        }
+        if (nodo->prefijos.size() != nodo->claves.size()) {
+            return fallar("prefijos y claves de distinto largo");
+        }
+        for (size_t i = 0; i < nodo->claves.size(); ++i) {
+            if (nodo->prefijos[i] != prefijo(nodo->claves[i])) {
+                return fallar("prefijo que no corresponde a su clave");
+            }
+        }
+
+        if (nodo->es_hoja) {
+            if (nodo->claves.size() > static_cast<size_t>(tamano_maximo)) {
+                return fallar("hoja por encima del máximo");
+            }
+            if (revision.profundidad_hojas == 0) {
+                revision.profundidad_hojas = nivel;
+            } else if (revision.profundidad_hojas != nivel) {
+                return fallar("hojas a distinta profundidad");
+            }
+            if (nodo->anterior != revision.ultima_hoja ||
+                (revision.ultima_hoja && revision.ultima_hoja->siguiente != nodo)) {
+                return fallar("enlaces entre hojas rotos");
+            }
+            if (!nodo->claves.empty()) {
+                if (revision.ultima_clave && !antes(*revision.ultima_clave, nodo->claves.front())) {
+                    return fallar("claves desordenadas entre hojas");
+                }
+                revision.ultima_clave = nodo->claves.back();
+            }
+            revision.ultima_hoja = nodo;
+            return nodo->claves.size();
+        }
+
+        if (nodo->hijos.size() < 2 || nodo->hijos.size() > static_cast<size_t>(tamano_maximo) + 1 ||
+            nodo->claves.size() + 1 != nodo->hijos.size() || nodo->cuentas.size() != nodo->hijos.size()) {
+            return fallar("nodo interno con claves, hijos y cuentas incoherentes");
+        }
+        size_t suma = 0;
+        for (size_t i = 0; i < nodo->hijos.size(); ++i) {
+            const uint32_t* desde_hijo = i > 0 ? &nodo->claves[i - 1] : desde;
+            const uint32_t* hasta_hijo = i + 1 < nodo->hijos.size() ? &nodo->claves[i] : hasta;
+            size_t cantidad = revisar_nodo(nodo->hijos[i], nivel + 1, desde_hijo, hasta_hijo, revision);
+            if (!revision.error.empty()) {
+                return 0;
+            }
+            if (cantidad != nodo->cuentas[i]) {
+                return fallar("cuenta " + to_string(nodo->cuentas[i]) + " para un subárbol de " +
+                              to_string(cantidad));
+            }
+            suma += cantidad;
+        }
+        return suma;
+    }
+
+    // Posición de la clave en el nodo: la primera clave que no va antes que ella
+    // o, con `incluir_iguales`, la primera que va después (el hijo por el que se
+    // baja). Los prefijos descartan casi todas las claves sin tocar el catálogo;
+    // solo las de prefijo igual se comparan completas.
+    size_t buscar_en_nodo(const Nodo* nodo, uint32_t id, uint64_t clave, bool incluir_iguales) const {
+        auto [desde, hasta] = tramo_de_prefijo(nodo->prefijos.data(), nodo->prefijos.size(), clave);
+        auto inicio = nodo->claves.begin() + desde;
+        auto fin = nodo->claves.begin() + hasta;
+        auto comparar = [this](uint32_t a, uint32_t b) { return antes(a, b); };
+        auto it = incluir_iguales ? upper_bound(inicio, fin, id, comparar) : lower_bound(inicio, fin, id, comparar);
+        return it - nodo->claves.begin();
+    }
+
+    void poner_clave(Nodo* nodo, size_t pos, uint32_t id) {
+        nodo->claves.insert(nodo->claves.begin() + pos, id);
+        nodo->prefijos.insert(nodo->prefijos.begin() + pos, prefijo(id));
+    }
+
+    void quitar_clave(Nodo* nodo, size_t pos) {
+        nodo->claves.erase(nodo->claves.begin() + pos);
+        nodo->prefijos.erase(nodo->prefijos.begin() + pos);
+    }
+
+    // Hoja y posición dentro de ella de la canción número k
+    pair<const Nodo*, size_t> ubicar(size_t k) const {
+        const Nodo* nodo = raiz;
+        while (!nodo->es_hoja) {
+            size_t i = 0;
+            while (k >= nodo->cuentas[i]) {
+                k -= nodo->cuentas[i];
+                i++;
+            }
+            nodo = nodo->hijos[i];
+        }
+        return {nodo, k};
+    }
+
+    // Si el nodo se divide, `hermano` recibe la mitad derecha y `separador`
+    // su menor clave
+    bool _insertar(Nodo* nodo, uint32_t id, uint64_t clave, Nodo*& hermano, uint32_t& separador) {
+        if (nodo->es_hoja) {
+            size_t pos = buscar_en_nodo(nodo, id, clave, false);
+            if (pos < nodo->claves.size() && nodo->claves[pos] == id) {
+                return false;
+            }
+            nodo->claves.insert(nodo->claves.begin() + pos, id);
+            nodo->prefijos.insert(nodo->prefijos.begin() + pos, clave);
+            if (nodo->claves.size() > static_cast<size_t>(tamano_maximo)) {
+                dividir_hoja(nodo, hermano, separador);
+            }
+            return true;
+        }
+
+        size_t i = buscar_en_nodo(nodo, id, clave, true);
+        Nodo* nuevo = nullptr;
+        uint32_t separador_hijo = 0;
+        if (!_insertar(nodo->hijos[i], id, clave, nuevo, separador_hijo)) {
+            return false;
+        }
+        nodo->cuentas[i]++;
+        if (nuevo) {
+            uint32_t en_nuevo = static_cast<uint32_t>(nuevo->cantidad());
+            nodo->cuentas[i] -= en_nuevo;
+            poner_clave(nodo, i, separador_hijo);
+            nodo->cuentas.insert(nodo->cuentas.begin() + i + 1, en_nuevo);
+            nodo->hijos.insert(nodo->hijos.begin() + i + 1, nuevo);
+            if (nodo->hijos.size() > static_cast<size_t>(tamano_maximo) + 1) {
+                dividir_interno(nodo, hermano, separador);
+            }
+        }
+        return true;
+    }
+
+    void dividir_hoja(Nodo* hoja, Nodo*& hermano, uint32_t& separador) {
+        size_t mitad = hoja->claves.size() / 2;
+        hermano = nodos.crear(true);
+        hermano->claves.assign(hoja->claves.begin() + mitad, hoja->claves.end());
+        hermano->prefijos.assign(hoja->prefijos.begin() + mitad, hoja->prefijos.end());
+        hoja->claves.resize(mitad);
+        hoja->prefijos.resize(mitad);
+
+        hermano->siguiente = hoja->siguiente;
+        if (hoja->siguiente) {
+            hoja->siguiente->anterior = hermano;
+        }
+        hermano->anterior = hoja;
+        hoja->siguiente = hermano;
+        separador = hermano->claves.front();
+    }
+
+    // El separador del medio sube al padre; no se queda en ninguna mitad
+    void dividir_interno(Nodo* nodo, Nodo*& hermano, uint32_t& separador) {
+        size_t mitad = nodo->hijos.size() / 2;
+        hermano = nodos.crear(false);
+        hermano->hijos.assign(nodo->hijos.begin() + mitad, nodo->hijos.end());
+        hermano->cuentas.assign(nodo->cuentas.begin() + mitad, nodo->cuentas.end());
+        hermano->claves.assign(nodo->claves.begin() + mitad, nodo->claves.end());
+        hermano->prefijos.assign(nodo->prefijos.begin() + mitad, nodo->prefijos.end());
+        separador = nodo->claves[mitad - 1];
+        nodo->hijos.resize(mitad);
+        nodo->cuentas.resize(mitad);
+        nodo->claves.resize(mitad - 1);
+        nodo->prefijos.resize(mitad - 1);
+    }
+
+    // Mínimo de claves por hoja y de hijos por nodo interno (salvo la raíz).
+    // Dos nodos en el mínimo, uno de ellos con una menos, caben en uno solo.
+    size_t minimo(const Nodo* nodo) const {
+        return nodo->es_hoja ? (tamano_maximo + 1) / 2 : (tamano_maximo + 2) / 2;
+    }
+
+    size_t ocupacion(const Nodo* nodo) const {
+        return nodo->es_hoja ? nodo->claves.size() : nodo->hijos.size();
+    }
+
+    // Quita la clave de su hoja y descuenta en el camino. Al volver, el hijo
+    // que quedó por debajo del mínimo pide prestado a un hermano o se fusiona
+    // con él. Los separadores del padre siguen siendo válidos: solo orientan la
+    // búsqueda, así que no hace falta reemplazarlos por el predecesor.
+    bool _eliminar(Nodo* nodo, uint32_t id, uint64_t clave) {
+        if (nodo->es_hoja) {
+            size_t pos = buscar_en_nodo(nodo, id, clave, false);
+            if (pos == nodo->claves.size() || nodo->claves[pos] != id) {
+                return false;
+            }
+            quitar_clave(nodo, pos);
+            return true;
+        }
+        size_t i = buscar_en_nodo(nodo, id, clave, true);
+        if (!_eliminar(nodo->hijos[i], id, clave)) {
+            return false;
+        }
+        nodo->cuentas[i]--;
+        if (ocupacion(nodo->hijos[i]) < minimo(nodo->hijos[i])) {
+            rebalancear(nodo, i);
+        }
+        return true;
+    }
+
+    void rebalancear(Nodo* padre, size_t i) {
+        if (i > 0 && ocupacion(padre->hijos[i - 1]) > minimo(padre->hijos[i - 1])) {
+            prestar_de_izquierda(padre, i);
+        } else if (i + 1 < padre->hijos.size() &&
+                   ocupacion(padre->hijos[i + 1]) > minimo(padre->hijos[i + 1])) {
+            prestar_de_derecha(padre, i);
+        } else if (i > 0) {
+            fusionar(padre, i - 1);
+        } else if (i + 1 < padre->hijos.size()) {
+            fusionar(padre, i);
+        }
+    }
+
+    // La última clave (o el último hijo) del hermano izquierdo pasa al frente de hijos[i]
+    void prestar_de_izquierda(Nodo* padre, size_t i) {
+        Nodo* izquierdo = padre->hijos[i - 1];
+        Nodo* hijo = padre->hijos[i];
+        uint32_t movidas = 1;
+        if (hijo->es_hoja) {
+            poner_clave(hijo, 0, izquierdo->claves.back());
+            quitar_clave(izquierdo, izquierdo->claves.size() - 1);
+            padre->claves[i - 1] = hijo->claves.front();
+            padre->prefijos[i - 1] = hijo->prefijos.front();
+        } else {
+            movidas = izquierdo->cuentas.back();
+            poner_clave(hijo, 0, padre->claves[i - 1]);
+            padre->claves[i - 1] = izquierdo->claves.back();
+            padre->prefijos[i - 1] = izquierdo->prefijos.back();
+            quitar_clave(izquierdo, izquierdo->claves.size() - 1);
+            hijo->hijos.insert(hijo->hijos.begin(), izquierdo->hijos.back());
+            izquierdo->hijos.pop_back();
+            hijo->cuentas.insert(hijo->cuentas.begin(), movidas);
+            izquierdo->cuentas.pop_back();
+        }
+        padre->cuentas[i - 1] -= movidas;
+        padre->cuentas[i] += movidas;
+    }
+
+    // La primera clave (o el primer hijo) del hermano derecho pasa al final de hijos[i]
+    void prestar_de_derecha(Nodo* padre, size_t i) {
+        Nodo* hijo = padre->hijos[i];
+        Nodo* derecho = padre->hijos[i + 1];
+        uint32_t movidas = 1;
+        if (hijo->es_hoja) {
+            poner_clave(hijo, hijo->claves.size(), derecho->claves.front());
+            quitar_clave(derecho, 0);
+            padre->claves[i] = derecho->claves.front();
+            padre->prefijos[i] = derecho->prefijos.front();
+        } else {
+            movidas = derecho->cuentas.front();
+            poner_clave(hijo, hijo->claves.size(), padre->claves[i]);
+            padre->claves[i] = derecho->claves.front();
+            padre->prefijos[i] = derecho->prefijos.front();
+            quitar_clave(derecho, 0);
+            hijo->hijos.push_back(derecho->hijos.front());
+            derecho->hijos.erase(derecho->hijos.begin());
+            hijo->cuentas.push_back(movidas);
+            derecho->cuentas.erase(derecho->cuentas.begin());
+        }
+        padre->cuentas[i] += movidas;
+        padre->cuentas[i + 1] -= movidas;
+    }
+
+    // hijos[j + 1] se une a hijos[j]; en nodos internos baja el separador del padre
+    void fusionar(Nodo* padre, size_t j) {
+        Nodo* izquierdo = padre->hijos[j];
+        Nodo* derecho = padre->hijos[j + 1];
+        if (izquierdo->es_hoja) {
+            izquierdo->claves.insert(izquierdo->claves.end(), derecho->claves.begin(), derecho->claves.end());
+            izquierdo->prefijos.insert(izquierdo->prefijos.end(), derecho->prefijos.begin(), derecho->prefijos.end());
+            izquierdo->siguiente = derecho->siguiente;
+            if (derecho->siguiente) {
+                derecho->siguiente->anterior = izquierdo;
+            }
+        } else {
+            izquierdo->claves.push_back(padre->claves[j]);
+            izquierdo->prefijos.push_back(padre->prefijos[j]);
+            izquierdo->claves.insert(izquierdo->claves.end(), derecho->claves.begin(), derecho->claves.end());
+            izquierdo->prefijos.insert(izquierdo->prefijos.end(), derecho->prefijos.begin(), derecho->prefijos.end());
+            izquierdo->hijos.insert(izquierdo->hijos.end(), derecho->hijos.begin(), derecho->hijos.end());
+            izquierdo->cuentas.insert(izquierdo->cuentas.end(), derecho->cuentas.begin(), derecho->cuentas.end());
+        }
+        padre->cuentas[j] += padre->cuentas[j + 1];
+        quitar_clave(padre, j);
+        padre->cuentas.erase(padre->cuentas.begin() + j + 1);
+        padre->hijos.erase(padre->hijos.begin() + j + 1);
+        nodos.liberar(derecho);
+    }
+};
+
+using BTree = ArbolBMas<OrdenPorNombre>;
+
+// Índice por año: como `anio` toma pocos valores, cada año tiene su propio
+// árbol B+ ordenado por nombre. Una página de un año (o de un rango de años,
+// que es la concatenación de sus listas en orden) cuesta O(años + log n + página).
+class IndiceAnios {
+public:
+    IndiceAnios(int tam_max, const CatalogoColumnar& catalogo)
+        : tamano_maximo(tam_max), catalogo(catalogo) {}
+
+    void insertar(uint32_t id) {
+        lista_de(catalogo.anio[id]).insertar(id);
+    }
+
+    void eliminar(uint32_t id) {
+        auto it = por_anio.find(catalogo.anio[id]);
+        if (it != por_anio.end() && it->second.eliminar(id) && it->second.size() == 0) {
+            por_anio.erase(it);
+        }
+    }
+
+    // Reemplaza el contenido a partir de ids ya ordenados por nombre
+    void construir(const vector<uint32_t>& ids) {
+        map<int16_t, vector<uint32_t>> listas;
+        for (uint32_t id : ids) {
+            listas[catalogo.anio[id]].push_back(id);
+        }
+        por_anio.clear();
+        for (auto& [anio, lista] : listas) {
+            lista_de(anio).construir_desde_ordenado(move(lista));
+        }
+    }
+
+    size_t contar(int desde, int hasta) const {
+        size_t total = 0;
+        for (auto it = por_anio.lower_bound(desde); it != por_anio.end() && it->first <= hasta; ++it) {
+            total += it->second.size();
+        }
+        return total;
+    }
+
+    // Hasta `cantidad` ids a partir de la posición `inicio` de los años
+    // [desde, hasta], por año y luego por nombre
+    vector<uint32_t> rango(int desde, int hasta, size_t inicio, size_t cantidad) const {
+        vector<uint32_t> resultado;
+        for (auto it = por_anio.lower_bound(desde);
+             it != por_anio.end() && it->first <= hasta && resultado.size() < cantidad; ++it) {
+            const BTree& lista = it->second;
+            if (inicio >= lista.size()) {
+                inicio -= lista.size();
+                continue;
+            }
+            auto parte = lista.rango(inicio, cantidad - resultado.size());
+            resultado.insert(resultado.end(), parte.begin(), parte.end());
+            inicio = 0;
+        }
+        return resultado;
+    }
+
+private:
+    int tamano_maximo;
+    const CatalogoColumnar& catalogo;
+    map<int16_t, BTree> por_anio;
+
+    BTree& lista_de(int16_t anio) {
+        return por_anio.try_emplace(anio, tamano_maximo, catalogo).first->second;
+    }
+};
+
+// Reproducción aleatoria sobre ids del catálogo, sin copiar canciones ni
+// reservar memoria al elegir. Usa un mt19937 sembrado una sola vez.
+// - Mezcla: Fisher–Yates perezoso. `orden` se divide en las canciones que
+//   faltan sonar en la vuelta [0, pendientes) y las que ya sonaron; elegir
+//   cambia una pendiente al azar con la del borde, en O(1). Ninguna se repite
+//   hasta que suenan todas, y entonces empieza otra vuelta.
+// - Ponderada: árbol de Fenwick con el peso de cada id (popularidad + 1, para
+//   que las de popularidad 0 también suenen); elegir, agregar y quitar cuestan O(log n).
+class MotorReproduccion {
+public:
+    static constexpr uint32_t SIN_CANCION = UINT32_MAX;
+
+    MotorReproduccion() : generador(random_device{}()) {}
+    explicit MotorReproduccion(uint32_t semilla) : generador(semilla) {}
+
+    size_t size() const {
+        return orden.size();
+    }
+
+    // Canciones que faltan sonar en la vuelta actual de la mezcla
+    size_t pendientes_en_vuelta() const {
+        return pendientes;
+    }
+
+    // Las canciones nuevas entran a la vuelta actual. Devuelve false si ya estaba.
+    bool agregar(uint32_t id, uint8_t popularidad) {
+        if (contiene(id)) {
+            return false;
+        }
+        asegurar_capacidad(id);
+        posicion[id] = static_cast<uint32_t>(orden.size());
+        orden.push_back(id);
+        intercambiar(posicion[id], pendientes);
+        pendientes++;
+        sumar_peso(id, int64_t{popularidad} + 1);
+        return true;
+    }
+
+    // Agrega varias canciones y rehace el árbol de Fenwick una sola vez, en O(n)
+    void agregar_lote(const vector<uint32_t>& ids, const vector<uint8_t>& popularidad) {
+        if (ids.empty()) {
+            return;
+        }
+        asegurar_capacidad(*max_element(ids.begin(), ids.end()));
+        for (uint32_t id : ids) {
+            if (contiene(id)) {
+                continue;
+            }
+            posicion[id] = static_cast<uint32_t>(orden.size());
+            orden.push_back(id);
+            intercambiar(posicion[id], pendientes);
+            pendientes++;
+            pesos[id] = popularidad[id] + 1u;
+        }
+        reconstruir_fenwick();
+    }
+
+    bool quitar(uint32_t id) {
+        if (!contiene(id)) {
+            return false;
+        }
+        size_t pos = posicion[id];
+        if (pos < pendientes) {
+            // El hueco pasa al borde de la zona pendiente, que se achica
+            pendientes--;
+            intercambiar(pos, pendientes);
+            pos = pendientes;
+        }
+        intercambiar(pos, orden.size() - 1);
+        orden.pop_back();
+        posicion[id] = SIN_CANCION;
+        sumar_peso(id, -static_cast<int64_t>(pesos[id]));
+        return true;
+    }
+
+    // Siguiente canción de la mezcla, o SIN_CANCION si no hay canciones
+    uint32_t siguiente_mezcla() {
+        if (orden.empty()) {
+            return SIN_CANCION;
+        }
+        if (pendientes == 0) {
+            pendientes = orden.size();
+        }
+        size_t elegida = uniform_int_distribution<size_t>(0, pendientes - 1)(generador);
+        pendientes--;
+        intercambiar(elegida, pendientes);
+        return orden[pendientes];
+    }
+
+    // Canción al azar con probabilidad proporcional a su peso, o SIN_CANCION
+    uint32_t siguiente_ponderada() {
+        if (peso_total == 0) {
+            return SIN_CANCION;
+        }
+        uint64_t resto = uniform_int_distribution<uint64_t>(0, peso_total - 1)(generador);
+        // Se baja por el árbol de Fenwick buscando el primer prefijo mayor que `resto`
+        size_t pos = 0;
+        size_t n = fenwick.size() - 1;
+        for (size_t paso = size_t{1} << (63 - __builtin_clzll(n)); paso > 0; paso >>= 1) {
+            if (pos + paso <= n && fenwick[pos + paso] <= resto) {
+                pos += paso;
+                resto -= fenwick[pos];
+            }
+        }
+        return static_cast<uint32_t>(pos);
+    }
+
+    // Tras compactar el catálogo: id_nuevo[id] es el id nuevo de cada canción.
+    // La vuelta de la mezcla en curso se conserva.
+    void reasignar(const vector<uint32_t>& id_nuevo) {
+        vector<uint32_t> pesos_nuevos;
+        for (uint32_t& id : orden) {
+            uint32_t nuevo = id_nuevo[id];
+            if (nuevo >= pesos_nuevos.size()) {
+                pesos_nuevos.resize(static_cast<size_t>(nuevo) + 1, 0);
+            }
+            pesos_nuevos[nuevo] = pesos[id];
+            id = nuevo;
+        }
+        pesos = move(pesos_nuevos);
+        posicion.assign(pesos.size(), SIN_CANCION);
+        for (size_t i = 0; i < orden.size(); ++i) {
+            posicion[orden[i]] = static_cast<uint32_t>(i);
+        }
+        reconstruir_fenwick();
+    }
+
+private:
+    mt19937 generador;
+    vector<uint32_t> orden;
+    vector<uint32_t> posicion;   // lugar de cada id en `orden`, o SIN_CANCION
+    size_t pendientes = 0;
+    vector<uint32_t> pesos;      // peso de cada id (0 si no está)
+    vector<uint64_t> fenwick;    // base 1: fenwick[i] suma los pesos de (i - lsb(i), i]
+    uint64_t peso_total = 0;
+
+    bool contiene(uint32_t id) const {
+        return id < posicion.size() && posicion[id] != SIN_CANCION;
+    }
+
+    void intercambiar(size_t a, size_t b) {
+        swap(orden[a], orden[b]);
+        posicion[orden[a]] = static_cast<uint32_t>(a);
+        posicion[orden[b]] = static_cast<uint32_t>(b);
+    }
+
+    // Los ids crecen con el catálogo: la capacidad se duplica y el árbol de
+    // Fenwick se rehace, en O(n) amortizado
+    void asegurar_capacidad(uint32_t id) {
+        if (id < pesos.size()) {
+            return;
+        }
+        size_t capacidad = max<size_t>({pesos.size() * 2, static_cast<size_t>(id) + 1, 1024});
+        pesos.resize(capacidad, 0);
+        posicion.resize(capacidad, SIN_CANCION);
+        reconstruir_fenwick();
+    }
+
+    void reconstruir_fenwick() {
+        size_t n = pesos.size();
+        fenwick.assign(n + 1, 0);
+        peso_total = 0;
+        for (size_t i = 1; i <= n; ++i) {
+            fenwick[i] += pesos[i - 1];
+            peso_total += pesos[i - 1];
+            size_t padre = i + (i & (~i + 1));
+            if (padre <= n) {
+                fenwick[padre] += fenwick[i];
+            }
+        }
+    }
+
+    void sumar_peso(uint32_t id, int64_t delta) {
+        pesos[id] = static_cast<uint32_t>(pesos[id] + delta);
+        peso_total += delta;
+        for (size_t i = static_cast<size_t>(id) + 1; i < fenwick.size(); i += i & (~i + 1)) {
+            fenwick[i] += delta;
+        }
+    }
+};
+
+// Rasgos de audio de las canciones en una matriz de floats por columnas: la
+// columna f ocupa datos[f * paso, f * paso + filas). Cada rasgo se estandariza
+// (media 0, desviación 1) para que tempo o volumen no dominen la distancia.
+// Las consultas recorren todas las filas por bloques que caben en la caché,
+// acumulando la distancia ponderada de a 4 canciones con SSE2.
+class MatrizRasgos {
+public:
+    static constexpr size_t NUM_RASGOS = 9;
+    using Pesos = array<float, NUM_RASGOS>;
+
+    static Pesos pesos_iguales() {
+        Pesos pesos;
+        pesos.fill(1.0f);
+        return pesos;
+    }
+
+    static const char* nombre_rasgo(size_t f) {
+        static const char* const nombres[NUM_RASGOS] = {
+            "danceability", "energy", "loudness", "speechiness", "acousticness",
+            "instrumentalness", "liveness", "valence", "tempo"};
+        return nombres[f];
+    }
+
+    static const vector<float>& columna(const CatalogoColumnar& catalogo, size_t f) {
+        const vector<float>* columnas[NUM_RASGOS] = {
+            &catalogo.danceability, &catalogo.energy, &catalogo.loudness,
+            &catalogo.speechiness, &catalogo.acousticness, &catalogo.instrumentalness,
+            &catalogo.liveness, &catalogo.valence, &catalogo.tempo};
+        return *columnas[f];
+    }
+
+    // Media y escala (1 / desviación) de cada rasgo sobre un conjunto de
+    // canciones, y el mínimo y el máximo que se vieron al calcularlas
+    struct Escala {
+        array<float, NUM_RASGOS> media{};
+        array<float, NUM_RASGOS> escala{};
+        array<float, NUM_RASGOS> minimo{};
+        array<float, NUM_RASGOS> maximo{};
+
+        // Sin calcular no cubre ninguna canción
+        Escala() {
+            minimo.fill(numeric_limits<float>::infinity());
+            maximo.fill(-numeric_limits<float>::infinity());
+        }
+
+        void calcular(const CatalogoColumnar& catalogo, const vector<uint32_t>& ids) {
+            for (size_t f = 0; f < NUM_RASGOS; ++f) {
+                const vector<float>& origen = columna(catalogo, f);
+                double suma = 0;
+                double suma_cuadrados = 0;
+                minimo[f] = numeric_limits<float>::infinity();
+                maximo[f] = -numeric_limits<float>::infinity();
+                for (uint32_t id : ids) {
+                    suma += origen[id];
+                    suma_cuadrados += double{origen[id]} * origen[id];
+                    minimo[f] = min(minimo[f], origen[id]);
+                    maximo[f] = max(maximo[f], origen[id]);
+                }
+                double n = max<double>(1, ids.size());
+                media[f] = static_cast<float>(suma / n);
+                double varianza = suma_cuadrados / n - (suma / n) * (suma / n);
+                escala[f] = varianza > 1e-12 ? static_cast<float>(1 / sqrt(varianza)) : 0.0f;
+            }
+        }
+
+        // true si todos los rasgos de la canción caen en [mínimo, máximo]
+        bool cubre(const CatalogoColumnar& catalogo, uint32_t id) const {
+            for (size_t f = 0; f < NUM_RASGOS; ++f) {
+                float valor = columna(catalogo, f)[id];
+                if (!(valor >= minimo[f] && valor <= maximo[f])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        array<float, NUM_RASGOS> aplicar(const CatalogoColumnar& catalogo, uint32_t id) const {
+            array<float, NUM_RASGOS> rasgos;
+            for (size_t f = 0; f < NUM_RASGOS; ++f) {
+                rasgos[f] = (columna(catalogo, f)[id] - media[f]) * escala[f];
+            }
+            return rasgos;
+        }
+    };
+
+    // Las filas son las canciones vivas del catálogo, en orden de id
+    void construir(const CatalogoColumnar& catalogo) {
+        ids.clear();
+        fila_de_id.assign(catalogo.size(), SIN_FILA);
+        for (uint32_t id = 0; id < catalogo.size(); ++id) {
+            if (catalogo.esta_viva(id)) {
+                fila_de_id[id] = static_cast<uint32_t>(ids.size());
+                ids.push_back(id);
+            }
+        }
+        estandar.calcular(catalogo, ids);
+        paso = (ids.size() + 3) & ~size_t{3};
+        datos.assign(NUM_RASGOS * paso, 0.0f);
+        for (size_t f = 0; f < NUM_RASGOS; ++f) {
+            const vector<float>& origen = columna(catalogo, f);
+            float* destino = datos.data() + f * paso;
+            for (size_t fila = 0; fila < ids.size(); ++fila) {
+                destino[fila] = (origen[ids[fila]] - estandar.media[f]) * estandar.escala[f];
+            }
+        }
+    }
+
+    // Agrega la canción como última fila con la estandarización ya calculada.
+    // Si algún rasgo cae fuera del [mínimo, máximo] visto al construir no la
+    // agrega y devuelve false: hay que reconstruir para renormalizar.
+    bool agregar(const CatalogoColumnar& catalogo, uint32_t id) {
+        if (!estandar.cubre(catalogo, id)) {
+            return false;
+        }
+        if (ids.size() == paso) {
+            // Las columnas crecen al doble para que agregar sea O(1) amortizado
+            size_t nuevo_paso = max<size_t>(64, paso * 2);
+            vector<float> ampliados(NUM_RASGOS * nuevo_paso, 0.0f);
+            for (size_t f = 0; f < NUM_RASGOS; ++f) {
+                copy(datos.begin() + f * paso, datos.begin() + f * paso + ids.size(),
+                     ampliados.begin() + f * nuevo_paso);
+            }
+            datos = move(ampliados);
+            paso = nuevo_paso;
+        }
+        auto rasgos = estandar.aplicar(catalogo, id);
+        for (size_t f = 0; f < NUM_RASGOS; ++f) {
+            datos[f * paso + ids.size()] = rasgos[f];
+        }
+        if (id >= fila_de_id.size()) {
+            fila_de_id.resize(static_cast<size_t>(id) + 1, SIN_FILA);
+        }
+        fila_de_id[id] = static_cast<uint32_t>(ids.size());
+        ids.push_back(id);
+        return true;
+    }
+
+    // Quita la fila de la canción poniendo la última en su lugar
+    void quitar(uint32_t id) {
+        if (id >= fila_de_id.size() || fila_de_id[id] == SIN_FILA) {
+            return;
+        }
+        size_t fila = fila_de_id[id];
+        size_t ultima = ids.size() - 1;
+        if (fila != ultima) {
+            for (size_t f = 0; f < NUM_RASGOS; ++f) {
+                datos[f * paso + fila] = datos[f * paso + ultima];
+            }
+            ids[fila] = ids[ultima];
+            fila_de_id[ids[fila]] = static_cast<uint32_t>(fila);
+        }
+        for (size_t f = 0; f < NUM_RASGOS; ++f) {
+            datos[f * paso + ultima] = 0.0f;
+        }
+        ids.pop_back();
+        fila_de_id[id] = SIN_FILA;
+    }
+
+    // Traduce los ids del catálogo tras compactarlo
+    void reasignar(const vector<uint32_t>& id_nuevo) {
+        fila_de_id.assign(fila_de_id.size(), SIN_FILA);
+        for (size_t fila = 0; fila < ids.size(); ++fila) {
+            ids[fila] = id_nuevo[ids[fila]];
+            fila_de_id[ids[fila]] = static_cast<uint32_t>(fila);
+        }
+    }
+
+    size_t filas() const {
+        return ids.size();
+    }
+
+    // Rasgos estandarizados de una canción del catálogo
+    array<float, NUM_RASGOS> rasgos_de(const CatalogoColumnar& catalogo, uint32_t id) const {
+        return estandar.aplicar(catalogo, id);
+    }
+
+    // Las k canciones más cercanas a `consulta` (distancia euclídea al
+    // cuadrado, ponderada por rasgo), de la más cercana a la más lejana, sin
+    // contar `excluir`. Las filas se reparten entre `hilos` hilos; cada uno
+    // guarda sus k mejores en un montículo acotado y al final se unen.
+    // Definida después de ejecutar_en_paralelo.
+    vector<pair<float, uint32_t>> vecinos(const array<float, NUM_RASGOS>& consulta, size_t k,
+                                          const Pesos& pesos, uint32_t excluir, size_t hilos) const;
+
+private:
+    static constexpr size_t BLOQUE = 1024;   // filas por bloque: 9 columnas de 4 KB
+    static constexpr uint32_t SIN_FILA = UINT32_MAX;
+
+    vector<float> datos;
+    vector<uint32_t> ids;          // id del catálogo de cada fila
+    vector<uint32_t> fila_de_id;   // fila de cada id del catálogo, o SIN_FILA
+    size_t paso = 0;        // filas reservadas por columna (múltiplo de 4)
+    Escala estandar;
+
+    // Distancias de las filas [desde, hasta) a la consulta, en `distancias`
+    void distancias_bloque(size_t desde, size_t hasta, const array<float, NUM_RASGOS>& consulta,
+                           const Pesos& pesos, float* distancias) const {
+        fill(distancias, distancias + (hasta - desde), 0.0f);
+        for (size_t f = 0; f < NUM_RASGOS; ++f) {
+            if (pesos[f] == 0.0f) {
+                continue;
+            }
+            const float* valores = datos.data() + f * paso;
+            size_t fila = desde;
+#if defined(__SSE2__)
+            const __m128 q = _mm_set1_ps(consulta[f]);
+            const __m128 w = _mm_set1_ps(pesos[f]);
+            for (; fila + 4 <= hasta; fila += 4) {
+                __m128 diferencia = _mm_sub_ps(_mm_loadu_ps(valores + fila), q);
+                __m128 acumulada = _mm_loadu_ps(distancias + (fila - desde));
+                acumulada = _mm_add_ps(acumulada, _mm_mul_ps(w, _mm_mul_ps(diferencia, diferencia)));
+                _mm_storeu_ps(distancias + (fila - desde), acumulada);
+            }
+#endif
+            for (; fila < hasta; ++fila) {
+                float diferencia = valores[fila] - consulta[f];
+                distancias[fila - desde] += pesos[f] * diferencia * diferencia;
+            }
+        }
+    }
+};
+
+// Grafo HNSW (Hierarchical Navigable Small World) sobre los rasgos de audio
+// estandarizados, para buscar canciones parecidas sin recorrer el catálogo.
+// Cada nodo es una canción (guarda su id del catálogo) y vive en los niveles
+// 0..nivel; el nivel se sortea con probabilidad decreciente, así que los
+// niveles altos tienen pocos nodos y sirven de atajos. Una búsqueda baja
+// codiciosamente por los niveles altos y explora el nivel 0 con una lista de
+// `ef` candidatos: más candidatos, mejor exhaustividad y menos velocidad.
+// Las bajas solo marcan el nodo: sigue sirviendo de paso, pero no se devuelve.
+class IndiceHNSW {
+public:
+    static constexpr uint32_t SIN_NODO = UINT32_MAX;
+    static constexpr size_t DIMENSION = 12;   // 9 rasgos rellenados a múltiplo de 4
+
+    struct Parametros {
+        uint32_t m = 16;                  // vecinos por nodo en los niveles altos (2m en el 0)
+        uint32_t ef_construccion = 100;   // candidatos al insertar
+        uint32_t ef_busqueda = 64;        // candidatos al buscar
+    };
+
+    Parametros parametros;
+
+    // Rehace el grafo con las canciones vivas; fija la estandarización de
+    // los rasgos, que las inserciones siguientes reutilizan
+    void construir(const CatalogoColumnar& catalogo, const Parametros& nuevos) {
+        parametros = nuevos;
+        parametros.m = max<uint32_t>(parametros.m, 2);
+        vector<uint32_t> vivas;
+        for (uint32_t id = 0; id < catalogo.size(); ++id) {
+            if (catalogo.esta_viva(id)) {
+                vivas.push_back(id);
+            }
+        }
+        estandar.calcular(catalogo, vivas);
+        vaciar();
+        reservar(vivas.size());
+        for (uint32_t id : vivas) {
+            insertar(catalogo, id);
+        }
+    }
+
+    void insertar(const CatalogoColumnar& catalogo, uint32_t id) {
+        if (id < nodo_de_id.size() && nodo_de_id[id] != SIN_NODO) {
+            return;
+        }
+        uint32_t nodo = static_cast<uint32_t>(id_de_nodo.size());
+        uint32_t nivel = sortear_nivel();
+        agregar_nodo(id, nivel, estandar.aplicar(catalogo, id));
+
+        if (entrada == SIN_NODO) {
+            entrada = nodo;
+            nivel_maximo = nivel;
+            return;
+        }
+        const float* consulta = vector_de(nodo);
+        uint32_t actual = entrada;
+        for (uint32_t capa = nivel_maximo; capa > nivel; --capa) {
+            actual = bajar_codicioso(consulta, actual, capa);
+        }
+        for (uint32_t capa = min(nivel, nivel_maximo) + 1; capa-- > 0;) {
+            vector<pair<float, uint32_t>> candidatos =
+                buscar_en_capa(consulta, actual, parametros.ef_construccion, capa);
+            actual = candidatos.front().second;
+            vector<uint32_t> elegidos = seleccionar_vecinos(candidatos, parametros.m);
+            enlaces_fijar(nodo, capa, elegidos);
+            for (uint32_t vecino : elegidos) {
+                enlazar(vecino, nodo, capa);
+            }
+        }
+        if (nivel > nivel_maximo) {
+            nivel_maximo = nivel;
+            entrada = nodo;
+        }
+    }
+
+    // Marca la canción como eliminada; devuelve false si no estaba
+    bool eliminar(uint32_t id) {
+        if (id >= nodo_de_id.size() || nodo_de_id[id] == SIN_NODO) {
+            return false;
+        }
+        borrado[nodo_de_id[id]] = 1;
+        nodo_de_id[id] = SIN_NODO;
+        borrados++;
+        return true;
+    }
+
+    // Traduce los ids del catálogo tras compactarlo
+    void reasignar(const vector<uint32_t>& id_nuevo) {
+        nodo_de_id.assign(nodo_de_id.size(), SIN_NODO);
+        for (uint32_t nodo = 0; nodo < id_de_nodo.size(); ++nodo) {
+            if (!borrado[nodo]) {
+                id_de_nodo[nodo] = id_nuevo[id_de_nodo[nodo]];
+                nodo_de_id[id_de_nodo[nodo]] = nodo;
+            }
+        }
+    }
+
+    // Las k canciones más cercanas a la canción `id`, de la más cercana a la
+    // más lejana, sin contarla a ella. `ef` = 0 usa parametros.ef_busqueda.
+    // Solo lee el grafo, así que varias búsquedas pueden correr a la vez.
+    vector<pair<float, uint32_t>> buscar(const CatalogoColumnar& catalogo, uint32_t id, size_t k,
+                                         size_t ef = 0) const {
+        if (entrada == SIN_NODO || k == 0) {
+            return {};
+        }
+        float consulta[DIMENSION] = {};
+        uint32_t propio = id < nodo_de_id.size() ? nodo_de_id[id] : SIN_NODO;
+        if (propio != SIN_NODO) {
+            copy(vector_de(propio), vector_de(propio) + DIMENSION, consulta);
+        } else {
+            auto rasgos = estandar.aplicar(catalogo, id);
+            copy(rasgos.begin(), rasgos.end(), consulta);
+        }
+
+        uint32_t actual = entrada;
+        for (uint32_t capa = nivel_maximo; capa > 0; --capa) {
+            actual = bajar_codicioso(consulta, actual, capa);
+        }
+        // Uno más por la propia canción, que casi siempre aparece primero
+        size_t candidatos = max<size_t>(ef == 0 ? parametros.ef_busqueda : ef, k + 1);
+        vector<pair<float, uint32_t>> resultado;
+        for (const auto& [distancia, nodo] : buscar_en_capa(consulta, actual, candidatos, 0)) {
+            if (!borrado[nodo] && nodo != propio && resultado.size() < k) {
+                resultado.emplace_back(distancia, id_de_nodo[nodo]);
+            }
+        }
+        return resultado;
+    }
+
+    size_t size() const {
+        return id_de_nodo.size() - borrados;
+    }
+
+    size_t eliminados() const {
+        return borrados;
+    }
+
+    void guardar(EscritorInstantanea& escritor) const {
+        escritor.escribir_valor(parametros);
+        escritor.escribir_valor(estandar);
+        escritor.escribir_valor(entrada);
+        escritor.escribir_valor(nivel_maximo);
+        escritor.escribir_arreglo(id_de_nodo);
+        escritor.escribir_arreglo(nivel_de_nodo);
+        escritor.escribir_arreglo(borrado);
+        escritor.escribir_arreglo(vectores);
+        escritor.escribir_arreglo(enlaces_base);
+        escritor.escribir_arreglo(inicio_superiores);
+        escritor.escribir_arreglo(enlaces_superiores);
+    }
+
+    // Lanza runtime_error si el contenido no es un grafo coherente
+    void cargar(LectorInstantanea& lector) {
+        lector.leer_valor(parametros);
+        lector.leer_valor(estandar);
+        lector.leer_valor(entrada);
+        lector.leer_valor(nivel_maximo);
+        lector.leer_arreglo(id_de_nodo);
+        lector.leer_arreglo(nivel_de_nodo);
+        lector.leer_arreglo(borrado);
+        lector.leer_arreglo(vectores);
+        lector.leer_arreglo(enlaces_base);
+        lector.leer_arreglo(inicio_superiores);
+        lector.leer_arreglo(enlaces_superiores);
+
+        size_t nodos = id_de_nodo.size();
+        bool coherente = parametros.m >= 2 && parametros.m <= 1024 && nivel_de_nodo.size() == nodos &&
+            borrado.size() == nodos && vectores.size() == nodos * DIMENSION &&
+            enlaces_base.size() == nodos * ranuras(0) && inicio_superiores.size() == nodos + 1 &&
+            inicio_superiores.back() == enlaces_superiores.size() &&
+            (nodos == 0 ? entrada == SIN_NODO : entrada < nodos && nivel_de_nodo[entrada] == nivel_maximo);
+        for (uint32_t nodo = 0; coherente && nodo < nodos; ++nodo) {
+            coherente = nivel_de_nodo[nodo] <= nivel_maximo &&
+                inicio_superiores[nodo + 1] - inicio_superiores[nodo] ==
+                    uint64_t{nivel_de_nodo[nodo]} * ranuras(1);
+            for (uint32_t capa = 0; coherente && capa <= nivel_de_nodo[nodo]; ++capa) {
+                const uint32_t* lista = enlaces(nodo, capa);
+                coherente = lista[0] < ranuras(capa) &&
+                    all_of(lista + 1, lista + 1 + lista[0], [&](uint32_t v) {
+                        return v < nodos && nivel_de_nodo[v] >= capa;
+                    });
+            }
+        }
+        if (!coherente) {
+            vaciar();
+            throw runtime_error("índice de vecinos inconsistente");
+        }
+        borrados = 0;
+        nodo_de_id.clear();
+        for (uint32_t nodo = 0; nodo < nodos; ++nodo) {
+            if (borrado[nodo]) {
+                borrados++;
+                continue;
+            }
+            uint32_t id = id_de_nodo[nodo];
+            if (id >= nodo_de_id.size()) {
+                nodo_de_id.resize(id + 1, SIN_NODO);
+            }
+            if (nodo_de_id[id] != SIN_NODO) {
+                vaciar();
+                throw runtime_error("índice de vecinos inconsistente");
+            }
+            nodo_de_id[id] = nodo;
+        }
+    }
+
+    // true si el índice tiene exactamente las canciones vivas del catálogo
+    bool coincide_con(const CatalogoColumnar& catalogo) const {
+        if (size() != catalogo.total_vivas()) {
+            return false;
+        }
+        for (uint32_t nodo = 0; nodo < id_de_nodo.size(); ++nodo) {
+            if (!borrado[nodo] && (id_de_nodo[nodo] >= catalogo.size() ||
+                                   !catalogo.esta_viva(id_de_nodo[nodo]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t memoria() const {
+        return id_de_nodo.capacity() * sizeof(uint32_t) + nivel_de_nodo.capacity() +
+            borrado.capacity() + vectores.capacity() * sizeof(float) +
+            (enlaces_base.capacity() + inicio_superiores.capacity() +
+             enlaces_superiores.capacity() + nodo_de_id.capacity()) * sizeof(uint32_t);
+    }
+
+private:
+    MatrizRasgos::Escala estandar;
+    uint32_t entrada = SIN_NODO;
+    uint32_t nivel_maximo = 0;
+    size_t borrados = 0;
+    mt19937 generador{0x484e5357};
+
+    vector<uint32_t> id_de_nodo;
+    vector<uint8_t> nivel_de_nodo;
+    vector<uint8_t> borrado;
+    vector<float> vectores;               // DIMENSION floats por nodo
+    // Listas de vecinos: [cantidad][vecino]... con espacio fijo por nivel.
+    // El nivel 0 de todos los nodos va en un arreglo; los niveles 1..nivel
+    // de cada nodo van seguidos en enlaces_superiores desde inicio_superiores[nodo].
+    vector<uint32_t> enlaces_base;
+    vector<uint32_t> inicio_superiores{0};
+    vector<uint32_t> enlaces_superiores;
+    vector<uint32_t> nodo_de_id;
+
+    uint32_t ranuras(uint32_t capa) const {
+        return (capa == 0 ? 2 * parametros.m : parametros.m) + 1;
+    }
+
+    void vaciar() {
+        entrada = SIN_NODO;
+        nivel_maximo = 0;
+        borrados = 0;
+        id_de_nodo.clear();
+        nivel_de_nodo.clear();
+        borrado.clear();
+        vectores.clear();
+        enlaces_base.clear();
+        inicio_superiores.assign(1, 0);
+        enlaces_superiores.clear();
+        nodo_de_id.clear();
+    }
+
+    void reservar(size_t nodos) {
+        id_de_nodo.reserve(nodos);
+        nivel_de_nodo.reserve(nodos);
+        borrado.reserve(nodos);
+        vectores.reserve(nodos * DIMENSION);
+        enlaces_base.reserve(nodos * ranuras(0));
+        inicio_superiores.reserve(nodos + 1);
+    }
+
+    uint32_t sortear_nivel() {
+        uniform_real_distribution<double> uniforme(numeric_limits<double>::min(), 1.0);
+        double nivel = -log(uniforme(generador)) / log(static_cast<double>(parametros.m));
+        return static_cast<uint32_t>(min(nivel, 30.0));
+    }
+
+    void agregar_nodo(uint32_t id, uint32_t nivel, const array<float, MatrizRasgos::NUM_RASGOS>& rasgos) {
+        uint32_t nodo = static_cast<uint32_t>(id_de_nodo.size());
+        id_de_nodo.push_back(id);
+        nivel_de_nodo.push_back(static_cast<uint8_t>(nivel));
+        borrado.push_back(0);
+        vectores.insert(vectores.end(), rasgos.begin(), rasgos.end());
+        vectores.resize(vectores.size() + DIMENSION - rasgos.size(), 0.0f);
+        enlaces_base.resize(enlaces_base.size() + ranuras(0), 0);
+        enlaces_superiores.resize(enlaces_superiores.size() + size_t{nivel} * ranuras(1), 0);
+        inicio_superiores.push_back(static_cast<uint32_t>(enlaces_superiores.size()));
+        if (id >= nodo_de_id.size()) {
+            nodo_de_id.resize(max<size_t>(id + 1, nodo_de_id.size() * 2), SIN_NODO);
+        }
+        nodo_de_id[id] = nodo;
+    }
+
+    const float* vector_de(uint32_t nodo) const {
+        return vectores.data() + size_t{nodo} * DIMENSION;
+    }
+
+    uint32_t* enlaces(uint32_t nodo, uint32_t capa) {
+        return capa == 0 ? enlaces_base.data() + size_t{nodo} * ranuras(0)
+                         : enlaces_superiores.data() + inicio_superiores[nodo] + (capa - 1) * ranuras(1);
+    }
+
+    const uint32_t* enlaces(uint32_t nodo, uint32_t capa) const {
+        return const_cast<IndiceHNSW*>(this)->enlaces(nodo, capa);
+    }
+
+    float distancia(const float* a, uint32_t nodo) const {
+        const float* b = vector_de(nodo);
+#if defined(__SSE2__)
+        __m128 suma = _mm_setzero_ps();
+        for (size_t i = 0; i < DIMENSION; i += 4) {
+            __m128 diferencia = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+            suma = _mm_add_ps(suma, _mm_mul_ps(diferencia, diferencia));
+        }
+        suma = _mm_add_ps(suma, _mm_movehl_ps(suma, suma));
+        suma = _mm_add_ss(suma, _mm_shuffle_ps(suma, suma, 1));
+        return _mm_cvtss_f32(suma);
+#else
+        float suma = 0;
+        for (size_t i = 0; i < DIMENSION; ++i) {
+            suma += (a[i] - b[i]) * (a[i] - b[i]);
+        }
+        return suma;
+#endif
+    }
+
+    // Avanza al vecino más cercano mientras alguno mejore
+    uint32_t bajar_codicioso(const float* consulta, uint32_t actual, uint32_t capa) const {
+        float mejor = distancia(consulta, actual);
+        for (bool mejoro = true; mejoro;) {
+            mejoro = false;
+            const uint32_t* lista = enlaces(actual, capa);
+            for (uint32_t i = 1; i <= lista[0]; ++i) {
+                float d = distancia(consulta, lista[i]);
+                if (d < mejor) {
+                    mejor = d;
+                    actual = lista[i];
+                    mejoro = true;
+                }
+            }
+        }
+        return actual;
+    }
+
+    // Búsqueda de mejor primero en una capa: devuelve hasta `ef` nodos
+    // ordenados de más cercano a más lejano
+    vector<pair<float, uint32_t>> buscar_en_capa(const float* consulta, uint32_t inicio, size_t ef,
+                                                 uint32_t capa) const {
+        // Marcas de visita por hilo: cada búsqueda usa una época nueva en
+        // lugar de limpiar el arreglo
+        thread_local vector<uint32_t> visitado;
+        thread_local uint32_t epoca = 0;
+        if (visitado.size() < id_de_nodo.size()) {
+            visitado.assign(id_de_nodo.size() + id_de_nodo.size() / 2, 0);
+            epoca = 0;
+        }
+        if (++epoca == 0) {
+            fill(visitado.begin(), visitado.end(), 0);
+            epoca = 1;
+        }
+
+        using Candidato = pair<float, uint32_t>;
+        priority_queue<Candidato, vector<Candidato>, greater<Candidato>> pendientes;
+        priority_queue<Candidato> mejores;   // en la cima, el más lejano
+        float d = distancia(consulta, inicio);
+        pendientes.emplace(d, inicio);
+        mejores.emplace(d, inicio);
+        visitado[inicio] = epoca;
+        while (!pendientes.empty()) {
+            auto [distancia_actual, actual] = pendientes.top();
+            if (distancia_actual > mejores.top().first && mejores.size() >= ef) {
+                break;
+            }
+            pendientes.pop();
+            const uint32_t* lista = enlaces(actual, capa);
+            for (uint32_t i = 1; i <= lista[0]; ++i) {
+                uint32_t vecino = lista[i];
+                if (visitado[vecino] == epoca) {
+                    continue;
+                }
+                visitado[vecino] = epoca;
+                float dv = distancia(consulta, vecino);
+                if (mejores.size() < ef || dv < mejores.top().first) {
+                    pendientes.emplace(dv, vecino);
+                    mejores.emplace(dv, vecino);
+                    if (mejores.size() > ef) {
+                        mejores.pop();
+                    }
+                }
+            }
+        }
+        vector<Candidato> resultado(mejores.size());
+        for (size_t i = resultado.size(); i-- > 0; mejores.pop()) {
+            resultado[i] = mejores.top();
+        }
+        return resultado;
+    }
+
+    // Heurística de HNSW: se acepta un candidato (del más cercano al más
+    // lejano) solo si está más cerca del nodo que de los ya elegidos, para
+    // que los enlaces apunten en direcciones distintas
+    vector<uint32_t> seleccionar_vecinos(const vector<pair<float, uint32_t>>& candidatos,
+                                         size_t maximo) const {
+        vector<uint32_t> elegidos;
+        for (const auto& [distancia_nodo, candidato] : candidatos) {
+            if (elegidos.size() >= maximo) {
+                break;
+            }
+            const float* vector_candidato = vector_de(candidato);
+            bool diverso = all_of(elegidos.begin(), elegidos.end(), [&](uint32_t elegido) {
+                return distancia(vector_candidato, elegido) >= distancia_nodo;
+            });
+            if (diverso) {
+                elegidos.push_back(candidato);
+            }
+        }
+        return elegidos;
+    }
+
+    void enlaces_fijar(uint32_t nodo, uint32_t capa, const vector<uint32_t>& vecinos) {
+        uint32_t* lista = enlaces(nodo, capa);
+        lista[0] = static_cast<uint32_t>(vecinos.size());
+        copy(vecinos.begin(), vecinos.end(), lista + 1);
+    }
+
+    // Agrega `nuevo` a los vecinos de `nodo`; si ya no cabe, vuelve a elegir
+    // entre todos con la heurística
+    void enlazar(uint32_t nodo, uint32_t nuevo, uint32_t capa) {
+        uint32_t* lista = enlaces(nodo, capa);
+        uint32_t capacidad = ranuras(capa) - 1;
+        if (lista[0] < capacidad) {
+            lista[++lista[0]] = nuevo;
+            return;
+        }
+        const float* centro = vector_de(nodo);
+        vector<pair<float, uint32_t>> candidatos;
+        candidatos.reserve(capacidad + 1);
+        candidatos.emplace_back(distancia(centro, nuevo), nuevo);
+        for (uint32_t i = 1; i <= lista[0]; ++i) {
+            candidatos.emplace_back(distancia(centro, lista[i]), lista[i]);
+        }
+        sort(candidatos.begin(), candidatos.end());
+        enlaces_fijar(nodo, capa, seleccionar_vecinos(candidatos, capacidad));
+    }
+};
+
+// Conjunto de ids de 32 bits comprimido al estilo "roaring": los ids se
+// agrupan por sus 16 bits altos y cada grupo (contenedor) guarda sus 16 bits
+// bajos como arreglo ordenado, si son pocos, o como mapa de 65536 bits. Así
+// un conjunto disperso ocupa 2 bytes por id y uno denso 1 bit por id, y la
+// intersección y la unión trabajan contenedor por contenedor.
+class MapaBits {
+public:
+    static constexpr size_t MAXIMO_ARREGLO = 4096;   // más que esto ocupa más que un mapa
+    static constexpr size_t PALABRAS = 65536 / 64;
+
+    void agregar(uint32_t x) {
+        contenedor_para(static_cast<uint16_t>(x >> 16)).agregar(static_cast<uint16_t>(x));
+    }
+
+    void quitar(uint32_t x) {
+        size_t i = posicion_contenedor(static_cast<uint16_t>(x >> 16));
+        if (i < contenedores.size() && contenedores[i].quitar(static_cast<uint16_t>(x)) &&
+            contenedores[i].cantidad == 0) {
+            contenedores.erase(contenedores.begin() + i);
+        }
+    }
+
+    bool contiene(uint32_t x) const {
+        size_t i = posicion_contenedor(static_cast<uint16_t>(x >> 16));
+        return i < contenedores.size() && contenedores[i].contiene(static_cast<uint16_t>(x));
+    }
+
+    size_t cardinalidad() const {
+        size_t total = 0;
+        for (const auto& contenedor : contenedores) {
+            total += contenedor.cantidad;
+        }
+        return total;
+    }
+
+    bool vacio() const {
+        return contenedores.empty();
+    }
+
+    static MapaBits interseccion(const MapaBits& a, const MapaBits& b) {
+        MapaBits resultado;
+        auto x = a.contenedores.begin();
+        auto y = b.contenedores.begin();
+        while (x != a.contenedores.end() && y != b.contenedores.end()) {
+            if (x->clave < y->clave) {
+                ++x;
+            } else if (y->clave < x->clave) {
+                ++y;
+            } else {
+                Contenedor comun = Contenedor::interseccion(*x++, *y++);
+                if (comun.cantidad > 0) {
+                    resultado.contenedores.push_back(move(comun));
+                }
+            }
+        }
+        return resultado;
+    }
+
+    static MapaBits union_de(const MapaBits& a, const MapaBits& b) {
+        MapaBits resultado;
+        auto x = a.contenedores.begin();
+        auto y = b.contenedores.begin();
+        while (x != a.contenedores.end() || y != b.contenedores.end()) {
+            if (y == b.contenedores.end() || (x != a.contenedores.end() && x->clave < y->clave)) {
+                resultado.contenedores.push_back(*x++);
+            } else if (x == a.contenedores.end() || y->clave < x->clave) {
+                resultado.contenedores.push_back(*y++);
+            } else {
+                resultado.contenedores.push_back(Contenedor::union_de(*x++, *y++));
+            }
+        }
+        return resultado;
+    }
+
+    // Conserva solo los ids cuyo valor en `valores` está en [minimo, maximo].
+    // En los contenedores densos compara de a 4 valores con SSE2 y solo en
+    // las palabras que tienen algún id.
+    void retener_en_rango(const vector<float>& valores, float minimo, float maximo) {
+        for (auto& contenedor : contenedores) {
+            contenedor.retener_en_rango(valores, minimo, maximo);
+        }
+        contenedores.erase(remove_if(contenedores.begin(), contenedores.end(),
+                                     [](const Contenedor& c) { return c.cantidad == 0; }),
+                           contenedores.end());
+    }
+
+    // Los `cantidad` ids a partir de la posición `inicio` (en orden creciente).
+    // Salta contenedores completos por su cantidad y, dentro de un mapa,
+    // palabras completas por su número de bits.
+    vector<uint32_t> rango(size_t inicio, size_t cantidad) const {
+        vector<uint32_t> ids;
+        for (const auto& contenedor : contenedores) {
+            if (ids.size() == cantidad) {
+                break;
+            }
+            if (inicio >= contenedor.cantidad) {
+                inicio -= contenedor.cantidad;
+                continue;
+            }
+            uint32_t base = uint32_t{contenedor.clave} << 16;
+            if (!contenedor.es_mapa()) {
+                for (size_t i = inicio; i < contenedor.valores.size() && ids.size() < cantidad; ++i) {
+                    ids.push_back(base | contenedor.valores[i]);
+                }
+            } else {
+                for (size_t w = 0; w < PALABRAS && ids.size() < cantidad; ++w) {
+                    uint64_t palabra = contenedor.palabras[w];
+                    size_t bits = __builtin_popcountll(palabra);
+                    if (inicio >= bits) {
+                        inicio -= bits;
+                        continue;
+                    }
+                    for (; palabra != 0 && ids.size() < cantidad; palabra &= palabra - 1) {
+                        if (inicio > 0) {
+                            inicio--;
+                            continue;
+                        }
+                        ids.push_back(base | static_cast<uint32_t>(w * 64 + __builtin_ctzll(palabra)));
+                    }
+                }
+            }
+            inicio = 0;
+        }
+        return ids;
+    }
+
+    size_t memoria() const {
+        size_t bytes = contenedores.capacity() * sizeof(Contenedor);
+        for (const auto& contenedor : contenedores) {
+            bytes += contenedor.valores.capacity() * sizeof(uint16_t) +
+                contenedor.palabras.capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+    // Las cabeceras de los contenedores van en un arreglo y los valores y las
+    // palabras de todos ellos, seguidos, en otros dos
+    void guardar(EscritorInstantanea& escritor) const {
+        vector<ContenedorGuardado> cabeceras;
+        vector<uint16_t> valores;
+        vector<uint64_t> palabras;
+        cabeceras.reserve(contenedores.size());
+        for (const auto& contenedor : contenedores) {
+            cabeceras.push_back({contenedor.clave, contenedor.es_mapa(), contenedor.cantidad});
+            valores.insert(valores.end(), contenedor.valores.begin(), contenedor.valores.end());
+            palabras.insert(palabras.end(), contenedor.palabras.begin(), contenedor.palabras.end());
+        }
+        escritor.escribir_arreglo(cabeceras);
+        escritor.escribir_arreglo(valores);
+        escritor.escribir_arreglo(palabras);
+    }
+
+    // Lanza runtime_error si el contenido no es un mapa coherente o tiene
+    // algún id mayor o igual que `limite`
+    void cargar(LectorInstantanea& lector, size_t limite) {
+        vector<ContenedorGuardado> cabeceras;
+        vector<uint16_t> valores;
+        vector<uint64_t> palabras;
+        lector.leer_arreglo(cabeceras);
+        lector.leer_arreglo(valores);
+        lector.leer_arreglo(palabras);
+
+        vector<Contenedor> leidos(cabeceras.size());
+        size_t siguiente_valor = 0;
+        size_t siguiente_palabra = 0;
+        bool coherente = true;
+        for (size_t i = 0; coherente && i < cabeceras.size(); ++i) {
+            const ContenedorGuardado& cabecera = cabeceras[i];
+            Contenedor& contenedor = leidos[i];
+            contenedor.clave = cabecera.clave;
+            contenedor.cantidad = cabecera.cantidad;
+            coherente = cabecera.cantidad > 0 && (i == 0 || cabeceras[i - 1].clave < cabecera.clave);
+            if (coherente && cabecera.es_mapa) {
+                coherente = PALABRAS <= palabras.size() - siguiente_palabra;
+                if (coherente) {
+                    auto desde = palabras.begin() + siguiente_palabra;
+                    contenedor.palabras.assign(desde, desde + PALABRAS);
+                    siguiente_palabra += PALABRAS;
+                    size_t bits = 0;
+                    for (uint64_t palabra : contenedor.palabras) {
+                        bits += __builtin_popcountll(palabra);
+                    }
+                    coherente = bits == cabecera.cantidad;
+                }
+            } else if (coherente) {
+                coherente = cabecera.cantidad <= valores.size() - siguiente_valor;
+                if (coherente) {
+                    auto desde = valores.begin() + siguiente_valor;
+                    contenedor.valores.assign(desde, desde + cabecera.cantidad);
+                    siguiente_valor += cabecera.cantidad;
+                    coherente = adjacent_find(contenedor.valores.begin(), contenedor.valores.end(),
+                                              greater_equal<uint16_t>()) == contenedor.valores.end();
+                }
+            }
+        }
+        coherente = coherente && siguiente_valor == valores.size() && siguiente_palabra == palabras.size();
+        if (coherente && !leidos.empty()) {
+            // El mayor id está en el último contenedor
+            const Contenedor& ultimo = leidos.back();
+            size_t mayor = ultimo.valores.empty() ? 0 : ultimo.valores.back();
+            for (size_t w = PALABRAS; ultimo.es_mapa() && w-- > 0;) {
+                if (ultimo.palabras[w] != 0) {
+                    mayor = w * 64 + 63 - __builtin_clzll(ultimo.palabras[w]);
+                    break;
+                }
+            }
+            coherente = (size_t{ultimo.clave} << 16 | mayor) < limite;
+        }
+        if (!coherente) {
+            throw runtime_error("mapa de bits inconsistente");
+        }
+        contenedores = move(leidos);
+    }
+
+private:
+    struct ContenedorGuardado {
+        uint16_t clave;
+        uint16_t es_mapa;
+        uint32_t cantidad;
+    };
+
+    struct Contenedor {
+        uint16_t clave = 0;
+        uint32_t cantidad = 0;
+        vector<uint16_t> valores;   // arreglo ordenado, si no es mapa
+        vector<uint64_t> palabras;  // PALABRAS palabras, si es mapa
+
+        bool es_mapa() const {
+            return !palabras.empty();
+        }
+
+        bool contiene(uint16_t v) const {
+            if (es_mapa()) {
+                return (palabras[v >> 6] >> (v & 63)) & 1;
+            }
+            return binary_search(valores.begin(), valores.end(), v);
+        }
+
+        void agregar(uint16_t v) {
+            if (es_mapa()) {
+                uint64_t bit = uint64_t{1} << (v & 63);
+                cantidad += (palabras[v >> 6] & bit) == 0;
+                palabras[v >> 6] |= bit;
+                return;
+            }
+            // Los ids nuevos suelen ser los mayores: se agregan al final
+            if (valores.empty() || v > valores.back()) {
+                valores.push_back(v);
+            } else {
+                auto it = lower_bound(valores.begin(), valores.end(), v);
+                if (*it == v) {
+                    return;
+                }
+                valores.insert(it, v);
+            }
+            if (++cantidad > MAXIMO_ARREGLO) {
+                a_mapa();
+            }
+        }
+
+        bool quitar(uint16_t v) {
+            if (es_mapa()) {
+                uint64_t bit = uint64_t{1} << (v & 63);
+                if ((palabras[v >> 6] & bit) == 0) {
+                    return false;
+                }
+                palabras[v >> 6] &= ~bit;
+                // Con margen, para no ir y volver entre formas en el límite
+                if (--cantidad <= MAXIMO_ARREGLO / 2) {
+                    a_arreglo();
+                }
+                return true;
+            }
+            auto it = lower_bound(valores.begin(), valores.end(), v);
+            if (it == valores.end() || *it != v) {
+                return false;
+            }
+            valores.erase(it);
+            cantidad--;
+            return true;
+        }
+
+        void a_mapa() {
+            palabras.assign(PALABRAS, 0);
+            for (uint16_t v : valores) {
+                palabras[v >> 6] |= uint64_t{1} << (v & 63);
+            }
+            valores.clear();
+            valores.shrink_to_fit();
+        }
+
+        void a_arreglo() {
+            valores.clear();
+            valores.reserve(cantidad);
+            for (size_t w = 0; w < PALABRAS; ++w) {
+                for (uint64_t palabra = palabras[w]; palabra != 0; palabra &= palabra - 1) {
+                    valores.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(palabra)));
+                }
+            }
+            palabras.clear();
+            palabras.shrink_to_fit();
+        }
+
+        // Recuenta los bits de un mapa y pasa a arreglo si quedaron pocos
+        void normalizar_mapa() {
+            cantidad = 0;
+            for (uint64_t palabra : palabras) {
+                cantidad += __builtin_popcountll(palabra);
+            }
+            if (cantidad <= MAXIMO_ARREGLO) {
+                a_arreglo();
+            }
+        }
+
+        static Contenedor interseccion(const Contenedor& a, const Contenedor& b) {
+            Contenedor resultado;
+            resultado.clave = a.clave;
+            if (a.es_mapa() && b.es_mapa()) {
+                resultado.palabras.resize(PALABRAS);
+                for (size_t w = 0; w < PALABRAS; ++w) {
+                    resultado.palabras[w] = a.palabras[w] & b.palabras[w];
+                }
+                resultado.normalizar_mapa();
+            } else if (a.es_mapa() || b.es_mapa()) {
+                const Contenedor& arreglo = a.es_mapa() ? b : a;
+                const Contenedor& mapa = a.es_mapa() ? a : b;
+                for (uint16_t v : arreglo.valores) {
+                    if (mapa.contiene(v)) {
+                        resultado.valores.push_back(v);
+                    }
+                }
+                resultado.cantidad = static_cast<uint32_t>(resultado.valores.size());
+            } else {
+                set_intersection(a.valores.begin(), a.valores.end(), b.valores.begin(), b.valores.end(),
+                                 back_inserter(resultado.valores));
+                resultado.cantidad = static_cast<uint32_t>(resultado.valores.size());
+            }
+            return resultado;
+        }
+
+        static Contenedor union_de(const Contenedor& a, const Contenedor& b) {
+            Contenedor resultado;
+            resultado.clave = a.clave;
+            if (a.es_mapa() || b.es_mapa()) {
+                resultado.palabras.assign(PALABRAS, 0);
+                for (const Contenedor* parte : {&a, &b}) {
+                    if (parte->es_mapa()) {
+                        for (size_t w = 0; w < PALABRAS; ++w) {
+                            resultado.palabras[w] |= parte->palabras[w];
+                        }
+                    } else {
+                        for (uint16_t v : parte->valores) {
+                            resultado.palabras[v >> 6] |= uint64_t{1} << (v & 63);
+                        }
+                    }
+                }
+                resultado.normalizar_mapa();
+                return resultado;
+            }
+            set_union(a.valores.begin(), a.valores.end(), b.valores.begin(), b.valores.end(),
+                      back_inserter(resultado.valores));
+            resultado.cantidad = static_cast<uint32_t>(resultado.valores.size());
+            if (resultado.cantidad > MAXIMO_ARREGLO) {
+                resultado.a_mapa();
+            }
+            return resultado;
+        }
+
+        void retener_en_rango(const vector<float>& columna, float minimo, float maximo) {
+            size_t base = size_t{clave} << 16;
+            if (!es_mapa()) {
+                size_t escritos = 0;
+                for (uint16_t v : valores) {
+                    float valor = columna[base + v];
+                    if (valor >= minimo && valor <= maximo) {
+                        valores[escritos++] = v;
+                    }
+                }
+                valores.resize(escritos);
+                cantidad = static_cast<uint32_t>(escritos);
+                return;
+            }
+            const float* datos = columna.data() + base;
+            for (size_t w = 0; w < PALABRAS; ++w) {
+                if (palabras[w] == 0) {
+                    continue;
+                }
+                // Un mapa solo tiene bits de ids existentes, así que las 64
+                // posiciones de una palabra no vacía pueden pasar del final
+                // de la columna solo en su última palabra
+                size_t primero = w * 64;
+                size_t disponibles = min<size_t>(64, columna.size() - base - primero);
+                uint64_t cumplen = 0;
+                size_t i = 0;
+#if defined(__SSE2__)
+                const __m128 bajo = _mm_set1_ps(minimo);
+                const __m128 alto = _mm_set1_ps(maximo);
+                for (; i + 4 <= disponibles; i += 4) {
+                    __m128 x = _mm_loadu_ps(datos + primero + i);
+                    __m128 dentro = _mm_and_ps(_mm_cmpge_ps(x, bajo), _mm_cmple_ps(x, alto));
+                    cumplen |= uint64_t(_mm_movemask_ps(dentro)) << i;
+                }
+#endif
+                for (; i < disponibles; ++i) {
+                    float valor = datos[primero + i];
+                    cumplen |= uint64_t(valor >= minimo && valor <= maximo) << i;
+                }
+                palabras[w] &= cumplen;
+            }
+            normalizar_mapa();
+        }
+    };
+
+    vector<Contenedor> contenedores;   // ordenados por clave
+
+    // Posición del contenedor con esa clave, o contenedores.size() si no está
+    size_t posicion_contenedor(uint16_t clave) const {
+        auto it = lower_bound(contenedores.begin(), contenedores.end(), clave,
+            [](const Contenedor& c, uint16_t k) { return c.clave < k; });
+        return it != contenedores.end() && it->clave == clave ? it - contenedores.begin()
+                                                               : contenedores.size();
+    }
+
+    Contenedor& contenedor_para(uint16_t clave) {
+        if (!contenedores.empty() && contenedores.back().clave == clave) {
+            return contenedores.back();
+        }
+        auto it = lower_bound(contenedores.begin(), contenedores.end(), clave,
+            [](const Contenedor& c, uint16_t k) { return c.clave < k; });
+        if (it == contenedores.end() || it->clave != clave) {
+            it = contenedores.insert(it, Contenedor());
+            it->clave = clave;
+        }
+        return *it;
+    }
+};
+
+// Condiciones de un filtro de canciones; todas deben cumplirse. Las listas
+// vacías no restringen y dentro de una lista basta con uno de los valores.
+struct FiltroCanciones {
+    struct RangoRasgo {
+        size_t rasgo;    // índice en MatrizRasgos (0 = danceability, ..., 8 = tempo)
+        float minimo;    // ambos extremos incluidos
+        float maximo;
+    };
+
+    vector<string> generos;
+    int anio_desde = INT_MIN;
+    int anio_hasta = INT_MAX;
+    vector<int> tonalidades;   // key
+    vector<int> modos;         // mode
+    vector<int> compases;      // time_signature
+    vector<RangoRasgo> rasgos;
+};
+
+// Resultado de un filtro: los ids que cumplen todas las condiciones, en orden
+// de id. Las canciones se materializan solo por páginas, a medida que se
+// piden. Es válido hasta la siguiente alta o baja de la lista.
+class CursorFiltro {
+public:
+    explicit CursorFiltro(MapaBits coincidencias)
+        : coincidencias(move(coincidencias)), cantidad(this->coincidencias.cardinalidad()) {}
+
+    size_t total() const {
+        return cantidad;
+    }
+
+    vector<uint32_t> rango(size_t inicio, size_t cuantos) const {
+        return coincidencias.rango(inicio, cuantos);
+    }
+
+    // Los siguientes `cuantos` ids desde la última llamada
+    vector<uint32_t> siguientes(size_t cuantos) {
+        vector<uint32_t> ids = rango(posicion, cuantos);
+        posicion += ids.size();
+        return ids;
+    }
+
+    bool terminado() const {
+        return posicion >= cantidad;
+    }
+
+private:
+    MapaBits coincidencias;
+    size_t cantidad;
+    size_t posicion = 0;
+};
+
+// Mapas de bits por valor de los atributos de pocas categorías (género, año,
+// tonalidad, modo y compás), mantenidos en cada alta y baja
+class IndiceFiltros {
+public:
+    enum Atributo { GENERO, ANIO, TONALIDAD, MODO, COMPAS, NUM_ATRIBUTOS };
+
+    void agregar(const CatalogoColumnar& catalogo, uint32_t id) {
+        for (size_t atributo = 0; atributo < NUM_ATRIBUTOS; ++atributo) {
+            por_valor[atributo][valor(catalogo, static_cast<Atributo>(atributo), id)].agregar(id);
+        }
+        vivas.agregar(id);
+    }
+
+    // Más rápido con los ids en orden creciente
+    void agregar_lote(const CatalogoColumnar& catalogo, const vector<uint32_t>& ids) {
+        for (uint32_t id : ids) {
+            agregar(catalogo, id);
+        }
+    }
+
+    void quitar(const CatalogoColumnar& catalogo, uint32_t id) {
+        for (size_t atributo = 0; atributo < NUM_ATRIBUTOS; ++atributo) {
+            auto& mapas = por_valor[atributo];
+            auto it = mapas.find(valor(catalogo, static_cast<Atributo>(atributo), id));
+            if (it != mapas.end()) {
+                it->second.quitar(id);
+                if (it->second.vacio()) {
+                    mapas.erase(it);
+                }
+            }
+        }
+        vivas.quitar(id);
+    }
+
+    void construir(const CatalogoColumnar& catalogo) {
+        *this = IndiceFiltros();
+        for (uint32_t id = 0; id < catalogo.size(); ++id) {
+            if (catalogo.esta_viva(id)) {
+                agregar(catalogo, id);
+            }
+        }
+    }
+
+    // Las categorías se combinan primero con AND/OR de mapas de bits; los
+    // rangos de rasgos se evalúan solo sobre las canciones que quedan
+    CursorFiltro filtrar(const CatalogoColumnar& catalogo, const FiltroCanciones& filtro) const {
+        optional<MapaBits> resultado;
+        auto restringir = [&resultado](MapaBits&& condicion) {
+            resultado = resultado ? MapaBits::interseccion(*resultado, condicion) : move(condicion);
+        };
+        if (!filtro.generos.empty()) {
+            vector<int> ids_genero;
+            for (const string& genero : filtro.generos) {
+                uint32_t id = catalogo.generos.buscar(genero);
+                if (id != TablaIds::VACIA) {
+                    ids_genero.push_back(static_cast<int>(id));
+                }
+            }
+            restringir(alguno_de(GENERO, ids_genero));
+        }
+        if (filtro.anio_desde != INT_MIN || filtro.anio_hasta != INT_MAX) {
+            restringir(entre(ANIO, filtro.anio_desde, filtro.anio_hasta));
+        }
+        if (!filtro.tonalidades.empty()) {
+            restringir(alguno_de(TONALIDAD, filtro.tonalidades));
+        }
+        if (!filtro.modos.empty()) {
+            restringir(alguno_de(MODO, filtro.modos));
+        }
+        if (!filtro.compases.empty()) {
+            restringir(alguno_de(COMPAS, filtro.compases));
+        }
+        if (!resultado) {
+            resultado = vivas;
+        }
+        for (const auto& rango : filtro.rasgos) {
+            if (rango.rasgo >= MatrizRasgos::NUM_RASGOS) {
+                throw invalid_argument("Rasgo inexistente");
+            }
+            resultado->retener_en_rango(MatrizRasgos::columna(catalogo, rango.rasgo),
+                                        rango.minimo, rango.maximo);
+        }
+        return CursorFiltro(move(*resultado));
+    }
+
+    // Por cada atributo, sus valores y después el mapa de cada valor
+    void guardar(EscritorInstantanea& escritor) const {
+        for (const auto& mapas : por_valor) {
+            vector<int32_t> valores;
+            for (const auto& [v, mapa] : mapas) {
+                valores.push_back(v);
+            }
+            escritor.escribir_arreglo(valores);
+            for (const auto& [v, mapa] : mapas) {
+                mapa.guardar(escritor);
+            }
+        }
+        vivas.guardar(escritor);
+    }
+
+    // Lanza runtime_error si algún mapa está dañado o no corresponde al catálogo
+    void cargar(LectorInstantanea& lector, const CatalogoColumnar& catalogo) {
+        IndiceFiltros leido;
+        for (auto& mapas : leido.por_valor) {
+            vector<int32_t> valores;
+            lector.leer_arreglo(valores);
+            for (int32_t v : valores) {
+                MapaBits mapa;
+                mapa.cargar(lector, catalogo.size());
+                if (mapa.vacio() || !mapas.emplace(v, move(mapa)).second) {
+                    throw runtime_error("filtros inconsistentes");
+                }
+            }
+        }
+        leido.vivas.cargar(lector, catalogo.size());
+        if (leido.vivas.cardinalidad() != catalogo.total_vivas()) {
+            throw runtime_error("filtros inconsistentes");
+        }
+        *this = move(leido);
+    }
+
+    size_t memoria() const {
+        size_t bytes = vivas.memoria();
+        for (const auto& mapas : por_valor) {
+            for (const auto& [valor, mapa] : mapas) {
+                bytes += mapa.memoria() + sizeof(valor);
+            }
+        }
+        return bytes;
+    }
+
+private:
+    array<map<int, MapaBits>, NUM_ATRIBUTOS> por_valor;
+    MapaBits vivas;
+
+    static int valor(const CatalogoColumnar& catalogo, Atributo atributo, uint32_t id) {
+        switch (atributo) {
+            case GENERO: return static_cast<int>(catalogo.genero[id]);
+            case ANIO: return catalogo.anio[id];
+            case TONALIDAD: return catalogo.key[id];
+            case MODO: return catalogo.mode[id];
+            default: return catalogo.time_signature[id];
+        }
+    }
+
+    // Unión de los mapas con valor en [desde, hasta]
+    MapaBits entre(Atributo atributo, int desde, int hasta) const {
+        MapaBits resultado;
+        const auto& mapas = por_valor[atributo];
+        for (auto it = mapas.lower_bound(desde); it != mapas.end() && it->first <= hasta; ++it) {
+            resultado = MapaBits::union_de(resultado, it->second);
+        }
+        return resultado;
+    }
+
+    MapaBits alguno_de(Atributo atributo, const vector<int>& valores) const {
+        MapaBits resultado;
+        for (int v : valores) {
+            auto it = por_valor[atributo].find(v);
+            if (it != por_valor[atributo].end()) {
+                resultado = MapaBits::union_de(resultado, it->second);
+            }
+        }
+        return resultado;
+    }
+};
+
+// Columna que se resume en una agregación por grupos. Las nueve primeras
+// siguen el orden de MatrizRasgos.
+enum class Medida {
+    DANCEABILITY, ENERGY, LOUDNESS, SPEECHINESS, ACOUSTICNESS, INSTRUMENTALNESS,
+    LIVENESS, VALENCE, TEMPO, POPULARIDAD, DURACION, NUM_MEDIDAS
+};
+
+enum class Agrupacion { GENERO, ANIO, ARTISTA };
+
+const char* nombre_medida(Medida medida) {
+    if (medida == Medida::POPULARIDAD) {
+        return "popularity";
+    }
+    if (medida == Medida::DURACION) {
+        return "duration_ms";
+    }
+    return MatrizRasgos::nombre_rasgo(static_cast<size_t>(medida));
+}
+
+// Llama a f con la columna de la medida (vector<float>, vector<uint8_t> o
+// vector<int32_t>), para que el recorrido se compile una vez por tipo
+template <typename F>
+void visitar_medida(const CatalogoColumnar& catalogo, Medida medida, F&& f) {
+    if (medida == Medida::POPULARIDAD) {
+        f(catalogo.popularity);
+    } else if (medida == Medida::DURACION) {
+        f(catalogo.duration_ms);
+    } else {
+        f(MatrizRasgos::columna(catalogo, static_cast<size_t>(medida)));
+    }
+}
+
+// Igual para la columna que define el grupo (género y artista son ids de
+// diccionario; el año se usa tal cual)
+template <typename F>
+void visitar_agrupacion(const CatalogoColumnar& catalogo, Agrupacion agrupacion, F&& f) {
+    if (agrupacion == Agrupacion::GENERO) {
+        f(catalogo.genero);
+    } else if (agrupacion == Agrupacion::ARTISTA) {
+        f(catalogo.artista);
+    } else {
+        f(catalogo.anio);
+    }
+}
+
+// Resumen de una medida dentro de un grupo
+struct EstadisticaGrupo {
+    string grupo;
+    size_t cantidad = 0;
+    double suma = 0;
+    double media = 0;
+    float minimo = 0;
+    float maximo = 0;
+    vector<float> cuantiles;   // en el orden en que se pidieron
+};
+
+// Tabla hash de direccionamiento abierto clave de grupo -> acumulador. Cada
+// hilo llena la suya con su parte del catálogo sin compartir memoria, y al
+// final se unen.
+class TablaGrupos {
+public:
+    static constexpr uint32_t NO_ESTA = UINT32_MAX;
+
+    struct Acumulador {
+        uint32_t clave;
+        uint32_t cantidad;
+        double suma;
+        float minimo;
+        float maximo;
+    };
+
+    TablaGrupos() : ranuras(64, 0) {}
+
+    void sumar(uint32_t clave, float valor) {
+        Acumulador& acumulador = lista[buscar_o_crear(clave)];
+        acumulador.cantidad++;
+        acumulador.suma += valor;
+        acumulador.minimo = min(acumulador.minimo, valor);
+        acumulador.maximo = max(acumulador.maximo, valor);
+    }
+
+    void unir(const TablaGrupos& otra) {
+        for (const Acumulador& suyo : otra.lista) {
+            Acumulador& acumulador = lista[buscar_o_crear(suyo.clave)];
+            acumulador.cantidad += suyo.cantidad;
+            acumulador.suma += suyo.suma;
+            acumulador.minimo = min(acumulador.minimo, suyo.minimo);
+            acumulador.maximo = max(acumulador.maximo, suyo.maximo);
+        }
+    }
+
+    // Posición de la clave en acumuladores(), o NO_ESTA
+    uint32_t posicion(uint32_t clave) const {
+        for (size_t i = dispersar(clave);; i = (i + 1) & (ranuras.size() - 1)) {
+            if (ranuras[i] == 0) {
+                return NO_ESTA;
+            }
+            if (lista[ranuras[i] - 1].clave == clave) {
+                return ranuras[i] - 1;
+            }
+        }
+    }
+
+    const vector<Acumulador>& acumuladores() const {
+        return lista;
+    }
+
+private:
+    vector<uint32_t> ranuras;   // posición + 1 en `lista`; 0 = vacía
+    vector<Acumulador> lista;
+
+    size_t dispersar(uint32_t clave) const {
+        return (clave * 0x9E3779B1u) & (ranuras.size() - 1);
+    }
+
+    uint32_t buscar_o_crear(uint32_t clave) {
+        for (size_t i = dispersar(clave);; i = (i + 1) & (ranuras.size() - 1)) {
+            if (ranuras[i] == 0) {
+                lista.push_back({clave, 0, 0, numeric_limits<float>::infinity(),
+                                 -numeric_limits<float>::infinity()});
+                ranuras[i] = static_cast<uint32_t>(lista.size());
+                if (lista.size() * 2 > ranuras.size()) {
+                    crecer();
+                }
+                return static_cast<uint32_t>(lista.size() - 1);
+            }
+            if (lista[ranuras[i] - 1].clave == clave) {
+                return ranuras[i] - 1;
+            }
+        }
+    }
+
+    void crecer() {
+        ranuras.assign(ranuras.size() * 2, 0);
+        for (uint32_t posicion = 0; posicion < lista.size(); ++posicion) {
+            size_t i = dispersar(lista[posicion].clave);
+            while (ranuras[i] != 0) {
+                i = (i + 1) & (ranuras.size() - 1);
+            }
+            ranuras[i] = posicion + 1;
+        }
+    }
+};
+
+// Cola de reproducción: su orden lo decide el usuario, no el catálogo. Es un
+// treap implícito (la posición de cada nodo se deduce del tamaño de los
+// subárboles), así que insertar, quitar o mover una canción en cualquier
+// posición cuesta O(log n) esperado. Los nodos viven en un vector y se
+// refieren por índice; cada canción recuerda su nodo y cada nodo a su padre,
+// con lo que la posición de una canción también se obtiene en O(log n).
+class SecuenciaReproduccion {
+public:
+    static constexpr uint32_t SIN_NODO = UINT32_MAX;
+    static constexpr size_t NO_ESTA = SIZE_MAX;
+
+    size_t size() const {
+        return tam(raiz);
+    }
+
+    bool contiene(uint32_t id) const {
+        return id < nodo_de_id.size() && nodo_de_id[id] != SIN_NODO;
+    }
+
+    // Id de la canción en la posición `pos` (0 es la primera)
+    uint32_t en(size_t pos) const {
+        if (pos >= size()) {
+            throw out_of_range("Posición fuera de la cola");
+        }
+        uint32_t nodo = raiz;
+        while (true) {
+            size_t izquierda = tam(nodos[nodo].izquierdo);
+            if (pos == izquierda) {
+                return nodos[nodo].id;
+            }
+            if (pos < izquierda) {
+                nodo = nodos[nodo].izquierdo;
+            } else {
+                pos -= izquierda + 1;
+                nodo = nodos[nodo].derecho;
+            }
+        }
+    }
+
+    // Posición de la canción, subiendo desde su nodo hasta la raíz; NO_ESTA si no está
+    size_t posicion_de(uint32_t id) const {
+        if (!contiene(id)) {
+            return NO_ESTA;
+        }
+        uint32_t nodo = nodo_de_id[id];
+        size_t pos = tam(nodos[nodo].izquierdo);
+        for (uint32_t padre = nodos[nodo].padre; padre != SIN_NODO; nodo = padre, padre = nodos[nodo].padre) {
+            if (nodos[padre].derecho == nodo) {
+                pos += tam(nodos[padre].izquierdo) + 1;
+            }
+        }
+        return pos;
+    }
+
+    // Devuelve false si la canción ya está en la cola
+    bool insertar_en(size_t pos, uint32_t id) {
+        if (pos > size()) {
+            throw out_of_range("Posición fuera de la cola");
+        }
+        if (contiene(id)) {
+            return false;
+        }
+        uint32_t antes, despues;
+        dividir(raiz, pos, antes, despues);
+        fijar_raiz(unir(unir(antes, crear(id)), despues));
+        return true;
+    }
+
+    uint32_t eliminar_en(size_t pos) {
+        if (pos >= size()) {
+            throw out_of_range("Posición fuera de la cola");
+        }
+        uint32_t antes, resto, quitado, despues;
+        dividir(raiz, pos, antes, resto);
+        dividir(resto, 1, quitado, despues);
+        uint32_t id = nodos[quitado].id;
+        liberar(quitado);
+        fijar_raiz(unir(antes, despues));
+        return id;
+    }
+
+    bool eliminar(uint32_t id) {
+        size_t pos = posicion_de(id);
+        if (pos == NO_ESTA) {
+            return false;
+        }
+        eliminar_en(pos);
+        return true;
+    }
+
+    // La canción en `desde` pasa a ocupar la posición `hasta`
+    void mover(size_t desde, size_t hasta) {
+        if (desde >= size() || hasta >= size()) {
+            throw out_of_range("Posición fuera de la cola");
+        }
+        insertar_en(hasta, eliminar_en(desde));
+    }
+
+    // Agrega los ids al final en O(n): arma el treap de los nuevos de una vez
+    // (árbol cartesiano por prioridad, con una pila) y lo une a la cola.
+    // Los ids que ya están se ignoran.
+    void agregar_al_final(const vector<uint32_t>& ids) {
+        vector<uint32_t> pila;
+        for (uint32_t id : ids) {
+            if (contiene(id)) {
+                continue;
+            }
+            uint32_t nodo = crear(id);
+            uint32_t ultimo = SIN_NODO;
+            while (!pila.empty() && nodos[pila.back()].prioridad < nodos[nodo].prioridad) {
+                ultimo = pila.back();
+                pila.pop_back();
+                actualizar(ultimo);   // su subárbol ya no cambia
+            }
+            nodos[nodo].izquierdo = ultimo;
+            if (!pila.empty()) {
+                nodos[pila.back()].derecho = nodo;
+            }
+            pila.push_back(nodo);
+        }
+        for (size_t i = pila.size(); i-- > 0;) {
+            actualizar(pila[i]);
+        }
+        if (!pila.empty()) {
+            fijar_raiz(unir(raiz, pila[0]));
+        }
+    }
+
+    // Hasta `cantidad` ids a partir de la posición `inicio`, en O(log n + cantidad)
+    vector<uint32_t> rango(size_t inicio, size_t cantidad) const {
+        vector<uint32_t> resultado;
+        if (inicio < size()) {
+            cantidad = min(cantidad, size() - inicio);
+            resultado.reserve(cantidad);
+            recolectar(raiz, inicio, cantidad, resultado);
+        }
+        return resultado;
+    }
+
+    vector<uint32_t> listar() const {
+        return rango(0, size());
+    }
+
+    // Tras compactar el catálogo: id_nuevo[id] es el id nuevo de cada canción
+    void reasignar(const vector<uint32_t>& id_nuevo) {
+        nodo_de_id.clear();
+        for (uint32_t nodo : listar_nodos()) {
+            uint32_t id = id_nuevo[nodos[nodo].id];
+            nodos[nodo].id = id;
+            if (id >= nodo_de_id.size()) {
+                nodo_de_id.resize(static_cast<size_t>(id) + 1, SIN_NODO);
+            }
+            nodo_de_id[id] = nodo;
+        }
+    }
+
+    // Comprueba que cada nodo tenga el tamaño de su subárbol, que su padre lo
+    // apunte, que no supere en prioridad a su padre y que nodo_de_id lo
+    // encuentre. Devuelve la primera falla, o una cadena vacía. Lo usa --pruebas.
+    string revisar() const {
+        if (raiz != SIN_NODO && nodos[raiz].padre != SIN_NODO) {
+            return "la raíz tiene padre";
+        }
+        size_t en_cola = 0;
+        for (uint32_t nodo : listar_nodos()) {
+            const NodoSecuencia& n = nodos[nodo];
+            if (n.tam != 1 + tam(n.izquierdo) + tam(n.derecho)) {
+                return "tamaño de subárbol incorrecto";
+            }
+            for (uint32_t hijo : {n.izquierdo, n.derecho}) {
+                if (hijo != SIN_NODO && (nodos[hijo].padre != nodo || nodos[hijo].prioridad > n.prioridad)) {
+                    return "hijo con otro padre o con más prioridad que él";
+                }
+            }
+            if (!contiene(n.id) || nodo_de_id[n.id] != nodo) {
+                return "nodo_de_id no lleva al nodo";
+            }
+            en_cola++;
+        }
+        size_t registrados = count_if(nodo_de_id.begin(), nodo_de_id.end(),
+                                      [](uint32_t nodo) { return nodo != SIN_NODO; });
+        return registrados == en_cola ? "" : "nodo_de_id tiene ids que no están en la cola";
+    }
+
+private:
+    struct NodoSecuencia {
+        uint32_t id;
+        uint32_t prioridad;
+        uint32_t izquierdo = SIN_NODO;
+        uint32_t derecho = SIN_NODO;
+        uint32_t padre = SIN_NODO;
+        uint32_t tam = 1;
+    };
+
+    vector<NodoSecuencia> nodos;
+    vector<uint32_t> libres;        // nodos sin uso, para reutilizar
+    vector<uint32_t> nodo_de_id;    // nodo de cada id del catálogo, o SIN_NODO
+    uint32_t raiz = SIN_NODO;
+    mt19937 prioridades{0x5eed};
+
+    size_t tam(uint32_t nodo) const {
+        return nodo == SIN_NODO ? 0 : nodos[nodo].tam;
+    }
+
+    uint32_t crear(uint32_t id) {
+        NodoSecuencia nuevo;
+        nuevo.id = id;
+        nuevo.prioridad = static_cast<uint32_t>(prioridades());
+        uint32_t nodo;
+        if (!libres.empty()) {
+            nodo = libres.back();
+            libres.pop_back();
+            nodos[nodo] = nuevo;
+        } else {
+            nodo = static_cast<uint32_t>(nodos.size());
+            nodos.push_back(nuevo);
+        }
+        if (id >= nodo_de_id.size()) {
+            nodo_de_id.resize(static_cast<size_t>(id) + 1, SIN_NODO);
+        }
+        nodo_de_id[id] = nodo;
+        return nodo;
+    }
+
+    void liberar(uint32_t nodo) {
+        nodo_de_id[nodos[nodo].id] = SIN_NODO;
+        libres.push_back(nodo);
+    }
+
+    // Recalcula el tamaño del nodo y apunta sus hijos hacia él
+    void actualizar(uint32_t nodo) {
+        NodoSecuencia& n = nodos[nodo];
+        n.tam = 1 + static_cast<uint32_t>(tam(n.izquierdo) + tam(n.derecho));
+        if (n.izquierdo != SIN_NODO) {
+            nodos[n.izquierdo].padre = nodo;
+        }
+        if (n.derecho != SIN_NODO) {
+            nodos[n.derecho].padre = nodo;
+        }
+    }
+
+    void fijar_raiz(uint32_t nodo) {
+        raiz = nodo;
+        if (raiz != SIN_NODO) {
+            nodos[raiz].padre = SIN_NODO;
+        }
+    }
+
+    // Separa las primeras k posiciones del subárbol (en `antes`) del resto
+    void dividir(uint32_t nodo, size_t k, uint32_t& antes, uint32_t& despues) {
+        if (nodo == SIN_NODO) {
+            antes = despues = SIN_NODO;
+            return;
+        }
+        size_t izquierda = tam(nodos[nodo].izquierdo);
+        if (izquierda < k) {
+            uint32_t derecho;
+            dividir(nodos[nodo].derecho, k - izquierda - 1, derecho, despues);
+            nodos[nodo].derecho = derecho;
+            antes = nodo;
+        } else {
+            uint32_t izquierdo;
+            dividir(nodos[nodo].izquierdo, k, antes, izquierdo);
+            nodos[nodo].izquierdo = izquierdo;
+            despues = nodo;
+        }
+        actualizar(nodo);
+        if (antes != SIN_NODO) {
+            nodos[antes].padre = SIN_NODO;
+        }
+        if (despues != SIN_NODO) {
+            nodos[despues].padre = SIN_NODO;
+        }
+    }
+
+    // Concatena dos subárboles; queda arriba el de mayor prioridad
+    uint32_t unir(uint32_t izquierdo, uint32_t derecho) {
+        if (izquierdo == SIN_NODO) {
+            return derecho;
+        }
+        if (derecho == SIN_NODO) {
+            return izquierdo;
+        }
+        if (nodos[izquierdo].prioridad > nodos[derecho].prioridad) {
+            uint32_t unido = unir(nodos[izquierdo].derecho, derecho);
+            nodos[izquierdo].derecho = unido;
+            actualizar(izquierdo);
+            return izquierdo;
+        }
+        uint32_t unido = unir(izquierdo, nodos[derecho].izquierdo);
+        nodos[derecho].izquierdo = unido;
+        actualizar(derecho);
+        return derecho;
+    }
+
+    // Agrega los ids de las posiciones [inicio, inicio + cantidad) del subárbol
+    void recolectar(uint32_t nodo, size_t inicio, size_t cantidad, vector<uint32_t>& salida) const {
+        if (nodo == SIN_NODO || cantidad == 0) {
+            return;
+        }
+        size_t izquierda = tam(nodos[nodo].izquierdo);
+        if (inicio < izquierda) {
+            recolectar(nodos[nodo].izquierdo, inicio, min(cantidad, izquierda - inicio), salida);
+        }
+        size_t fin = inicio + cantidad;
+        if (inicio <= izquierda && izquierda < fin) {
+            salida.push_back(nodos[nodo].id);
+        }
+        if (fin > izquierda + 1) {
+            size_t desde = max(inicio, izquierda + 1);
+            recolectar(nodos[nodo].derecho, desde - izquierda - 1, fin - desde, salida);
+        }
+    }
+
+    vector<uint32_t> listar_nodos() const {
+        vector<uint32_t> resultado;
+        resultado.reserve(size());
+        vector<uint32_t> pendientes;
+        if (raiz != SIN_NODO) {
+            pendientes.push_back(raiz);
+        }
+        while (!pendientes.empty()) {
+            uint32_t nodo = pendientes.back();
+            pendientes.pop_back();
+            resultado.push_back(nodo);
+            for (uint32_t hijo : {nodos[nodo].izquierdo, nodos[nodo].derecho}) {
+                if (hijo != SIN_NODO) {
+                    pendientes.push_back(hijo);
+                }
+            }
+        }
+        return resultado;
+    }
+};
+
+// Clase ListaReproduccion combinada
+class ListaReproduccion {
+public:
+    CatalogoColumnar catalogo;
+    BTree bTree;
+    // Índices secundarios, mantenidos en cada alta y baja
+    ArbolBMas<OrdenPorPopularidad> indice_popularidad;
+    ArbolBMas<OrdenPorDuracion> indice_duracion;
+    IndiceAnios indice_anios;
+    IndiceFiltros filtros;          // mapas de bits por género, año, tonalidad, modo y compás
+    SecuenciaReproduccion cola;     // orden de reproducción elegido por el usuario
+    MotorReproduccion reproductor;  // mezcla y reproducción ponderada
+    TrieCompacto trie_artistas;
+    TrieCompacto trie_canciones;
+    IndicePrefijos indice_csv;
+    // CSV del que salió el catálogo: sus primeras filas_csv canciones son las
+    // del archivo mientras no se compacte ni se reemplace
+    string ruta_csv = "spotify_data.csv";
+    FirmaArchivo firma_csv;
+    uint32_t filas_csv = 0;
+    size_t total_canciones;
+
+    explicit ListaReproduccion(int tamano_maximo = CLAVES_POR_NODO) 
+        : bTree(tamano_maximo, catalogo), indice_popularidad(tamano_maximo, catalogo),
+          indice_duracion(tamano_maximo, catalogo), indice_anios(tamano_maximo, catalogo),
+          total_canciones(0) {}
+
+    // Copia independiente de la lista, para que ListaConcurrente prepare una
+    // versión nueva sin tocar la que están leyendo. Los nodos de los árboles
+    // apuntan a su catálogo, así que se rehacen desde el orden de la original;
+    // el índice de prefijos del CSV se vuelve a armar si se consulta.
+    unique_ptr<ListaReproduccion> clonar() const {
+        auto copia = make_unique<ListaReproduccion>(bTree.tamano_maximo);
+        copia->catalogo = catalogo;
+        vector<uint32_t> orden = bTree.listar();
+        copia->indice_anios.construir(orden);
+        copia->bTree.construir_desde_ordenado(move(orden));
+        copia->indice_popularidad.construir_desde_ordenado(indice_popularidad.listar());
+        copia->indice_duracion.construir_desde_ordenado(indice_duracion.listar());
+        copia->filtros = filtros;
+        copia->cola = cola;
+        copia->reproductor = reproductor;
+        copia->trie_artistas = trie_artistas;
+        copia->trie_canciones = trie_canciones;
+        copia->ruta_csv = ruta_csv;
+        copia->firma_csv = firma_csv;
+        copia->filas_csv = filas_csv;
+        copia->total_canciones = total_canciones;
+        copia->rasgos = rasgos;
+        copia->indice_vecinos = indice_vecinos;
+        copia->parametros_vecinos = parametros_vecinos;
+        copia->vecinos_vigente = vecinos_vigente;
+        return copia;
+    }
+
+    // Busca en el catálogo completo del CSV que se cargó por última vez. La
+    // primera consulta arma el índice (sobre el catálogo de la lista si salió
+    // de ese mismo archivo); las siguientes no leen el archivo.
+    vector<Cancion> buscar_canciones_por_prefijo_en_csv(const string& prefijo, bool por_artista = false) {
+        if (!indice_csv.cargado() && !preparar_indice_csv(ruta_csv)) {
+            return {};
+        }
+        vector<Cancion> resultados;
+        for (uint32_t id : indice_csv.buscar(prefijo, por_artista)) {
+            resultados.push_back(indice_csv.catalogo().obtener(id));
+        }
+        return resultados;
+    }
+
+    // Definida después de los cargadores de CSV
+    bool preparar_indice_csv(const string& file_path);
+
+    // Anota que el catálogo recién cargado en la lista vacía es el de `ruta`
+    void recordar_origen_csv(const string& ruta) {
+        olvidar_origen_csv();
+        if (ruta != ruta_csv) {
+            indice_csv.vaciar();
+            ruta_csv = ruta;
+        }
+        firma_csv = firma_archivo(ruta);
+        if (firma_csv.existe && catalogo.total_vivas() == catalogo.size()) {
+            filas_csv = static_cast<uint32_t>(catalogo.size());
+        }
+    }
+
+    // Devuelve false si la canción ya estaba en la lista
+    bool agregar_cancion(const Cancion& cancion) {
+        if (catalogo.buscar_id(cancion.track_id) != CatalogoColumnar::SIN_CANCION) {
+            return false;
+        }
+        uint32_t id = catalogo.agregar(cancion);
+        bTree.insertar(id);
+        indice_popularidad.insertar(id);
+        indice_duracion.insertar(id);
+        indice_anios.insertar(id);
+        filtros.agregar(catalogo, id);
+        cola.insertar_en(cola.size(), id);
+        reproductor.agregar(id, catalogo.popularity[id]);
+        agregar_rasgos({id});
+        indexar_vecinos({id});
+        trie_artistas.insertar(cancion.artist_name, id, catalogo.popularity[id]);
+        trie_canciones.insertar(cancion.track_name, id, catalogo.popularity[id]);
+        total_canciones++;
+        return true;
+    }
+
+    // Carga en lote: ordena una vez por la clave del árbol, lo construye de
+    // abajo hacia arriba y llena ambos tries sin insertar canción por canción
+    void cargar_masivo(vector<Cancion>&& canciones) {
+        // Una fila que no cabe en el catálogo rechaza el lote antes de tocar nada
+        for (const auto& cancion : canciones) {
+            if (!CatalogoColumnar::cabe_en_columnas(CatalogoColumnar::fila_de(cancion))) {
+                throw out_of_range("Valor fuera de rango en la canción " + cancion.track_id);
+            }
+        }
+        // Los track_id repetidos se descartan (se conserva la primera aparición)
+        vector<uint32_t> nuevos;
+        nuevos.reserve(canciones.size());
+        catalogo.reservar(catalogo.size() + canciones.size());
+        for (const auto& cancion : canciones) {
+            uint32_t id = catalogo.agregar_si_nueva(cancion);
+            if (id != CatalogoColumnar::SIN_CANCION) {
+                nuevos.push_back(id);
+            }
+        }
+        canciones.clear();
+        canciones.shrink_to_fit();
+
+        cola.agregar_al_final(nuevos);
+        filtros.agregar_lote(catalogo, nuevos);
+        reproductor.agregar_lote(nuevos, catalogo.popularity);
+        agregar_rasgos(nuevos);
+        indexar_vecinos(nuevos);
+        indexar_nuevas(move(nuevos));
+    }
+
+    // Adopta un catálogo ya cargado (por ejemplo con cargar_csv_mapeado).
+    // Si la lista estaba vacía se toma tal cual, sin copiar columnas.
+    void cargar_catalogo(CatalogoColumnar&& nuevo) {
+        vector<uint32_t> nuevos;
+        if (total_canciones == 0 && catalogo.size() == 0) {
+            olvidar_origen_csv();
+            catalogo = move(nuevo);
+            nuevos.reserve(catalogo.total_vivas());
+            for (uint32_t id = 0; id < catalogo.size(); ++id) {
+                if (catalogo.esta_viva(id)) {
+                    nuevos.push_back(id);
+                }
+            }
+        } else {
+            catalogo.reservar(catalogo.size() + nuevo.total_vivas());
+            for (uint32_t id = 0; id < nuevo.size(); ++id) {
+                if (nuevo.esta_viva(id)) {
+                    uint32_t agregado = catalogo.agregar_si_nueva(nuevo.fila(id));
+                    if (agregado != CatalogoColumnar::SIN_CANCION) {
+                        nuevos.push_back(agregado);
+                    }
+                }
+            }
+        }
+        cola.agregar_al_final(nuevos);
+        filtros.agregar_lote(catalogo, nuevos);
+        reproductor.agregar_lote(nuevos, catalogo.popularity);
+        agregar_rasgos(nuevos);
+        indexar_vecinos(nuevos);
+        indexar_nuevas(move(nuevos));
+    }
+
+    // Guarda el catálogo, el orden ya calculado de los árboles, los tries y
+    // los filtros ya armados, junto con la firma del CSV de origen para
+    // detectar si quedó desactualizada
+    void guardar_instantanea(const string& ruta, const string& ruta_csv) const {
+        OrdenesInstantanea ordenes;
+        ordenes.arbol = bTree.listar();
+        ordenes.artistas = ordenes.arbol;
+        ordenar_sin_mayusculas(catalogo, ordenes.artistas, true);
+        ordenes.nombres = ordenes.arbol;
+        ordenar_sin_mayusculas(catalogo, ordenes.nombres, false);
+        ordenes.popularidad = indice_popularidad.listar();
+        ordenes.duracion = indice_duracion.listar();
+
+        EscritorInstantanea escritor(ruta, firma_archivo(ruta_csv));
+        catalogo.guardar(escritor);
+        for (const auto* orden : {&ordenes.arbol, &ordenes.artistas, &ordenes.nombres,
+                                  &ordenes.popularidad, &ordenes.duracion}) {
+            escritor.escribir_arreglo(*orden);
+        }
+        trie_artistas.guardar(escritor);
+        trie_canciones.guardar(escritor);
+        filtros.guardar(escritor);
+        escritor.cerrar();
+    }
+
+    // Abre una instantánea creada con guardar_instantanea. Devuelve false (sin
+    // modificar la lista) si no existe, está dañada o el CSV cambió desde entonces.
+    bool abrir_instantanea(const string& ruta, const string& ruta_csv) {
+        CatalogoColumnar leido;
+        OrdenesInstantanea ordenes;
+        TrieCompacto artistas;
+        TrieCompacto canciones;
+        IndiceFiltros filtros_leidos;
+        auto leer_indices = [&](LectorInstantanea& lector, const CatalogoColumnar& catalogo_leido) {
+            artistas.cargar(lector, catalogo_leido.size());
+            canciones.cargar(lector, catalogo_leido.size());
+            filtros_leidos.cargar(lector, catalogo_leido);
+        };
+        if (total_canciones > 0 || !leer_instantanea(ruta, ruta_csv, leido, ordenes, leer_indices)) {
+            return false;
+        }
+
+        olvidar_origen_csv();
+        catalogo = move(leido);
+        // La cola no se guarda: empieza en el orden del archivo, como al leer el CSV
+        vector<uint32_t> en_orden;
+        en_orden.reserve(catalogo.total_vivas());
+        for (uint32_t id = 0; id < catalogo.size(); ++id) {
+            if (catalogo.esta_viva(id)) {
+                en_orden.push_back(id);
+            }
+        }
+        cola.agregar_al_final(en_orden);
+        filtros = move(filtros_leidos);
+        reproductor.agregar_lote(en_orden, catalogo.popularity);
+        rasgos.construir(catalogo);
+        indexar_vecinos(en_orden);
+        trie_artistas = move(artistas);
+        trie_canciones = move(canciones);
+        total_canciones = ordenes.arbol.size();
+        indice_anios.construir(ordenes.arbol);
+        bTree.construir_desde_ordenado(move(ordenes.arbol));
+        indice_popularidad.construir_desde_ordenado(move(ordenes.popularidad));
+        indice_duracion.construir_desde_ordenado(move(ordenes.duracion));
+        // Los órdenes sin mayúsculas de la instantánea ya sirven para el índice de prefijos
+        recordar_origen_csv(ruta_csv);
+        if (filas_csv > 0) {
+            indice_csv.construir_sobre(catalogo, move(ordenes.artistas), move(ordenes.nombres));
+        }
+        return true;
+    }
+
+    optional<Cancion> buscar(const string& track_id) const {
+        uint32_t id = catalogo.buscar_id(track_id);
+        if (id == CatalogoColumnar::SIN_CANCION) {
+            return nullopt;
+        }
+        return catalogo.obtener(id);
+    }
+
+    vector<Cancion> listar_canciones() const {
+        return materializar(bTree.listar());
+    }
+
+    vector<Cancion> listar_por_popularidad(bool ascendente = true) const {
+        return materializar(indice_popularidad.rango(0, indice_popularidad.size(), ascendente));
+    }
+
+    vector<Cancion> obtener_por_anio(int anio) const {
+        return materializar(indice_anios.rango(anio, anio, 0, indice_anios.contar(anio, anio)));
+    }
+
+    bool eliminar_cancion(const string& track_id) {
+        uint32_t id = catalogo.buscar_id(track_id);
+        if (id != CatalogoColumnar::SIN_CANCION && bTree.eliminar(id)) {
+            indice_popularidad.eliminar(id);
+            indice_duracion.eliminar(id);
+            indice_anios.eliminar(id);
+            cola.eliminar(id);
+            reproductor.quitar(id);
+            rasgos.quitar(id);
+            // Con más marcas que canciones el grafo se rehace sin la eliminada
+            bool rehacer_vecinos = vecinos_vigente && indice_vecinos.eliminar(id) &&
+                                   indice_vecinos.eliminados() > indice_vecinos.size();
+            trie_artistas.eliminar(string(catalogo.artist_name(id)), id);
+            trie_canciones.eliminar(string(catalogo.track_name(id)), id);
+            filtros.quitar(catalogo, id);
+            catalogo.eliminar(id);
+            total_canciones--;
+            compactar_si_conviene();
+            if (rehacer_vecinos) {
+                indice_vecinos.construir(catalogo, parametros_vecinos);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // Los ids eliminados no se reutilizan; cuando son mayoría se compacta el
+    // catálogo y se rehacen los índices con los ids nuevos, conservando el
+    // orden del árbol. Así la memoria no crece sin límite con altas y bajas.
+    void compactar_si_conviene() {
+        size_t eliminadas = catalogo.size() - catalogo.total_vivas();
+        if (eliminadas < 1024 || eliminadas < catalogo.total_vivas()) {
+            return;
+        }
+        vector<uint32_t> id_nuevo(catalogo.size(), CatalogoColumnar::SIN_CANCION);
+        uint32_t siguiente = 0;
+        for (uint32_t id = 0; id < catalogo.size(); ++id) {
+            if (catalogo.esta_viva(id)) {
+                id_nuevo[id] = siguiente++;
+            }
+        }
+        vector<uint32_t> orden = bTree.listar();
+        for (uint32_t& id : orden) {
+            id = id_nuevo[id];
+        }
+        cola.reasignar(id_nuevo);
+        reproductor.reasignar(id_nuevo);
+        if (vecinos_vigente) {
+            indice_vecinos.reasignar(id_nuevo);
+        }
+        rasgos.reasignar(id_nuevo);
+
+        olvidar_origen_csv();
+        catalogo = catalogo.compactado();
+        filtros.construir(catalogo);
+        trie_artistas = TrieCompacto();
+        trie_canciones = TrieCompacto();
+        total_canciones = 0;
+        indexar_nuevas(move(orden));
+    }
+
+    // Mueve la canción a `nueva_posicion` de la cola de reproducción en
+    // O(log n); devuelve la posición que tenía
+    size_t mover_cancion(const string& track_id, size_t nueva_posicion) {
+        size_t desde = cola.posicion_de(catalogo.buscar_id(track_id));
+        if (desde == SecuenciaReproduccion::NO_ESTA) {
+            throw runtime_error("Canción no encontrada");
+        }
+        if (nueva_posicion >= cola.size()) {
+            throw runtime_error("Posición inválida");
+        }
+        cola.mover(desde, nueva_posicion);
+        return desde;
+    }
+
+    // Sin repetir hasta que suenen todas, o al azar según la popularidad
+    void reproducir_aleatoria(bool por_popularidad = false) {
+        uint32_t id = por_popularidad ? reproductor.siguiente_ponderada() : reproductor.siguiente_mezcla();
+        if (id == MotorReproduccion::SIN_CANCION) {
+            cout << "La lista de reproducción está vacía." << endl;
+            return;
+        }
+
+        cout << "Reproduciendo: " << catalogo.track_name(id) 
+             << " - " << catalogo.artist_name(id) << endl;
+    }
+    
+        // En la clase ListaReproduccion
+
+    vector<Cancion> buscar_canciones_por_trie(const string& prefijo, bool por_artista = false) const {
+        vector<Cancion> resultados_playlist;
+        const TrieCompacto& trie = por_artista ? trie_artistas : trie_canciones;
+
+        // Obtener ids de canciones usando el Trie
+        vector<uint32_t> ids = trie.buscar_prefijo(prefijo);
+
+        for (uint32_t id : ids) {
+            // Verificar si la cadena comienza exactamente con el prefijo
+            string_view texto = por_artista ? catalogo.artist_name(id) : catalogo.track_name(id);
+            bool cumple_prefijo = texto.substr(0, prefijo.length()) == prefijo;
+
+            if (cumple_prefijo) {
+                resultados_playlist.push_back(catalogo.obtener(id));
+            }
+        }
+
+        return resultados_playlist;
+    }
+
+    // Las k canciones más populares cuyo nombre (o artista) empieza por el
+    // prefijo, sin distinguir mayúsculas; pensada para autocompletar
+    vector<Cancion> buscar_top_k(const string& prefijo, size_t k, bool por_artista = false) const {
+        const TrieCompacto& trie = por_artista ? trie_artistas : trie_canciones;
+        return materializar(trie.buscar_top_k(prefijo, k));
     }
 
     bool eliminar_cancion_por_nombre(const string& nombre, bool por_artista = false) {
         auto canciones = buscar_canciones_por_trie(nombre, por_artista);
         
-        if (canciones.empty()) {
-            cout << "No se encontraron canciones.\n";
+        if (canciones.empty()) {
+            cout << "No se encontraron canciones.\n";
+            return false;
+        }
+        
+        // Si hay múltiples canciones, mostrar opciones
+        if (canciones.size() > 1) {
+            cout << "Se encontraron múltiples canciones:\n";
+            for (size_t i = 0; i < canciones.size(); ++i) {
+                cout << i + 1 << ". " 
+                     << canciones[i].track_name 
+                     << " - " << canciones[i].artist_name 
+                     << " (ID: " << canciones[i].track_id << ")\n";
+            }
+            
+            size_t seleccion;
+            cout << "Seleccione el número de la canción a eliminar: ";
+            cin >> seleccion;
+            
+            if (seleccion < 1 || seleccion > canciones.size()) {
+                cout << "Selección inválida.\n";
+                return false;
+            }
+            
+            return eliminar_cancion(canciones[seleccion - 1].track_id);
+        }
+        
+        // Si solo hay una canción
+        return eliminar_cancion(canciones[0].track_id);
+    }
+    
+    void mover_cancion_por_nombre(const string& nombre, size_t nueva_posicion, bool por_artista = false) {
+        auto canciones = buscar_canciones_por_trie(nombre, por_artista);
+        
+        if (canciones.empty()) {
+            cout << "No se encontraron canciones.\n";
+            return;
+        }
+        
+        // Si hay múltiples canciones, mostrar opciones
+        if (canciones.size() > 1) {
+            cout << "Se encontraron múltiples canciones:\n";
+            for (size_t i = 0; i < canciones.size(); ++i) {
+                cout << i + 1 << ". " 
+                     << canciones[i].track_name 
+                     << " - " << canciones[i].artist_name 
+                     << " (ID: " << canciones[i].track_id << ")\n";
+            }
+            
+            size_t seleccion;
+            cout << "Seleccione el número de la canción a mover: ";
+            cin >> seleccion;
+            
+            if (seleccion < 1 || seleccion > canciones.size()) {
+                cout << "Selección inválida.\n";
+                return;
+            }
+            
+            try {
+                size_t desde = mover_cancion(canciones[seleccion - 1].track_id, nueva_posicion);
+                cout << "Canción movida de la posición " << desde << " a la " << nueva_posicion << ".\n";
+            } catch (const exception& e) {
+                cout << "Error: " << e.what() << "\n";
+            }
+            return;
+        }
+        
+        // Si solo hay una canción
+        try {
+            size_t desde = mover_cancion(canciones[0].track_id, nueva_posicion);
+            cout << "Canción movida de la posición " << desde << " a la " << nueva_posicion << ".\n";
+        } catch (const exception& e) {
+            cout << "Error: " << e.what() << "\n";
+        }
+    }
+    
+    struct Pagina {
+        vector<Cancion> canciones;
+        size_t total_canciones;
+        size_t pagina_actual;
+        size_t total_paginas;
+    };
+
+    // La página se lee directamente del árbol, sin copiar la lista completa
+    Pagina listar_canciones_paginado(size_t pagina = 1, size_t canciones_por_pagina = 200) const {
+        return paginar(bTree.size(), pagina, canciones_por_pagina,
+            [this](size_t inicio, size_t cantidad) { return bTree.rango(inicio, cantidad); });
+    }
+
+    Pagina listar_por_popularidad_paginado(bool ascendente = true, size_t pagina = 1, size_t canciones_por_pagina = 200) const {
+        return paginar(indice_popularidad.size(), pagina, canciones_por_pagina,
+            [this, ascendente](size_t inicio, size_t cantidad) {
+                return indice_popularidad.rango(inicio, cantidad, ascendente);
+            });
+    }
+
+    Pagina obtener_por_anio_paginado(int anio, size_t pagina = 1, size_t canciones_por_pagina = 200) const {
+        return obtener_por_anios_paginado(anio, anio, pagina, canciones_por_pagina);
+    }
+
+    // Canciones de los años [desde, hasta], por año y luego por nombre
+    Pagina obtener_por_anios_paginado(int desde, int hasta, size_t pagina = 1, size_t canciones_por_pagina = 200) const {
+        return paginar(indice_anios.contar(desde, hasta), pagina, canciones_por_pagina,
+            [this, desde, hasta](size_t inicio, size_t cantidad) {
+                return indice_anios.rango(desde, hasta, inicio, cantidad);
+            });
+    }
+
+    Pagina listar_por_duracion_paginado(bool ascendente = true, size_t pagina = 1, size_t canciones_por_pagina = 200) const {
+        return paginar(indice_duracion.size(), pagina, canciones_por_pagina,
+            [this, ascendente](size_t inicio, size_t cantidad) {
+                return indice_duracion.rango(inicio, cantidad, ascendente);
+            });
+    }
+
+    Pagina listar_cola_paginado(size_t pagina = 1, size_t canciones_por_pagina = 200) const {
+        return paginar(cola.size(), pagina, canciones_por_pagina,
+            [this](size_t inicio, size_t cantidad) { return cola.rango(inicio, cantidad); });
+    }
+
+    // Canciones que cumplen todas las condiciones del filtro, en orden de id
+    CursorFiltro filtrar(const FiltroCanciones& filtro) const {
+        return filtros.filtrar(catalogo, filtro);
+    }
+
+    // Resume `medida` por género, año o artista: cantidad, suma, media,
+    // mínimo, máximo y los cuantiles pedidos (entre 0 y 1). Los años salen en
+    // orden; los géneros y artistas, de más a menos canciones (los empates en
+    // el orden en que aparecieron en el catálogo). Usa `hilos`
+    // hilos (0 = todos). Definida después de los cargadores de CSV.
+    vector<EstadisticaGrupo> agrupar(Agrupacion agrupacion, Medida medida,
+                                     const vector<double>& cuantiles = {}, size_t hilos = 0) const;
+
+    // Solo se crean las Cancion de la página pedida
+    Pagina filtrar_paginado(const CursorFiltro& cursor, size_t pagina = 1,
+                            size_t canciones_por_pagina = 200) const {
+        return paginar(cursor.total(), pagina, canciones_por_pagina,
+            [&cursor](size_t inicio, size_t cantidad) { return cursor.rango(inicio, cantidad); });
+    }
+
+    // Las k canciones de la lista más parecidas a `track_id` según sus rasgos
+    // de audio, de la más parecida a la menos; `pesos` da la importancia de
+    // cada rasgo (en el orden de MatrizRasgos). Usa `hilos` hilos (0 = todos).
+    // Definida después de los cargadores de CSV.
+    vector<Cancion> buscar_similares(const string& track_id, size_t k,
+                                     const MatrizRasgos::Pesos& pesos = MatrizRasgos::pesos_iguales(),
+                                     size_t hilos = 0) const;
+
+    // Arma el grafo de vecinos si todavía no está; desde entonces se mantiene
+    // en cada alta y baja
+    void construir_indice_vecinos() {
+        if (!vecinos_vigente) {
+            indice_vecinos.construir(catalogo, parametros_vecinos);
+            vecinos_vigente = true;
+        }
+    }
+
+    // Como buscar_similares con pesos iguales, pero sobre el grafo HNSW: no
+    // recorre el catálogo y puede omitir alguna de las exactas. `ef` = 0 usa
+    // parametros_vecinos.ef_busqueda. El grafo tiene que estar armado con
+    // construir_indice_vecinos o abierto con abrir_indice_vecinos.
+    vector<Cancion> buscar_similares_aproximado(const string& track_id, size_t k, size_t ef = 0) const {
+        if (!vecinos_vigente) {
+            throw runtime_error("El índice de vecinos no está construido");
+        }
+        uint32_t id = catalogo.buscar_id(track_id);
+        if (id == CatalogoColumnar::SIN_CANCION) {
+            throw runtime_error("Canción no encontrada");
+        }
+        vector<uint32_t> ids;
+        for (const auto& vecino : indice_vecinos.buscar(catalogo, id, k, ef)) {
+            ids.push_back(vecino.second);
+        }
+        return materializar(ids);
+    }
+
+    bool indice_vecinos_listo() const {
+        return vecinos_vigente;
+    }
+
+    // Guarda el grafo de vecinos con la firma del CSV, como guardar_instantanea
+    void guardar_indice_vecinos(const string& ruta, const string& ruta_csv) const {
+        if (!vecinos_vigente) {
+            throw runtime_error("El índice de vecinos no está construido");
+        }
+        EscritorInstantanea escritor(ruta, firma_archivo(ruta_csv));
+        indice_vecinos.guardar(escritor);
+        escritor.cerrar();
+    }
+
+    // Abre un grafo guardado con guardar_indice_vecinos. Devuelve false (sin
+    // modificar la lista) si no existe, está dañado, el CSV cambió o no tiene
+    // exactamente las canciones de la lista.
+    bool abrir_indice_vecinos(const string& ruta, const string& ruta_csv) {
+        error_code error;
+        if (!filesystem::exists(ruta, error)) {
+            return false;
+        }
+        try {
+            ArchivoMapeado archivo(ruta);
+            optional<LectorInstantanea> contenido = abrir_contenido_instantanea(archivo, ruta_csv);
+            if (!contenido) {
+                return false;
+            }
+            IndiceHNSW leido;
+            leido.cargar(*contenido);
+            if (!leido.coincide_con(catalogo)) {
+                return false;
+            }
+            indice_vecinos = move(leido);
+            parametros_vecinos = indice_vecinos.parametros;
+            vecinos_vigente = true;
+            return true;
+        } catch (const exception& e) {
+            cerr << "No se pudo usar el índice de vecinos " << ruta << ": " << e.what() << '\n';
+            return false;
+        }
+    }
+
+    // Cambia los parámetros del grafo de vecinos. Si ya estaba armado y
+    // cambian m o ef_construccion, se rehace aquí; ef_busqueda rige enseguida.
+    void configurar_vecinos(const IndiceHNSW::Parametros& parametros) {
+        bool rehacer = parametros.m != parametros_vecinos.m ||
+                       parametros.ef_construccion != parametros_vecinos.ef_construccion;
+        parametros_vecinos = parametros;
+        indice_vecinos.parametros.ef_busqueda = parametros.ef_busqueda;
+        if (vecinos_vigente && rehacer) {
+            indice_vecinos.construir(catalogo, parametros_vecinos);
+        }
+    }
+
+  private:
+    // Las altas y bajas la actualizan fila por fila; solo se rehace entera
+    // si una alta queda fuera del rango con que se estandarizó
+    MatrizRasgos rasgos;
+    IndiceHNSW indice_vecinos;
+    IndiceHNSW::Parametros parametros_vecinos;
+    bool vecinos_vigente = false;
+    // Último CSV que no se pudo indexar; no se reintenta mientras no cambie
+    string ruta_sin_indice;
+    FirmaArchivo firma_sin_indice;
+
+    // El catálogo va a reemplazarse o a cambiar sus ids: ya no es el del CSV
+    void olvidar_origen_csv() {
+        filas_csv = 0;
+        if (indice_csv.usa(catalogo)) {
+            indice_csv.vaciar();
+        }
+    }
+
+    void agregar_rasgos(const vector<uint32_t>& ids) {
+        for (uint32_t id : ids) {
+            if (!rasgos.agregar(catalogo, id)) {
+                // construir toma todas las vivas, también las que faltaban agregar
+                rasgos.construir(catalogo);
+                return;
+            }
+        }
+    }
+
+    void indexar_vecinos(const vector<uint32_t>& ids) {
+        if (vecinos_vigente) {
+            for (uint32_t id : ids) {
+                indice_vecinos.insertar(catalogo, id);
+            }
+        }
+    }
+
+    // Ordena los ids recién agregados al catálogo por la clave del árbol,
+    // llena los tries en lote y reconstruye el árbol y los índices secundarios
+    // de abajo hacia arriba
+    void indexar_nuevas(vector<uint32_t>&& nuevos) {
+        auto por_nombre = [this](uint32_t a, uint32_t b) { return bTree.antes(a, b); };
+        stable_sort(nuevos.begin(), nuevos.end(), por_nombre);
+
+        vector<TrieCompacto::Entrada> artistas;
+        vector<TrieCompacto::Entrada> nombres;
+        artistas.reserve(nuevos.size());
+        nombres.reserve(nuevos.size());
+        for (uint32_t id : nuevos) {
+            artistas.push_back({string(catalogo.artist_name(id)), id, catalogo.popularity[id]});
+            nombres.push_back({string(catalogo.track_name(id)), id, catalogo.popularity[id]});
+        }
+        trie_artistas.insertar_lote(artistas);
+        trie_canciones.insertar_lote(nombres);
+
+        bool habia_canciones = total_canciones > 0;
+        total_canciones += nuevos.size();
+        reconstruir_con(indice_popularidad, nuevos, habia_canciones);
+        reconstruir_con(indice_duracion, nuevos, habia_canciones);
+        reconstruir_con(bTree, move(nuevos), habia_canciones);
+        indice_anios.construir(bTree.listar());
+    }
+
+    // Reconstruye el árbol con los ids nuevos ordenados por su criterio; si ya
+    // había canciones, se mezclan con las existentes respetando el orden
+    template <typename Orden>
+    static void reconstruir_con(ArbolBMas<Orden>& arbol, vector<uint32_t> nuevos, bool habia_canciones) {
+        auto antes = [&arbol](uint32_t a, uint32_t b) { return arbol.antes(a, b); };
+        if (!is_sorted(nuevos.begin(), nuevos.end(), antes)) {
+            sort(nuevos.begin(), nuevos.end(), antes);
+        }
+        if (habia_canciones) {
+            auto existentes = arbol.listar();
+            vector<uint32_t> todas;
+            todas.reserve(existentes.size() + nuevos.size());
+            merge(existentes.begin(), existentes.end(), nuevos.begin(), nuevos.end(),
+                  back_inserter(todas), antes);
+            nuevos = move(todas);
+        }
+        arbol.construir_desde_ordenado(move(nuevos));
+    }
+
+    // Solo se reconstruyen las canciones de la página pedida. `rango(inicio,
+    // cantidad)` devuelve los ids de esa parte del orden.
+    template <typename Rango>
+    Pagina paginar(size_t total_canciones, size_t pagina, size_t canciones_por_pagina, Rango&& rango) const {
+        size_t total_paginas = (total_canciones + canciones_por_pagina - 1) / canciones_por_pagina;
+
+        // Validar página
+        pagina = min(max(pagina, static_cast<size_t>(1)), max(total_paginas, static_cast<size_t>(1)));
+
+        // Calcular rango de canciones para la página
+        size_t inicio = min((pagina - 1) * canciones_por_pagina, total_canciones);
+        size_t fin = min(inicio + canciones_por_pagina, total_canciones);
+
+        return {
+            materializar(rango(inicio, fin - inicio)),
+            total_canciones,
+            pagina,
+            total_paginas
+        };
+    }
+
+    Pagina paginar(const vector<uint32_t>& ids, size_t pagina, size_t canciones_por_pagina) const {
+        return paginar(ids.size(), pagina, canciones_por_pagina, [&ids](size_t inicio, size_t cantidad) {
+            return vector<uint32_t>(ids.begin() + inicio, ids.begin() + inicio + cantidad);
+        });
+    }
+
+    vector<Cancion> materializar(const vector<uint32_t>& ids) const {
+        vector<Cancion> canciones;
+        canciones.reserve(ids.size());
+        for (uint32_t id : ids) {
+            canciones.push_back(catalogo.obtener(id));
+        }
+        return canciones;
+    }
+};
+
+// Lista de reproducción para varios hilos: los lectores consultan una versión
+// inmutable sin esperar nunca, mientras un escritor aplica cambios por lotes.
+// Hay hasta COPIAS listas. Los lectores usan la activa; el escritor prepara
+// la versión siguiente en otra que nadie lee y la publica cambiando el
+// índice de la activa (RCU). Para saber si alguien lee una copia, cada lector
+// anota en una ranura cuál tomó (o, si no queda ninguna, suma uno al
+// contador de esa copia) y comprueba que siga activa; si no, la suelta y
+// vuelve a empezar.
+// Normalmente alcanzan dos copias: la que era activa se pone al día
+// repitiendo los lotes que le faltan, así que cada lote cuesta lo mismo que
+// aplicarlo dos veces. Si una lectura larga la retiene, el escritor no la
+// espera: usa otra copia, o copia la activa si no hay ninguna al día.
+class ListaConcurrente {
+    static constexpr size_t RANURAS = 64;
+    // La activa, la que prepara el escritor y las que retienen lecturas largas
+    static constexpr size_t COPIAS = 4;
+    // Lotes guardados para poner al día copias atrasadas; con más se copia la activa
+    static constexpr size_t MAX_HISTORIAL = 1024;
+    // Cada ranura en su propia línea de caché, para que los lectores no se estorben
+    struct alignas(64) Ranura {
+        atomic<uint32_t> copia{0};  // 0 = libre; si no, índice de la copia + 1
+    };
+
+public:
+    // Cambio de un lote; los de un mismo lote se aplican en orden
+    struct Cambio {
+        enum class Tipo { AGREGAR, ELIMINAR, MOVER };
+        Tipo tipo;
+        Cancion cancion;   // AGREGAR
+        string track_id;   // ELIMINAR y MOVER
+        size_t posicion = 0;  // MOVER
+
+        static Cambio agregar(const Cancion& cancion) {
+            return {Tipo::AGREGAR, cancion, cancion.track_id, 0};
+        }
+        static Cambio eliminar(const string& track_id) {
+            return {Tipo::ELIMINAR, Cancion{}, track_id, 0};
+        }
+        static Cambio mover(const string& track_id, size_t posicion) {
+            return {Tipo::MOVER, Cancion{}, track_id, posicion};
+        }
+    };
+
+    // Versión que ve un lector. Mientras exista, la lista no cambia. Una
+    // lectura larga no frena al escritor, pero mantiene viva su copia.
+    class Lectura {
+    public:
+        Lectura(Lectura&& otra) noexcept
+            : ranura(exchange(otra.ranura, nullptr)), contador(exchange(otra.contador, nullptr)),
+              lista(otra.lista), numero(otra.numero) {}
+        Lectura(const Lectura&) = delete;
+        Lectura& operator=(const Lectura&) = delete;
+        Lectura& operator=(Lectura&&) = delete;
+
+        ~Lectura() {
+            soltar();
+        }
+
+        const ListaReproduccion& operator*() const {
+            return *lista;
+        }
+
+        const ListaReproduccion* operator->() const {
+            return lista;
+        }
+
+        // Número de versión: crece en uno con cada lote o carga publicada
+        uint64_t version() const {
+            return numero;
+        }
+
+    private:
+        friend class ListaConcurrente;
+        Lectura(Ranura* ranura, atomic<uint64_t>* contador) : ranura(ranura), contador(contador) {}
+
+        void soltar() {
+            if (ranura) {
+                ranura->copia.store(0, memory_order_release);
+            } else if (contador) {
+                contador->fetch_sub(1, memory_order_release);
+            }
+            ranura = nullptr;
+            contador = nullptr;
+        }
+
+        Ranura* ranura;
+        atomic<uint64_t>* contador;
+        const ListaReproduccion* lista = nullptr;
+        uint64_t numero = 0;
+    };
+
+    ListaConcurrente() {
+        copias[0].lista = make_unique<ListaReproduccion>();
+        copias[1].lista = make_unique<ListaReproduccion>();
+    }
+
+    // No espera nunca: anota la copia activa en una ranura libre (o en el
+    // contador de la copia si están todas ocupadas) y comprueba que siga
+    // activa. Solo repite si justo se publicó una versión nueva.
+    Lectura leer() const {
+        static atomic<size_t> siguiente_hilo{0};
+        thread_local size_t preferida = siguiente_hilo.fetch_add(1, memory_order_relaxed);
+        while (true) {
+            uint32_t copia = static_cast<uint32_t>(estado.load() & MASCARA_COPIA);
+            Lectura lectura(nullptr, nullptr);
+            for (size_t i = preferida; i < preferida + RANURAS && !lectura.ranura; ++i) {
+                Ranura& ranura = ranuras[i % RANURAS];
+                uint32_t libre = 0;
+                if (ranura.copia.load(memory_order_relaxed) == 0 &&
+                    ranura.copia.compare_exchange_strong(libre, copia + 1)) {
+                    lectura.ranura = &ranura;
+                }
+            }
+            if (!lectura.ranura) {
+                lectura.contador = &copias[copia].lectores_sin_ranura;
+                lectura.contador->fetch_add(1);
+            }
+            // Ya anotada: si sigue activa, el escritor no la va a tocar
+            uint64_t actual = estado.load();
+            if ((actual & MASCARA_COPIA) == copia) {
+                lectura.lista = copias[copia].lista.get();
+                lectura.numero = actual >> BITS_COPIA;
+                return lectura;
+            }
+        }
+    }
+
+    uint64_t version_actual() const {
+        return estado.load() >> BITS_COPIA;
+    }
+
+    // Aplica el lote y publica la versión nueva. Devuelve, para cada cambio,
+    // si se pudo aplicar (agregar una canción repetida, eliminar o mover una
+    // que no está, o mover a una posición inválida no cambian nada). Si falla
+    // (por ejemplo, sin memoria) lanza sin publicar nada: la versión activa
+    // sigue intacta y la copia a medio modificar se descarta.
+    vector<bool> publicar(const vector<Cambio>& lote) {
+        lock_guard<mutex> escritura(escritor);
+        size_t destino = preparar_copia();
+        vector<bool> aplicados;
+        try {
+            aplicados = aplicar(*copias[destino].lista, lote);
+            historial.emplace_back(version_actual() + 1, lote);
+        } catch (...) {
+            copias[destino].lista.reset();
+            throw;
+        }
+        publicar_copia(destino);
+        return aplicados;
+    }
+
+    // Agrega un catálogo completo (por ejemplo de cargar_csv_mapeado) y lo
+    // publica. Como publicar, si falla lanza y la versión activa no cambia.
+    void cargar_catalogo(CatalogoColumnar&& nuevo) {
+        modificar_sin_lote([&nuevo](ListaReproduccion& lista) { lista.cargar_catalogo(move(nuevo)); });
+    }
+
+    // Arma el grafo de vecinos de la lista y lo publica, si no estaba armado
+    void construir_indice_vecinos() {
+        if (!leer()->indice_vecinos_listo()) {
+            modificar_sin_lote([](ListaReproduccion& lista) { lista.construir_indice_vecinos(); });
+        }
+    }
+
+private:
+    static constexpr int BITS_COPIA = 8;
+    static constexpr uint64_t MASCARA_COPIA = (1 << BITS_COPIA) - 1;
+
+    struct Copia {
+        unique_ptr<ListaReproduccion> lista;  // nullptr = sin usar
+        uint64_t version = 0;                 // solo la usa el escritor
+        mutable atomic<uint64_t> lectores_sin_ranura{0};
+    };
+
+    atomic<uint64_t> estado{0};  // versión activa << BITS_COPIA | copia activa
+    Copia copias[COPIAS];
+    mutable Ranura ranuras[RANURAS];
+    mutex escritor;
+    // Lotes publicados, con su número de versión, que alguna copia atrasada
+    // todavía no tiene
+    deque<pair<uint64_t, vector<Cambio>>> historial;
+
+    static vector<bool> aplicar(ListaReproduccion& lista, const vector<Cambio>& lote) {
+        vector<bool> aplicados;
+        aplicados.reserve(lote.size());
+        for (const Cambio& cambio : lote) {
+            if (cambio.tipo == Cambio::Tipo::AGREGAR) {
+                aplicados.push_back(lista.agregar_cancion(cambio.cancion));
+            } else if (cambio.tipo == Cambio::Tipo::ELIMINAR) {
+                aplicados.push_back(lista.eliminar_cancion(cambio.track_id));
+            } else {
+                try {
+                    lista.mover_cancion(cambio.track_id, cambio.posicion);
+                    aplicados.push_back(true);
+                } catch (const runtime_error&) {
+                    aplicados.push_back(false);
+                }
+            }
+        }
+        return aplicados;
+    }
+
+    // Para cambios que no se guardan como lote, como una carga completa: las
+    // demás copias ya no se pueden poner al día y se rehacen copiando la
+    // activa la próxima vez que haga falta una
+    template <typename Modificar>
+    void modificar_sin_lote(Modificar&& modificar) {
+        lock_guard<mutex> escritura(escritor);
+        size_t destino = preparar_copia();
+        try {
+            modificar(*copias[destino].lista);
+        } catch (...) {
+            copias[destino].lista.reset();
+            throw;
+        }
+        historial.clear();
+        publicar_copia(destino);
+    }
+
+    bool en_uso(size_t copia) const {
+        if (copias[copia].lectores_sin_ranura.load() != 0) {
+            return true;
+        }
+        for (const Ranura& ranura : ranuras) {
+            if (ranura.copia.load() == copia + 1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // true si repitiendo lotes del historial la copia llega a la versión activa
+    bool se_puede_poner_al_dia(size_t copia) const {
+        uint64_t version = copias[copia].version;
+        return copias[copia].lista &&
+               (version == version_actual() || (!historial.empty() && historial.front().first <= version + 1));
+    }
+
+    // Devuelve una copia que nadie lee, igual a la activa. Prefiere una que
+    // se pueda poner al día con el historial; a la que acaba de dejar de ser
+    // activa le da un momento para que terminen las lecturas cortas. Si todas
+    // las demás están retenidas por lecturas largas, las espera.
+    size_t preparar_copia() {
+        size_t activa = estado.load() & MASCARA_COPIA;
+        auto inicio = chrono::steady_clock::now();
+        while (true) {
+            size_t al_dia = COPIAS;
+            size_t libre = COPIAS;
+            bool retenida_al_dia = false;
+            for (size_t i = 0; i < COPIAS; ++i) {
+                if (i == activa) {
+                    continue;
+                }
+                bool util = se_puede_poner_al_dia(i);
+                if (en_uso(i)) {
+                    retenida_al_dia = retenida_al_dia || util;
+                } else if (util && al_dia == COPIAS) {
+                    al_dia = i;
+                } else if (!util && libre == COPIAS) {
+                    libre = i;
+                }
+            }
+            bool esperar = retenida_al_dia && chrono::steady_clock::now() - inicio < chrono::milliseconds(1);
+            if (al_dia != COPIAS) {
+                // Las atrasadas que ya nadie lee no se van a poder usar
+                for (size_t i = 0; i < COPIAS; ++i) {
+                    if (i != activa && i != al_dia && !se_puede_poner_al_dia(i) && !en_uso(i)) {
+                        copias[i].lista.reset();
+                    }
+                }
+                poner_al_dia(al_dia);
+                return al_dia;
+            }
+            if (libre != COPIAS && !esperar) {
+                // Se libera antes de copiar para no tener las dos a la vez
+                copias[libre].lista.reset();
+                copias[libre].lista = copias[activa].lista->clonar();
+                copias[libre].version = version_actual();
+                return libre;
+            }
+            this_thread::yield();
+        }
+    }
+
+    void poner_al_dia(size_t copia) {
+        try {
+            for (const auto& [version, lote] : historial) {
+                if (version > copias[copia].version) {
+                    aplicar(*copias[copia].lista, lote);
+                    copias[copia].version = version;
+                }
+            }
+        } catch (...) {
+            copias[copia].lista.reset();
+            throw;
+        }
+    }
+
+    // Quien entre después ve la copia nueva; quien ya leía la anterior la sigue
+    // usando hasta soltarla. El historial se recorta a lo que les falta a las
+    // copias atrasadas que quedan.
+    void publicar_copia(size_t copia) {
+        uint64_t numero = version_actual() + 1;
+        copias[copia].version = numero;
+        estado.store(numero << BITS_COPIA | copia);
+        uint64_t necesaria = numero;
+        for (size_t i = 0; i < COPIAS; ++i) {
+            if (se_puede_poner_al_dia(i)) {
+                necesaria = min(necesaria, copias[i].version);
+            }
+        }
+        while (!historial.empty() &&
+               (historial.front().first <= necesaria || historial.size() > MAX_HISTORIAL)) {
+            historial.pop_front();
+        }
+    }
+};
+
+// Conversión sin excepciones ni dependencia del locale. Vacío equivale a 0.
+// A diferencia de stoi/stof, todo el texto debe ser el número: "12abc", " 12"
+// y "+5" se rechazan. Todos los cargadores de CSV leen las filas con esto.
+template <typename T>
+bool leer_numero(string_view texto, T& valor) {
+    if (texto.empty()) {
+        valor = 0;
+        return true;
+    }
+    const char* fin = texto.data() + texto.size();
+    auto resultado = from_chars(texto.data(), fin, valor);
+    return resultado.ec == errc() && resultado.ptr == fin;
+}
+
+// Interpreta los campos de una línea de spotify_data.csv. Rechaza la fila si
+// falta algún campo, algún número no se puede leer o no cabe en su columna.
+bool convertir_fila(const string_view* campos, size_t num_campos, FilaCancion& fila) {
+    if (num_campos < 19) {
+        return false;
+    }
+    fila.artist_name = campos[1];
+    fila.track_name = campos[2];
+    fila.track_id = campos[3];
+    fila.genre = campos[6];
+    // time_signature puede faltar o estar vacía; entonces vale 4
+    fila.time_signature = 4;
+    if (num_campos > 19 && !campos[19].empty() && !leer_numero(campos[19], fila.time_signature)) {
+        return false;
+    }
+    return leer_numero(campos[4], fila.popularity) &&
+           leer_numero(campos[5], fila.anio) &&
+           leer_numero(campos[7], fila.danceability) &&
+           leer_numero(campos[8], fila.energy) &&
+           leer_numero(campos[9], fila.key) &&
+           leer_numero(campos[10], fila.loudness) &&
+           leer_numero(campos[11], fila.mode) &&
+           leer_numero(campos[12], fila.speechiness) &&
+           leer_numero(campos[13], fila.acousticness) &&
+           leer_numero(campos[14], fila.instrumentalness) &&
+           leer_numero(campos[15], fila.liveness) &&
+           leer_numero(campos[16], fila.valence) &&
+           leer_numero(campos[17], fila.tempo) &&
+           leer_numero(campos[18], fila.duration_ms) &&
+           CatalogoColumnar::cabe_en_columnas(fila);
+}
+
+// Optimización de carga de CSV
+vector<Cancion> cargar_csv(const string& file_path) {
+    vector<Cancion> canciones;
+    
+    // Abrir el archivo con ifstream en modo binario para mayor eficiencia
+    ifstream file(file_path, ios::binary | ios::ate);
+    
+    if (!file.is_open()) {
+        throw runtime_error("No se pudo abrir el archivo: " + file_path);
+    }
+
+    // Obtener tamaño del archivo de manera más eficiente
+    streamsize file_size = file.tellg();
+    file.seekg(0, ios::beg);
+
+    // Reserva de memoria con tamaño más preciso
+    canciones.reserve(file_size / 250);  // Estimación más ajustada
+
+    // Buffer para lectura de líneas
+    string linea;
+    linea.reserve(300);  // Reservar memoria para cada línea
+
+    // Saltar encabezado
+    getline(file, linea);
+
+    // Usar vectores de strings con reserva para parsing
+    vector<string> campos;
+    campos.reserve(20);
+
+    // Contador de progreso y medición de tiempo
+    size_t contador = 0;
+    auto inicio = chrono::high_resolution_clock::now();
+
+    // Parsing más rápido con parsing manual
+    while (getline(file, linea)) {
+        campos.clear();
+        if (!linea.empty() && linea.back() == '\r') {
+            linea.pop_back();
+        }
+        
+        // Parsing de CSV manual más rápido que stringstream
+        size_t pos = 0;
+        size_t next_pos = 0;
+        while ((next_pos = linea.find(',', pos)) != string::npos) {
+            campos.push_back(linea.substr(pos, next_pos - pos));
+            pos = next_pos + 1;
+        }
+        // Añadir último campo
+        campos.push_back(linea.substr(pos));
+
+        // Las mismas reglas que los cargadores proyectados: una fila inválida
+        // se descarta en los dos
+        string_view vistas[20];
+        size_t num_campos = min(campos.size(), size(vistas));
+        for (size_t i = 0; i < num_campos; ++i) {
+            vistas[i] = campos[i];
+        }
+        FilaCancion fila;
+        if (convertir_fila(vistas, num_campos, fila)) {
+            canciones.emplace_back(
+                string(fila.artist_name), string(fila.track_name), string(fila.track_id),
+                fila.popularity, fila.anio, string(fila.genre), fila.danceability, fila.energy,
+                fila.key, fila.loudness, fila.mode, fila.speechiness, fila.acousticness,
+                fila.instrumentalness, fila.liveness, fila.valence, fila.tempo,
+                fila.duration_ms, fila.time_signature);
+            contador++;
+        }
+
+        // Cada 100,000 registros, muestra progreso
+        if (contador % 100000 == 0) {
+            auto actual = chrono::high_resolution_clock::now();
+            auto duracion = chrono::duration_cast<chrono::milliseconds>(actual - inicio);
+            cout << "Procesados " << contador << " registros. Tiempo: " 
+                 << duracion.count() << " ms\n";
+        }
+    }
+
+    // Reducir capacidad al tamaño exacto
+    canciones.shrink_to_fit();
+
+    // Mostrar estadísticas finales
+    auto fin = chrono::high_resolution_clock::now();
+    auto duracion_total = chrono::duration_cast<chrono::milliseconds>(fin - inicio);
+    
+    cout << "Carga completa. Total canciones: " << canciones.size() 
+         << ". Tiempo total: " << duracion_total.count() << " ms\n";
+
+    return canciones;
+}
+
+struct EstadisticasCarga {
+    size_t filas_validas = 0;
+    size_t filas_invalidas = 0;
+    size_t filas_repetidas = 0;
+    size_t bytes = 0;
+    long long ms = 0;
+};
+
+// Recorre las líneas de [inicio, fin) y llama a por_fila(campos, num_campos)
+// con cada una. Las comas y saltos de línea se buscan de a 16 bytes con SSE2.
+template <typename PorFila>
+void recorrer_filas_csv(const char* inicio, const char* fin, PorFila&& por_fila) {
+    constexpr size_t MAX_CAMPOS = 24;
+    string_view campos[MAX_CAMPOS];
+    size_t num_campos = 0;
+    const char* inicio_campo = inicio;
+
+    auto cerrar_campo = [&](const char* fin_campo) {
+        if (num_campos < MAX_CAMPOS) {
+            campos[num_campos] = string_view(inicio_campo, fin_campo - inicio_campo);
+        }
+        num_campos++;
+    };
+    auto procesar_delimitador = [&](const char* p) {
+        if (*p == ',') {
+            cerrar_campo(p);
+        } else {
+            // Fin de línea (se descarta el '\r' de los archivos de Windows)
+            cerrar_campo(p > inicio_campo && p[-1] == '\r' ? p - 1 : p);
+            por_fila(campos, min(num_campos, MAX_CAMPOS));
+            num_campos = 0;
+        }
+        inicio_campo = p + 1;
+    };
+
+    const char* p = inicio;
+#if defined(__SSE2__) && defined(__GNUC__)
+    const __m128i coma = _mm_set1_epi8(',');
+    const __m128i salto = _mm_set1_epi8('\n');
+    for (; p + 16 <= fin; p += 16) {
+        __m128i bloque = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mascara = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(bloque, coma), _mm_cmpeq_epi8(bloque, salto))));
+        while (mascara) {
+            procesar_delimitador(p + __builtin_ctz(mascara));
+            mascara &= mascara - 1;
+        }
+    }
+#endif
+    for (; p < fin; ++p) {
+        if (*p == ',' || *p == '\n') {
+            procesar_delimitador(p);
+        }
+    }
+
+    // Última línea sin salto final
+    if (inicio_campo < fin || num_campos > 0) {
+        cerrar_campo(fin > inicio_campo && fin[-1] == '\r' ? fin - 1 : fin);
+        por_fila(campos, min(num_campos, MAX_CAMPOS));
+    }
+}
+
+// Contador de filas compartido entre hilos; informa cada 100,000 registros
+class ProgresoCarga {
+public:
+    ProgresoCarga() : inicio(chrono::high_resolution_clock::now()) {}
+
+    void sumar(size_t filas) {
+        size_t antes = total.fetch_add(filas);
+        size_t despues = antes + filas;
+        for (size_t marca = (antes / 100000 + 1) * 100000; marca <= despues; marca += 100000) {
+            auto actual = chrono::high_resolution_clock::now();
+            auto duracion = chrono::duration_cast<chrono::milliseconds>(actual - inicio);
+            lock_guard<mutex> bloqueo(salida);
+            cout << "Procesados " << marca << " registros. Tiempo: " 
+                 << duracion.count() << " ms\n";
+        }
+    }
+
+    long long milisegundos() const {
+        auto actual = chrono::high_resolution_clock::now();
+        return chrono::duration_cast<chrono::milliseconds>(actual - inicio).count();
+    }
+
+private:
+    chrono::high_resolution_clock::time_point inicio;
+    atomic<size_t> total{0};
+    mutex salida;
+};
+
+// Interpreta las líneas de [inicio, fin) y las agrega al catálogo
+void cargar_fragmento_csv(const char* inicio, const char* fin, CatalogoColumnar& catalogo,
+                          EstadisticasCarga& estadisticas, ProgresoCarga& progreso) {
+    constexpr size_t LOTE_PROGRESO = 4096;
+    size_t sin_informar = 0;
+    FilaCancion fila;
+    recorrer_filas_csv(inicio, fin, [&](const string_view* campos, size_t num_campos) {
+        if (!convertir_fila(campos, num_campos, fila)) {
+            estadisticas.filas_invalidas++;
+            return;
+        }
+        if (catalogo.agregar_si_nueva(fila) == CatalogoColumnar::SIN_CANCION) {
+            estadisticas.filas_repetidas++;
+            return;
+        }
+        estadisticas.filas_validas++;
+        if (++sin_informar == LOTE_PROGRESO) {
+            progreso.sumar(sin_informar);
+            sin_informar = 0;
+        }
+    });
+    progreso.sumar(sin_informar);
+}
+
+// Ejecuta tarea(i) para cada i en [0, cantidad), una por hilo
+template <typename Tarea>
+void ejecutar_en_paralelo(size_t cantidad, Tarea&& tarea) {
+    vector<thread> hilos;
+    hilos.reserve(cantidad);
+    for (size_t i = 1; i < cantidad; ++i) {
+        hilos.emplace_back([&tarea, i] { tarea(i); });
+    }
+    if (cantidad > 0) {
+        tarea(0);
+    }
+    for (auto& hilo : hilos) {
+        hilo.join();
+    }
+}
+
+size_t hilos_disponibles() {
+    return max<size_t>(1, thread::hardware_concurrency());
+}
+
+void informar_carga(const EstadisticasCarga& estadisticas) {
+    cout << "Carga completa. Total canciones: " << estadisticas.filas_validas
+         << ". Filas inválidas: " << estadisticas.filas_invalidas
+         << ". Tiempo total: " << estadisticas.ms << " ms\n";
+}
+
+// Carga el CSV proyectándolo en memoria y llenando el catálogo columnar
+// directamente, sin crear cadenas por campo. Las filas mal formadas se
+// cuentan en lugar de lanzar excepciones; los track_id repetidos se omiten.
+CatalogoColumnar cargar_csv_mapeado(const string& file_path, EstadisticasCarga* estadisticas = nullptr) {
+    ProgresoCarga progreso;
+    ArchivoMapeado archivo(file_path);
+    const char* datos = archivo.datos();
+    const char* fin = datos + archivo.tamano();
+
+    // Saltar encabezado
+    const char* cuerpo = datos ? static_cast<const char*>(memchr(datos, '\n', archivo.tamano())) : nullptr;
+    cuerpo = cuerpo ? cuerpo + 1 : fin;
+
+    CatalogoColumnar catalogo;
+    catalogo.reservar(archivo.tamano() / 120);
+
+    EstadisticasCarga locales;
+    locales.bytes = archivo.tamano();
+    cargar_fragmento_csv(cuerpo, fin, catalogo, locales, progreso);
+
+    locales.ms = progreso.milisegundos();
+    informar_carga(locales);
+    if (estadisticas) {
+        *estadisticas = locales;
+    }
+    return catalogo;
+}
+
+// Igual que cargar_csv_mapeado, pero divide el archivo en rangos de bytes
+// alineados a saltos de línea y los interpreta en paralelo. Los catálogos
+// parciales se unen en el orden del archivo, así que el resultado es idéntico
+// fila por fila al de la carga secuencial.
+CatalogoColumnar cargar_csv_paralelo(const string& file_path, size_t num_hilos = 0,
+                                     EstadisticasCarga* estadisticas = nullptr) {
+    ProgresoCarga progreso;
+    ArchivoMapeado archivo(file_path);
+    const char* datos = archivo.datos();
+    const char* fin = datos + archivo.tamano();
+
+    const char* cuerpo = datos ? static_cast<const char*>(memchr(datos, '\n', archivo.tamano())) : nullptr;
+    cuerpo = cuerpo ? cuerpo + 1 : fin;
+
+    // Rangos de tamaño parecido; cada corte avanza hasta el siguiente salto
+    if (num_hilos == 0) {
+        num_hilos = hilos_disponibles();
+    }
+    size_t tamano_cuerpo = fin - cuerpo;
+    num_hilos = max<size_t>(1, min(num_hilos, tamano_cuerpo / (1 << 20) + 1));
+    vector<const char*> cortes{cuerpo};
+    for (size_t i = 1; i < num_hilos; ++i) {
+        const char* corte = max(cortes.back(), cuerpo + tamano_cuerpo * i / num_hilos);
+        const char* salto = static_cast<const char*>(memchr(corte, '\n', fin - corte));
+        cortes.push_back(salto ? salto + 1 : fin);
+    }
+    cortes.push_back(fin);
+
+    vector<CatalogoColumnar> parciales(num_hilos);
+    vector<EstadisticasCarga> estadisticas_parciales(num_hilos);
+    ejecutar_en_paralelo(num_hilos, [&](size_t i) {
+        parciales[i].reservar((cortes[i + 1] - cortes[i]) / 120);
+        cargar_fragmento_csv(cortes[i], cortes[i + 1], parciales[i],
+                             estadisticas_parciales[i], progreso);
+    });
+
+    // Unión en orden del archivo
+    EstadisticasCarga locales;
+    locales.bytes = archivo.tamano();
+    CatalogoColumnar catalogo = move(parciales[0]);
+    size_t repetidas_entre_fragmentos = 0;
+    for (size_t i = 0; i < num_hilos; ++i) {
+        if (i > 0) {
+            repetidas_entre_fragmentos += catalogo.anexar(parciales[i]);
+            parciales[i] = CatalogoColumnar();
+        }
+        locales.filas_validas += estadisticas_parciales[i].filas_validas;
+        locales.filas_invalidas += estadisticas_parciales[i].filas_invalidas;
+        locales.filas_repetidas += estadisticas_parciales[i].filas_repetidas;
+    }
+    if (repetidas_entre_fragmentos > 0) {
+        // Las repetidas quedaron marcadas como eliminadas; se compacta para
+        // que los ids coincidan con los de la carga secuencial
+        catalogo = catalogo.compactado();
+        locales.filas_validas -= repetidas_entre_fragmentos;
+        locales.filas_repetidas += repetidas_entre_fragmentos;
+    }
+
+    locales.ms = progreso.milisegundos();
+    informar_carga(locales);
+    if (estadisticas) {
+        *estadisticas = locales;
+    }
+    return catalogo;
+}
+
+// Carga el CSV en la lista. Si la lista está vacía y hay una instantánea
+// vigente (archivo.csv.snap) se abre esa; si no, se lee el CSV y se guarda
+// una instantánea nueva para el próximo inicio.
+void cargar_canciones(ListaReproduccion& playlist, const string& file_path) {
+    string ruta_instantanea = file_path + ".snap";
+    auto inicio = chrono::high_resolution_clock::now();
+    if (playlist.abrir_instantanea(ruta_instantanea, file_path)) {
+        auto fin = chrono::high_resolution_clock::now();
+        cout << "Instantánea cargada. Total canciones: " << playlist.total_canciones
+             << ". Tiempo total: "
+             << chrono::duration_cast<chrono::milliseconds>(fin - inicio).count() << " ms\n";
+        playlist.abrir_indice_vecinos(file_path + ".hnsw", file_path);
+        return;
+    }
+
+    bool estaba_vacia = playlist.total_canciones == 0;
+    playlist.cargar_catalogo(cargar_csv_paralelo(file_path));
+    if (estaba_vacia) {
+        playlist.recordar_origen_csv(file_path);
+        try {
+            playlist.guardar_instantanea(ruta_instantanea, file_path);
+        } catch (const exception& e) {
+            cerr << "No se pudo guardar la instantánea: " << e.what() << '\n';
+        }
+        playlist.abrir_indice_vecinos(file_path + ".hnsw", file_path);
+    }
+}
+
+// Arma el índice de prefijos del catálogo completo. Si la lista salió de
+// ese mismo archivo y no cambió, indexa el catálogo de la lista sin copiarlo;
+// si no, lo lee de la instantánea vigente o del CSV una sola vez. Un fallo
+// se recuerda para no releer el archivo en cada consulta.
+bool ListaReproduccion::preparar_indice_csv(const string& file_path) {
+    FirmaArchivo firma = firma_archivo(file_path);
+    if (file_path == ruta_sin_indice && firma.misma(firma_sin_indice)) {
+        return false;
+    }
+    if (filas_csv > 0 && file_path == ruta_csv && firma.misma(firma_csv)) {
+        vector<uint32_t> ids(filas_csv);
+        iota(ids.begin(), ids.end(), 0u);
+        indice_csv.construir_sobre(catalogo, move(ids));
+        return true;
+    }
+    CatalogoColumnar completo;
+    OrdenesInstantanea ordenes;
+    if (leer_instantanea(file_path + ".snap", file_path, completo, ordenes)) {
+        indice_csv.construir(move(completo), move(ordenes.artistas), move(ordenes.nombres));
+        return true;
+    }
+    try {
+        cout << "Indexando el catálogo completo de " << file_path << "...\n";
+        indice_csv.construir(cargar_csv_paralelo(file_path));
+        return true;
+    } catch (const runtime_error& e) {
+        cerr << e.what() << '\n';
+        ruta_sin_indice = file_path;
+        firma_sin_indice = firma;
+        return false;
+    }
+}
+
+vector<pair<float, uint32_t>> MatrizRasgos::vecinos(const array<float, NUM_RASGOS>& consulta, size_t k,
+                                                   const Pesos& pesos, uint32_t excluir,
+                                                   size_t hilos) const {
+    // Con pocas filas por hilo no compensa crear hilos
+    constexpr size_t MIN_FILAS_POR_HILO = 32768;
+    hilos = max<size_t>(1, min(hilos, filas() / MIN_FILAS_POR_HILO));
+    if (k == 0 || filas() == 0) {
+        return {};
+    }
+
+    // Montículo de máximos: en la cima queda el peor de los k mejores
+    vector<vector<pair<float, uint32_t>>> mejores(hilos);
+    ejecutar_en_paralelo(hilos, [&](size_t h) {
+        auto& propios = mejores[h];
+        propios.reserve(k + 1);
+        size_t desde = filas() * h / hilos;
+        size_t hasta = filas() * (h + 1) / hilos;
+        float distancias[BLOQUE];
+        for (size_t bloque = desde; bloque < hasta; bloque += BLOQUE) {
+            size_t fin = min(hasta, bloque + BLOQUE);
+            distancias_bloque(bloque, fin, consulta, pesos, distancias);
+            for (size_t fila = bloque; fila < fin; ++fila) {
+                float distancia = distancias[fila - bloque];
+                if (propios.size() == k && !(distancia < propios.front().first)) {
+                    continue;
+                }
+                if (ids[fila] == excluir) {
+                    continue;
+                }
+                propios.emplace_back(distancia, ids[fila]);
+                push_heap(propios.begin(), propios.end());
+                if (propios.size() > k) {
+                    pop_heap(propios.begin(), propios.end());
+                    propios.pop_back();
+                }
+            }
+        }
+    });
+
+    vector<pair<float, uint32_t>> resultado;
+    for (const auto& propios : mejores) {
+        resultado.insert(resultado.end(), propios.begin(), propios.end());
+    }
+    size_t cantidad = min(k, resultado.size());
+    partial_sort(resultado.begin(), resultado.begin() + cantidad, resultado.end());
+    resultado.resize(cantidad);
+    return resultado;
+}
+
+vector<Cancion> ListaReproduccion::buscar_similares(const string& track_id, size_t k,
+                                                    const MatrizRasgos::Pesos& pesos, size_t hilos) const {
+    uint32_t id = catalogo.buscar_id(track_id);
+    if (id == CatalogoColumnar::SIN_CANCION) {
+        throw runtime_error("Canción no encontrada");
+    }
+    vector<uint32_t> ids;
+    for (const auto& vecino : rasgos.vecinos(rasgos.rasgos_de(catalogo, id), k, pesos, id,
+                                             hilos == 0 ? hilos_disponibles() : hilos)) {
+        ids.push_back(vecino.second);
+    }
+    return materializar(ids);
+}
+
+// Cada hilo agrega un tramo de ids en su propia tabla hash y luego las
+// tablas se unen. Para los cuantiles se hace una segunda pasada que copia
+// los valores agrupados en un solo arreglo (cada hilo sabe de antemano dónde
+// escribe cada grupo) y se eligen con nth_element, grupo por grupo en paralelo.
+vector<EstadisticaGrupo> ListaReproduccion::agrupar(Agrupacion agrupacion, Medida medida,
+                                                    const vector<double>& cuantiles, size_t hilos) const {
+    for (double q : cuantiles) {
+        if (!(q >= 0 && q <= 1)) {
+            throw invalid_argument("Los cuantiles deben estar entre 0 y 1");
+        }
+    }
+    // Con pocas filas por hilo no compensa crear hilos
+    constexpr size_t MIN_FILAS_POR_HILO = 65536;
+    size_t filas = catalogo.size();
+    hilos = max<size_t>(1, min(hilos == 0 ? hilos_disponibles() : hilos, filas / MIN_FILAS_POR_HILO));
+    auto tramo = [filas, hilos](size_t h) { return filas * h / hilos; };
+
+    vector<TablaGrupos> parciales(hilos);
+    TablaGrupos total;
+    vector<float> agrupados;        // valores de cada grupo, uno tras otro
+    vector<size_t> inicio_grupo;    // por posición en `total`
+    visitar_agrupacion(catalogo, agrupacion, [&](const auto& claves) {
+        visitar_medida(catalogo, medida, [&](const auto& valores) {
+            ejecutar_en_paralelo(hilos, [&](size_t h) {
+                TablaGrupos& tabla = parciales[h];
+                for (size_t id = tramo(h); id < tramo(h + 1); ++id) {
+                    if (catalogo.esta_viva(static_cast<uint32_t>(id))) {
+                        tabla.sumar(static_cast<uint32_t>(claves[id]), static_cast<float>(valores[id]));
+                    }
+                }
+            });
+            for (const auto& parcial : parciales) {
+                total.unir(parcial);
+            }
+            if (cuantiles.empty()) {
+                return;
+            }
+
+            const auto& grupos = total.acumuladores();
+            inicio_grupo.assign(grupos.size() + 1, 0);
+            for (size_t g = 0; g < grupos.size(); ++g) {
+                inicio_grupo[g + 1] = inicio_grupo[g] + grupos[g].cantidad;
+            }
+            // Dónde empieza cada hilo dentro de cada grupo: después de los
+            // hilos anteriores, así el resultado no depende del reparto
+            vector<size_t> siguiente(inicio_grupo.begin(), inicio_grupo.end() - 1);
+            vector<vector<size_t>> escritura(hilos);
+            for (size_t h = 0; h < hilos; ++h) {
+                for (const auto& acumulador : parciales[h].acumuladores()) {
+                    size_t g = total.posicion(acumulador.clave);
+                    escritura[h].push_back(siguiente[g]);
+                    siguiente[g] += acumulador.cantidad;
+                }
+            }
+            agrupados.resize(inicio_grupo.back());
+            ejecutar_en_paralelo(hilos, [&](size_t h) {
+                const TablaGrupos& tabla = parciales[h];
+                for (size_t id = tramo(h); id < tramo(h + 1); ++id) {
+                    if (catalogo.esta_viva(static_cast<uint32_t>(id))) {
+                        size_t local = tabla.posicion(static_cast<uint32_t>(claves[id]));
+                        agrupados[escritura[h][local]++] = static_cast<float>(valores[id]);
+                    }
+                }
+            });
+        });
+    });
+
+    const auto& grupos = total.acumuladores();
+    vector<vector<float>> cuantiles_grupo(cuantiles.empty() ? 0 : grupos.size());
+    // Cuantiles: rango más cercano a q * (n - 1), pedidos de menor a mayor
+    // para que cada nth_element trabaje sobre lo que dejó el anterior
+    vector<size_t> por_q(cuantiles.size());
+    iota(por_q.begin(), por_q.end(), 0);
+    sort(por_q.begin(), por_q.end(), [&](size_t a, size_t b) { return cuantiles[a] < cuantiles[b]; });
+    ejecutar_en_paralelo(cuantiles.empty() ? 0 : hilos, [&](size_t h) {
+        for (size_t g = h; g < grupos.size(); g += hilos) {
+            float* primero = agrupados.data() + inicio_grupo[g];
+            float* ultimo = agrupados.data() + inicio_grupo[g + 1];
+            size_t n = ultimo - primero;
+            cuantiles_grupo[g].resize(cuantiles.size());
+            float* desde = primero;
+            for (size_t i : por_q) {
+                float* elegido = primero + static_cast<size_t>(cuantiles[i] * (n - 1) + 0.5);
+                nth_element(desde, elegido, ultimo);
+                cuantiles_grupo[g][i] = *elegido;
+                desde = elegido;
+            }
+        }
+    });
+
+    auto nombre = [&](uint32_t clave) {
+        return agrupacion == Agrupacion::GENERO ? catalogo.generos.obtener(clave)
+                                                : catalogo.artistas.obtener(clave);
+    };
+    // Se ordena antes de crear las cadenas de los nombres
+    vector<uint32_t> orden(grupos.size());
+    iota(orden.begin(), orden.end(), 0);
+    if (agrupacion == Agrupacion::ANIO) {
+        sort(orden.begin(), orden.end(), [&](uint32_t a, uint32_t b) {
+            return static_cast<int16_t>(grupos[a].clave) < static_cast<int16_t>(grupos[b].clave);
+        });
+    } else {
+        sort(orden.begin(), orden.end(), [&](uint32_t a, uint32_t b) {
+            // Empates por orden de aparición en el catálogo: comparar nombres
+            // costaría más que la agregación con decenas de miles de artistas
+            return grupos[a].cantidad != grupos[b].cantidad ? grupos[a].cantidad > grupos[b].cantidad
+                                                            : grupos[a].clave < grupos[b].clave;
+        });
+    }
+
+    vector<EstadisticaGrupo> resultado(grupos.size());
+    for (size_t i = 0; i < orden.size(); ++i) {
+        const auto& acumulador = grupos[orden[i]];
+        EstadisticaGrupo& estadistica = resultado[i];
+        estadistica.grupo = agrupacion == Agrupacion::ANIO ? to_string(static_cast<int16_t>(acumulador.clave))
+                                                           : string(nombre(acumulador.clave));
+        estadistica.cantidad = acumulador.cantidad;
+        estadistica.suma = acumulador.suma;
+        estadistica.media = acumulador.suma / acumulador.cantidad;
+        estadistica.minimo = acumulador.minimo;
+        estadistica.maximo = acumulador.maximo;
+        if (!cuantiles.empty()) {
+            estadistica.cuantiles = move(cuantiles_grupo[orden[i]]);
+        }
+    }
+    return resultado;
+}
+
+// Acepta "2010" o "2010-2015"
+bool leer_rango_anios(const string& entrada, int& desde, int& hasta) {
+    size_t guion = entrada.find('-', 1);
+    string_view texto_desde = string_view(entrada).substr(0, guion);
+    string_view texto_hasta = guion == string::npos ? texto_desde : string_view(entrada).substr(guion + 1);
+    return leer_numero(texto_desde, desde) && leer_numero(texto_hasta, hasta) && desde <= hasta;
+}
+
+// Acepta "-" (cualquiera) o una lista separada por comas, como "techno,house"
+vector<string> leer_lista(const string& entrada) {
+    vector<string> valores;
+    if (entrada == "-") {
+        return valores;
+    }
+    stringstream partes(entrada);
+    string valor;
+    while (getline(partes, valor, ',')) {
+        if (!valor.empty()) {
+            valores.push_back(valor);
+        }
+    }
+    return valores;
+}
+
+bool leer_lista_numeros(const string& entrada, vector<int>& numeros) {
+    numeros.clear();
+    for (const string& valor : leer_lista(entrada)) {
+        int numero;
+        if (!leer_numero(valor, numero)) {
             return false;
         }
-        
-        // Si hay múltiples canciones, mostrar opciones
-        if (canciones.size() > 1) {
-            cout << "Se encontraron múltiples canciones:\n";
-            for (size_t i = 0; i < canciones.size(); ++i) {
-                cout << i + 1 << ". " 
-                     << canciones[i].track_name 
-                     << " - " << canciones[i].artist_name 
-                     << " (ID: " << canciones[i].track_id << ")\n";
+        numeros.push_back(numero);
+    }
+    return true;
+}
+
+size_t mostrar_menu_navegacion(size_t pagina, size_t total_paginas, bool& navegando) {
+    cout << "\nOpciones:\n";
+    cout << "1. Página siguiente\n";
+    cout << "2. Página anterior\n";
+    cout << "3. Ir a página específica\n";
+    cout << "4. Salir\n";
+
+    int opcion;
+    cin >> opcion;
+
+    switch (opcion) {
+        case 1:
+            return min(pagina + 1, total_paginas);
+        case 2:
+            return max(pagina - 1, static_cast<size_t>(1));
+        case 3:
+            cout << "Ingrese el número de página (1-" << total_paginas << "): ";
+            cin >> pagina;
+            return min(max(pagina, static_cast<size_t>(1)), total_paginas);
+        case 4:
+            navegando = false;
+            return pagina;
+        default:
+            return pagina;
+    }
+}
+
+// Modo servidor: comandos de una línea, con los campos separados por
+// tabuladores, y una respuesta JSON de una línea por comando, en el mismo
+// orden. Así un cliente puede enviar muchos comandos seguidos sin esperar
+// cada respuesta.
+//   load <archivo.csv>                      agrega las canciones del CSV
+//   add <fila CSV>                          misma forma que las filas del CSV
+//   remove <track_id>
+//   move <track_id> <posición>              posición en la cola, desde 0
+//   prefix <nombre|artista> <prefijo> [k]   las k más populares (10 por omisión)
+//   similar <track_id> [k]                  las k más parecidas por rasgos de audio
+//   vecinos                                 arma el grafo de vecinos (una sola vez)
+//   radio <track_id> [k] [ef]               como similar, con el grafo de vecinos
+//   page <orden> [página] [por página] [asc|desc|años]
+//        orden: nombre, popularidad, duracion, cola o anios (años: 2015-2020)
+//   filter [página] [por página] [condición]...
+//        condición: genero=a,b  anios=2015-2020  tonalidad=0,5  modo=1
+//                   compas=4  <rasgo>=mínimo:máximo (por ejemplo tempo=120:130)
+//   stats
+// Las respuestas son {"ok":true,...} o {"ok":false,"error":"..."}.
+
+// Mientras existe, lo que se escribe en `flujo` va a `destino` (nullptr lo
+// descarta); al destruirse, aunque sea por una excepción, lo devuelve a su lugar
+class DesvioSalida {
+public:
+    DesvioSalida(ostream& flujo, streambuf* destino) : flujo(flujo), original(flujo.rdbuf(destino)) {}
+    DesvioSalida(const DesvioSalida&) = delete;
+    DesvioSalida& operator=(const DesvioSalida&) = delete;
+
+    ~DesvioSalida() {
+        flujo.rdbuf(original);
+        flujo.clear();
+    }
+
+private:
+    ostream& flujo;
+    streambuf* original;
+};
+
+// Agrega `texto` a `salida` como cadena JSON
+void escribir_json_texto(string& salida, string_view texto) {
+    salida += '"';
+    for (char c : texto) {
+        if (c == '"' || c == '\\') {
+            salida += '\\';
+            salida += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+            salida += escape;
+        } else {
+            salida += c;
+        }
+    }
+    salida += '"';
+}
+
+void escribir_json_cancion(string& salida, const Cancion& cancion) {
+    salida += "{\"track_id\":";
+    escribir_json_texto(salida, cancion.track_id);
+    salida += ",\"track_name\":";
+    escribir_json_texto(salida, cancion.track_name);
+    salida += ",\"artist_name\":";
+    escribir_json_texto(salida, cancion.artist_name);
+    salida += ",\"genre\":";
+    escribir_json_texto(salida, cancion.genre);
+    salida += ",\"anio\":" + to_string(cancion.anio);
+    salida += ",\"popularity\":" + to_string(cancion.popularity);
+    salida += ",\"duration_ms\":" + to_string(cancion.duration_ms) + "}";
+}
+
+// Atiende los comandos de una conexión (o de la entrada estándar) hasta que
+// se cierra. Lee por bloques: las altas, bajas y movimientos seguidos de un
+// mismo bloque se publican juntos en un solo lote, y las respuestas se
+// escriben en un búfer que se vacía al terminar cada bloque.
+class SesionComandos {
+public:
+    SesionComandos(ListaConcurrente& lista, int entrada, int salida)
+        : lista(lista), entrada(entrada), salida(salida) {}
+
+    void atender() {
+        string pendiente;
+        vector<char> bloque(1 << 16);
+        size_t leidos;
+        while ((leidos = leer_bloque(bloque.data(), bloque.size())) > 0) {
+            pendiente.append(bloque.data(), leidos);
+            size_t inicio = 0;
+            size_t salto;
+            while ((salto = pendiente.find('\n', inicio)) != string::npos) {
+                procesar(string_view(pendiente).substr(inicio, salto - inicio));
+                inicio = salto + 1;
+            }
+            pendiente.erase(0, inicio);
+            publicar_cambios();
+            if (!vaciar()) {
+                return;
+            }
+        }
+        if (!pendiente.empty()) {
+            procesar(pendiente);
+        }
+        publicar_cambios();
+        vaciar();
+    }
+
+private:
+    ListaConcurrente& lista;
+    int entrada;
+    int salida;
+    string respuestas;
+    vector<ListaConcurrente::Cambio> cambios;  // aún sin publicar, en orden
+
+    size_t leer_bloque(char* destino, size_t capacidad) {
+#if defined(__unix__) || defined(__APPLE__)
+        ssize_t leidos;
+        do {
+            leidos = ::read(entrada, destino, capacidad);
+        } while (leidos < 0 && errno == EINTR);
+        return leidos > 0 ? static_cast<size_t>(leidos) : 0;
+#else
+        // Sin read() se atiende línea por línea
+        if (!fgets(destino, static_cast<int>(capacidad), stdin)) {
+            return 0;
+        }
+        return strlen(destino);
+#endif
+    }
+
+    // Devuelve false si la otra punta cerró la conexión
+    bool vaciar() {
+#if defined(__unix__) || defined(__APPLE__)
+        size_t escritos = 0;
+        while (escritos < respuestas.size()) {
+            ssize_t n = ::write(salida, respuestas.data() + escritos, respuestas.size() - escritos);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            escritos += static_cast<size_t>(n);
+        }
+#else
+        fwrite(respuestas.data(), 1, respuestas.size(), stdout);
+        fflush(stdout);
+#endif
+        respuestas.clear();
+        return true;
+    }
+
+    void error(const string& mensaje) {
+        respuestas += "{\"ok\":false,\"error\":";
+        escribir_json_texto(respuestas, mensaje);
+        respuestas += "}\n";
+    }
+
+    void publicar_cambios() {
+        if (cambios.empty()) {
+            return;
+        }
+        vector<bool> aplicados;
+        try {
+            aplicados = lista.publicar(cambios);
+        } catch (const exception& e) {
+            // No se publicó ningún cambio del lote
+            for (size_t i = 0; i < cambios.size(); ++i) {
+                error(e.what());
+            }
+            cambios.clear();
+            return;
+        }
+        for (size_t i = 0; i < cambios.size(); ++i) {
+            if (aplicados[i]) {
+                respuestas += "{\"ok\":true}\n";
+            } else if (cambios[i].tipo == ListaConcurrente::Cambio::Tipo::AGREGAR) {
+                error("La canción ya está en la lista");
+            } else if (cambios[i].tipo == ListaConcurrente::Cambio::Tipo::ELIMINAR) {
+                error("Canción no encontrada");
+            } else {
+                error("Canción no encontrada o posición inválida");
+            }
+        }
+        cambios.clear();
+    }
+
+    void procesar(string_view linea) {
+        if (!linea.empty() && linea.back() == '\r') {
+            linea.remove_suffix(1);
+        }
+        vector<string> campos;
+        size_t inicio = 0;
+        while (true) {
+            size_t tab = linea.find('\t', inicio);
+            campos.emplace_back(linea.substr(inicio, tab == string_view::npos ? string_view::npos : tab - inicio));
+            if (tab == string_view::npos) {
+                break;
+            }
+            inicio = tab + 1;
+        }
+        const string& comando = campos[0];
+        if (comando.empty()) {
+            return;
+        }
+
+        // Las modificaciones se acumulan; todo lo demás ve antes las anteriores
+        if (comando == "add" || comando == "remove" || comando == "move") {
+            agregar_cambio(comando, campos);
+            return;
+        }
+        publicar_cambios();
+        try {
+            if (comando == "load" && campos.size() == 2) {
+                lista.cargar_catalogo(cargar_csv_paralelo(campos[1]));
+                respuestas += "{\"ok\":true,\"canciones\":" + to_string(lista.leer()->total_canciones) + "}\n";
+            } else if (comando == "prefix") {
+                buscar_prefijo(campos);
+            } else if (comando == "similar") {
+                buscar_similares(campos);
+            } else if (comando == "vecinos" && campos.size() == 1) {
+                lista.construir_indice_vecinos();
+                respuestas += "{\"ok\":true}\n";
+            } else if (comando == "radio") {
+                buscar_radio(campos);
+            } else if (comando == "page") {
+                paginar(campos);
+            } else if (comando == "filter") {
+                filtrar(campos);
+            } else if (comando == "stats") {
+                auto lectura = lista.leer();
+                respuestas += "{\"ok\":true,\"canciones\":" + to_string(lectura->total_canciones) +
+                              ",\"version\":" + to_string(lectura.version()) + "}\n";
+            } else {
+                error("Comando desconocido o argumentos de más o de menos: " + comando);
+            }
+        } catch (const exception& e) {
+            error(e.what());
+        }
+    }
+
+    void agregar_cambio(const string& comando, const vector<string>& campos) {
+        if (comando == "add" && campos.size() == 2) {
+            optional<Cancion> cancion;
+            recorrer_filas_csv(campos[1].data(), campos[1].data() + campos[1].size(),
+                [&cancion](const string_view* valores, size_t num_valores) {
+                    FilaCancion fila;
+                    if (convertir_fila(valores, num_valores, fila)) {
+                        cancion = Cancion(string(fila.artist_name), string(fila.track_name),
+                            string(fila.track_id), fila.popularity, fila.anio, string(fila.genre),
+                            fila.danceability, fila.energy, fila.key, fila.loudness, fila.mode,
+                            fila.speechiness, fila.acousticness, fila.instrumentalness,
+                            fila.liveness, fila.valence, fila.tempo, fila.duration_ms, fila.time_signature);
+                    }
+                });
+            if (!cancion) {
+                publicar_cambios();
+                error("Fila CSV inválida");
+                return;
+            }
+            cambios.push_back(ListaConcurrente::Cambio::agregar(*cancion));
+        } else if (comando == "remove" && campos.size() == 2) {
+            cambios.push_back(ListaConcurrente::Cambio::eliminar(campos[1]));
+        } else if (comando == "move" && campos.size() == 3) {
+            size_t posicion;
+            if (!leer_numero(campos[2], posicion)) {
+                publicar_cambios();
+                error("Posición inválida");
+                return;
+            }
+            cambios.push_back(ListaConcurrente::Cambio::mover(campos[1], posicion));
+        } else {
+            publicar_cambios();
+            error("Argumentos de más o de menos: " + comando);
+        }
+    }
+
+    // Lee el campo `indice` como número, o deja `valor` si no está
+    static void leer_opcional(const vector<string>& campos, size_t indice, size_t& valor) {
+        if (indice < campos.size() && (!leer_numero(campos[indice], valor) || valor == 0)) {
+            throw runtime_error("Número inválido: " + campos[indice]);
+        }
+    }
+
+    void buscar_prefijo(const vector<string>& campos) {
+        if (campos.size() < 3 || campos.size() > 4 || (campos[1] != "nombre" && campos[1] != "artista")) {
+            throw runtime_error("Uso: prefix <nombre|artista> <prefijo> [k]");
+        }
+        size_t k = 10;
+        leer_opcional(campos, 3, k);
+        auto lectura = lista.leer();
+        responder_canciones(lectura->buscar_top_k(campos[2], k, campos[1] == "artista"));
+    }
+
+    // Un hilo por consulta: las sesiones ya se atienden en paralelo
+    void buscar_similares(const vector<string>& campos) {
+        if (campos.size() < 2 || campos.size() > 3) {
+            throw runtime_error("Uso: similar <track_id> [k]");
+        }
+        size_t k = 10;
+        leer_opcional(campos, 2, k);
+        auto lectura = lista.leer();
+        responder_canciones(lectura->buscar_similares(campos[1], k, MatrizRasgos::pesos_iguales(), 1));
+    }
+
+    void buscar_radio(const vector<string>& campos) {
+        if (campos.size() < 2 || campos.size() > 4) {
+            throw runtime_error("Uso: radio <track_id> [k] [ef]");
+        }
+        size_t k = 10;
+        size_t ef = 0;
+        leer_opcional(campos, 2, k);
+        leer_opcional(campos, 3, ef);
+        auto lectura = lista.leer();
+        responder_canciones(lectura->buscar_similares_aproximado(campos[1], k, ef));
+    }
+
+    void paginar(const vector<string>& campos) {
+        if (campos.size() < 2 || campos.size() > 5) {
+            throw runtime_error("Uso: page <orden> [página] [por página] [asc|desc|años]");
+        }
+        size_t pagina = 1;
+        size_t por_pagina = 200;
+        leer_opcional(campos, 2, pagina);
+        leer_opcional(campos, 3, por_pagina);
+        string extra = campos.size() > 4 ? campos[4] : "";
+        bool ascendente = extra != "desc";
+        if (extra != "" && extra != "asc" && extra != "desc" && campos[1] != "anios") {
+            throw runtime_error("Sentido inválido: " + extra);
+        }
+
+        auto lectura = lista.leer();
+        const string& orden = campos[1];
+        if (orden == "nombre") {
+            responder_pagina(lectura->listar_canciones_paginado(pagina, por_pagina));
+        } else if (orden == "popularidad") {
+            responder_pagina(lectura->listar_por_popularidad_paginado(ascendente, pagina, por_pagina));
+        } else if (orden == "duracion") {
+            responder_pagina(lectura->listar_por_duracion_paginado(ascendente, pagina, por_pagina));
+        } else if (orden == "cola") {
+            responder_pagina(lectura->listar_cola_paginado(pagina, por_pagina));
+        } else if (orden == "anios") {
+            int desde;
+            int hasta;
+            if (!leer_rango_anios(extra, desde, hasta)) {
+                throw runtime_error("Año inválido: " + extra);
+            }
+            responder_pagina(lectura->obtener_por_anios_paginado(desde, hasta, pagina, por_pagina));
+        } else {
+            throw runtime_error("Orden desconocido: " + orden);
+        }
+    }
+
+    void filtrar(const vector<string>& campos) {
+        size_t pagina = 1;
+        size_t por_pagina = 200;
+        leer_opcional(campos, 1, pagina);
+        leer_opcional(campos, 2, por_pagina);
+        FiltroCanciones filtro;
+        for (size_t i = 3; i < campos.size(); ++i) {
+            size_t igual = campos[i].find('=');
+            string clave = campos[i].substr(0, igual);
+            string valor = igual == string::npos ? "" : campos[i].substr(igual + 1);
+            bool valido = igual != string::npos;
+            if (clave == "genero") {
+                filtro.generos = leer_lista(valor);
+            } else if (clave == "anios") {
+                valido = valido && leer_rango_anios(valor, filtro.anio_desde, filtro.anio_hasta);
+            } else if (clave == "tonalidad") {
+                valido = valido && leer_lista_numeros(valor, filtro.tonalidades);
+            } else if (clave == "modo") {
+                valido = valido && leer_lista_numeros(valor, filtro.modos);
+            } else if (clave == "compas") {
+                valido = valido && leer_lista_numeros(valor, filtro.compases);
+            } else {
+                size_t rasgo = 0;
+                while (rasgo < MatrizRasgos::NUM_RASGOS && clave != MatrizRasgos::nombre_rasgo(rasgo)) {
+                    rasgo++;
+                }
+                size_t separador = valor.find(':');
+                FiltroCanciones::RangoRasgo rango{rasgo, 0, 0};
+                valido = valido && rasgo < MatrizRasgos::NUM_RASGOS && separador != string::npos &&
+                         leer_numero(string_view(valor).substr(0, separador), rango.minimo) &&
+                         leer_numero(string_view(valor).substr(separador + 1), rango.maximo);
+                filtro.rasgos.push_back(rango);
+            }
+            if (!valido) {
+                throw runtime_error("Condición inválida: " + campos[i]);
+            }
+        }
+        auto lectura = lista.leer();
+        CursorFiltro cursor = lectura->filtrar(filtro);
+        responder_pagina(lectura->filtrar_paginado(cursor, pagina, por_pagina));
+    }
+
+    void responder_canciones(const vector<Cancion>& canciones) {
+        respuestas += "{\"ok\":true,\"canciones\":[";
+        for (size_t i = 0; i < canciones.size(); ++i) {
+            if (i > 0) {
+                respuestas += ',';
+            }
+            escribir_json_cancion(respuestas, canciones[i]);
+        }
+        respuestas += "]}\n";
+    }
+
+    void responder_pagina(const ListaReproduccion::Pagina& pagina) {
+        respuestas += "{\"ok\":true,\"total\":" + to_string(pagina.total_canciones) +
+                      ",\"pagina\":" + to_string(pagina.pagina_actual) +
+                      ",\"paginas\":" + to_string(pagina.total_paginas) + ",\"canciones\":[";
+        for (size_t i = 0; i < pagina.canciones.size(); ++i) {
+            if (i > 0) {
+                respuestas += ',';
+            }
+            escribir_json_cancion(respuestas, pagina.canciones[i]);
+        }
+        respuestas += "]}\n";
+    }
+};
+
+// Atiende comandos por la entrada estándar y responde por la salida estándar
+void servir_entrada_estandar(ListaConcurrente& lista) {
+    SesionComandos(lista, 0, 1).atender();
+}
+
+// Atiende comandos por un socket Unix en `ruta`, con un hilo por conexión;
+// todas comparten la misma lista. No vuelve salvo por un error, y antes de
+// lanzarlo cierra las conexiones abiertas y espera sus hilos, que usan `lista`.
+void servir_socket(ListaConcurrente& lista, const string& ruta) {
+#if defined(__unix__) || defined(__APPLE__)
+    sockaddr_un direccion{};
+    if (ruta.size() >= sizeof(direccion.sun_path)) {
+        throw runtime_error("Ruta de socket demasiado larga: " + ruta);
+    }
+    direccion.sun_family = AF_UNIX;
+    strcpy(direccion.sun_path, ruta.c_str());
+
+    // Solo se borra el socket que dejó una ejecución anterior; cualquier otro
+    // archivo en esa ruta se respeta
+    struct stat existente;
+    if (::lstat(ruta.c_str(), &existente) == 0) {
+        if (!S_ISSOCK(existente.st_mode)) {
+            throw runtime_error("La ruta existe y no es un socket: " + ruta);
+        }
+        ::unlink(ruta.c_str());
+    }
+
+    int servidor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (servidor < 0) {
+        throw runtime_error("No se pudo crear el socket: " + string(strerror(errno)));
+    }
+    if (::bind(servidor, reinterpret_cast<sockaddr*>(&direccion), sizeof(direccion)) < 0 ||
+        ::listen(servidor, SOMAXCONN) < 0) {
+        int codigo = errno;
+        ::close(servidor);
+        throw runtime_error("No se pudo escuchar en " + ruta + ": " + strerror(codigo));
+    }
+    // Un cliente que se va antes de leer sus respuestas no debe terminar el proceso
+    signal(SIGPIPE, SIG_IGN);
+    cerr << "Escuchando en " << ruta << '\n';
+
+    // El descriptor se cierra recién después de unir el hilo, para que
+    // shutdown nunca alcance a un descriptor ya reutilizado
+    struct Conexion {
+        int descriptor;
+        atomic<bool> terminada{false};
+        thread hilo;
+    };
+    list<Conexion> conexiones;
+    auto unir = [](Conexion& conexion) {
+        conexion.hilo.join();
+        ::close(conexion.descriptor);
+    };
+    while (true) {
+        int descriptor = ::accept(servidor, nullptr, nullptr);
+        if (descriptor < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int codigo = errno;
+            for (Conexion& conexion : conexiones) {
+                ::shutdown(conexion.descriptor, SHUT_RDWR);
+            }
+            for (Conexion& conexion : conexiones) {
+                unir(conexion);
+            }
+            ::close(servidor);
+            throw runtime_error("Error al aceptar conexiones: " + string(strerror(codigo)));
+        }
+        // Se recogen los hilos de las conexiones que ya terminaron
+        for (auto it = conexiones.begin(); it != conexiones.end();) {
+            if (it->terminada.load()) {
+                unir(*it);
+                it = conexiones.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        Conexion& conexion = conexiones.emplace_back();
+        conexion.descriptor = descriptor;
+        conexion.hilo = thread([&lista, &conexion]() {
+            SesionComandos(lista, conexion.descriptor, conexion.descriptor).atender();
+            conexion.terminada = true;
+        });
+    }
+#else
+    (void)lista;
+    throw runtime_error("Los sockets Unix no están disponibles en este sistema: " + ruta);
+#endif
+}
+
+// Carga `file_path` si se indica y atiende comandos por la entrada estándar
+// o, si `ruta_socket` no está vacía, por ese socket Unix. Los mensajes de la
+// carga van a la salida de errores para no mezclarse con las respuestas.
+void ejecutar_servidor(const string& file_path, const string& ruta_socket) {
+    DesvioSalida desvio(cout, cerr.rdbuf());
+    ListaConcurrente lista;
+    if (!file_path.empty()) {
+        lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    }
+    if (ruta_socket.empty()) {
+        servir_entrada_estandar(lista);
+    } else {
+        servir_socket(lista, ruta_socket);
+    }
+}
+
+// Compara la carga canción por canción con la carga masiva ascendente
+void benchmark_carga_masiva(const string& file_path) {
+    auto canciones = cargar_csv(file_path);
+
+    auto inicio = chrono::high_resolution_clock::now();
+    {
+        ListaReproduccion lista;
+        for (auto& cancion : canciones) {
+            lista.agregar_cancion(cancion);
+        }
+    }
+    auto fin = chrono::high_resolution_clock::now();
+    auto ms_insercion = chrono::duration_cast<chrono::milliseconds>(fin - inicio).count();
+
+    inicio = chrono::high_resolution_clock::now();
+    {
+        ListaReproduccion lista;
+        lista.cargar_masivo(vector<Cancion>(canciones));
+    }
+    fin = chrono::high_resolution_clock::now();
+    auto ms_masiva = chrono::duration_cast<chrono::milliseconds>(fin - inicio).count();
+
+    cout << "Canciones: " << canciones.size() << "\n";
+    cout << "Inserción una por una: " << ms_insercion << " ms\n";
+    cout << "Carga masiva: " << ms_masiva << " ms\n";
+    if (ms_masiva > 0) {
+        cout << "Aceleración: " << fixed << setprecision(2)
+             << static_cast<double>(ms_insercion) / ms_masiva << "x\n";
+    }
+}
+
+// Velocidad de lectura del CSV: cargar_csv frente a cargar_csv_mapeado
+void benchmark_ingesta(const string& file_path) {
+    auto inicio = chrono::high_resolution_clock::now();
+    size_t filas_getline = cargar_csv(file_path).size();
+    auto fin = chrono::high_resolution_clock::now();
+    double ms_getline = chrono::duration<double, milli>(fin - inicio).count();
+
+    EstadisticasCarga estadisticas;
+    inicio = chrono::high_resolution_clock::now();
+    size_t filas_mapeado = cargar_csv_mapeado(file_path, &estadisticas).total_vivas();
+    fin = chrono::high_resolution_clock::now();
+    double ms_mapeado = chrono::duration<double, milli>(fin - inicio).count();
+
+    double megabytes = estadisticas.bytes / (1024.0 * 1024.0);
+    cout << fixed << setprecision(1);
+    cout << "Archivo: " << megabytes << " MB\n";
+    cout << "cargar_csv:         " << filas_getline << " filas, " << ms_getline << " ms, "
+         << megabytes / (ms_getline / 1000.0) << " MB/s\n";
+    cout << "cargar_csv_mapeado: " << filas_mapeado << " filas, " << ms_mapeado << " ms, "
+         << megabytes / (ms_mapeado / 1000.0) << " MB/s"
+         << " (inválidas: " << estadisticas.filas_invalidas
+         << ", repetidas: " << estadisticas.filas_repetidas << ")\n";
+
+    // Escalado de la carga paralela según la cantidad de hilos
+    size_t max_hilos = max<size_t>(8, hilos_disponibles());
+    for (size_t hilos = 1; hilos <= max_hilos; hilos *= 2) {
+        inicio = chrono::high_resolution_clock::now();
+        size_t filas = cargar_csv_paralelo(file_path, hilos).total_vivas();
+        fin = chrono::high_resolution_clock::now();
+        double ms = chrono::duration<double, milli>(fin - inicio).count();
+        cout << "cargar_csv_paralelo (" << hilos << " hilos): " << filas << " filas, "
+             << ms << " ms, " << megabytes / (ms / 1000.0) << " MB/s, aceleración "
+             << ms_mapeado / ms << "x\n";
+    }
+}
+
+// Tiempo de inicio leyendo el CSV frente a abrir la instantánea binaria
+void benchmark_instantanea(const string& file_path) {
+    string ruta_instantanea = file_path + ".snap";
+    error_code error;
+    filesystem::remove(ruta_instantanea, error);
+
+    // Solo se mide la carga; la destrucción de la lista queda fuera
+    auto medir = [&file_path](size_t& total) {
+        ListaReproduccion lista;
+        auto inicio = chrono::high_resolution_clock::now();
+        cargar_canciones(lista, file_path);
+        auto fin = chrono::high_resolution_clock::now();
+        total = lista.total_canciones;
+        return chrono::duration<double, milli>(fin - inicio).count();
+    };
+    size_t total = 0;
+    double ms_csv = medir(total);
+    double ms_instantanea = medir(total);
+
+    cout << fixed << setprecision(1);
+    cout << "CSV + índices + guardar instantánea: " << ms_csv << " ms\n";
+    cout << "Abrir instantánea (" << total << " canciones): " << ms_instantanea << " ms\n";
+}
+
+// Mide memoria y tiempo de búsqueda por prefijo de los tries de la lista.
+// Los prefijos se toman de los propios nombres (1 a 4 caracteres).
+void benchmark_trie(const string& file_path) {
+    ListaReproduccion lista;
+    auto inicio = chrono::high_resolution_clock::now();
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    auto fin = chrono::high_resolution_clock::now();
+
+    vector<string> prefijos;
+    for (uint32_t id = 0; id < lista.catalogo.size() && prefijos.size() < 2000; id += 97) {
+        string_view nombre = lista.catalogo.track_name(id);
+        prefijos.emplace_back(nombre.substr(0, 1 + id % 4));
+    }
+    size_t encontrados = 0;
+    auto inicio_busqueda = chrono::high_resolution_clock::now();
+    for (const string& prefijo : prefijos) {
+        encontrados += lista.trie_canciones.buscar_prefijo(prefijo).size();
+        encontrados += lista.trie_artistas.buscar_prefijo(prefijo).size();
+    }
+    auto fin_busqueda = chrono::high_resolution_clock::now();
+    for (const string& prefijo : prefijos) {
+        lista.trie_canciones.buscar_top_k(prefijo, 10);
+        lista.trie_artistas.buscar_top_k(prefijo, 10);
+    }
+    auto fin_top_k = chrono::high_resolution_clock::now();
+
+    cout << fixed << setprecision(1);
+    cout << "Índices construidos en " << chrono::duration<double, milli>(fin - inicio).count() << " ms\n";
+    cout << "Tries: " << lista.trie_artistas.total_nodos() + lista.trie_canciones.total_nodos()
+         << " nodos, " << (lista.trie_artistas.memoria() + lista.trie_canciones.memoria()) / 1048576.0
+         << " MB\n";
+    cout << "Búsqueda por prefijo: "
+         << chrono::duration<double, micro>(fin_busqueda - inicio_busqueda).count() / (2 * prefijos.size())
+         << " us por consulta (" << encontrados << " resultados)\n";
+    cout << "Las 10 más populares por prefijo: "
+         << chrono::duration<double, micro>(fin_top_k - fin_busqueda).count() / (2 * prefijos.size())
+         << " us por consulta\n";
+}
+
+// Árbol por nombre con distintas capacidades de nodo: inserción una a una (en
+// el orden del archivo), búsqueda de cada canción, recorrido completo de las
+// hojas, reservas pedidas al sistema y tiempo de destrucción. Luego, altas y bajas continuas con la capacidad de la lista: en cada
+// ronda se elimina el 90% de las canciones al azar y se vuelven a insertar.
+// Con el rebalanceo la altura y el número de hojas siguen al tamaño del árbol.
+void benchmark_arbol(const string& file_path) {
+    CatalogoColumnar catalogo = cargar_csv_paralelo(file_path);
+    vector<uint32_t> ids;
+    for (uint32_t id = 0; id < catalogo.size(); ++id) {
+        if (catalogo.esta_viva(id)) {
+            ids.push_back(id);
+        }
+    }
+
+    cout << fixed << setprecision(1);
+    for (int capacidad : {3, 8, 16, CLAVES_POR_NODO, 64}) {
+        auto prueba = make_unique<BTree>(capacidad, catalogo);
+        auto inicio = chrono::high_resolution_clock::now();
+        for (uint32_t id : ids) {
+            prueba->insertar(id);
+        }
+        auto fin_insercion = chrono::high_resolution_clock::now();
+        size_t encontrados = 0;
+        for (uint32_t id : ids) {
+            encontrados += prueba->contiene(id);
+        }
+        auto fin_busqueda = chrono::high_resolution_clock::now();
+        size_t recorridos = prueba->listar().size();
+        auto fin_recorrido = chrono::high_resolution_clock::now();
+        size_t altura = prueba->altura();
+        EstadisticasMemoria memoria = prueba->estadisticas_memoria();
+        double megabytes = prueba->memoria() / 1048576.0;
+        prueba.reset();
+        auto fin_destruccion = chrono::high_resolution_clock::now();
+        cout << "Capacidad " << capacidad << ": altura " << altura << ", inserción "
+             << chrono::duration<double, nano>(fin_insercion - inicio).count() / ids.size() << " ns, búsqueda "
+             << chrono::duration<double, nano>(fin_busqueda - fin_insercion).count() / ids.size()
+             << " ns, recorrido " << chrono::duration<double, milli>(fin_recorrido - fin_busqueda).count()
+             << " ms (" << encontrados << " encontradas, " << recorridos << " recorridas)\n";
+        cout << "             " << memoria.nodos_creados << " nodos en " << memoria.bloques
+             << " reservas al sistema (" << megabytes << " MB), destrucción "
+             << chrono::duration<double, milli>(fin_destruccion - fin_recorrido).count() << " ms\n";
+    }
+
+    BTree arbol(CLAVES_POR_NODO, catalogo);
+    for (uint32_t id : ids) {
+        arbol.insertar(id);
+    }
+
+    auto contar_hojas = [&arbol]() {
+        const Nodo* nodo = arbol.raiz;
+        while (!nodo->es_hoja) {
+            nodo = nodo->hijos[0];
+        }
+        size_t hojas = 0;
+        for (; nodo; nodo = nodo->siguiente) {
+            hojas++;
+        }
+        return hojas;
+    };
+    auto medir_busqueda = [&arbol, &ids]() {
+        size_t encontrados = 0;
+        auto inicio = chrono::high_resolution_clock::now();
+        for (uint32_t id : ids) {
+            encontrados += arbol.contiene(id);
+        }
+        auto fin = chrono::high_resolution_clock::now();
+        return make_pair(encontrados, chrono::duration<double, nano>(fin - inicio).count() / ids.size());
+    };
+
+    mt19937 generador(42);
+    size_t quedan = ids.size() / 10;
+    for (int ronda = 1; ronda <= 5; ++ronda) {
+        shuffle(ids.begin(), ids.end(), generador);
+        auto inicio = chrono::high_resolution_clock::now();
+        for (size_t i = quedan; i < ids.size(); ++i) {
+            arbol.eliminar(ids[i]);
+        }
+        auto fin = chrono::high_resolution_clock::now();
+        auto [encontrados, ns] = medir_busqueda();
+        cout << "Ronda " << ronda << ": tras eliminar " << ids.size() - quedan << " en "
+             << chrono::duration<double, milli>(fin - inicio).count() << " ms -> " << arbol.size()
+             << " canciones, altura " << arbol.altura() << ", " << contar_hojas() << " hojas, búsqueda "
+             << ns << " ns (" << encontrados << " encontradas)\n";
+
+        for (size_t i = quedan; i < ids.size(); ++i) {
+            arbol.insertar(ids[i]);
+        }
+        cout << "         tras reinsertar: " << arbol.size() << " canciones, altura " << arbol.altura()
+             << ", " << contar_hojas() << " hojas\n";
+    }
+    const EstadisticasMemoria& memoria = arbol.estadisticas_memoria();
+    cout << "Nodos: " << memoria.nodos_creados << " tomados de la arena, " << memoria.nodos_reutilizados
+         << " reutilizados, " << memoria.bloques << " reservas al sistema\n";
+}
+
+// Modo --pruebas: compara las estructuras con versiones ingenuas (vectores
+// ordenados, recorridos completos) sobre datos generados al azar con semilla
+// fija. Cada diferencia se informa por cerr; el programa termina con 1 si hubo
+// alguna.
+class Comprobaciones {
+public:
+    void verificar(bool condicion, const string& descripcion) {
+        realizadas++;
+        if (!condicion) {
+            fallidas++;
+            cerr << "FALLA: " << descripcion << '\n';
+        }
+    }
+
+    size_t fallas() const {
+        return fallidas;
+    }
+
+    void informar(const string& seccion) {
+        cout << seccion << ": " << realizadas - realizadas_informadas << " comprobaciones, "
+             << fallidas - fallidas_informadas << " fallas\n";
+        realizadas_informadas = realizadas;
+        fallidas_informadas = fallidas;
+    }
+
+private:
+    size_t realizadas = 0;
+    size_t fallidas = 0;
+    size_t realizadas_informadas = 0;
+    size_t fallidas_informadas = 0;
+};
+
+// Nombres de pocas letras para que abunden los prefijos comunes y las repeticiones
+string nombre_de_prueba(mt19937& generador, size_t largo_maximo) {
+    static const char letras[] = "aabbcA ";
+    string nombre(1 + generador() % largo_maximo, 'a');
+    for (char& c : nombre) {
+        c = letras[generador() % (sizeof(letras) - 1)];
+    }
+    return nombre;
+}
+
+// Catálogo de `cantidad` canciones con nombres cortos repetidos
+CatalogoColumnar catalogo_de_prueba(size_t cantidad, mt19937& generador) {
+    CatalogoColumnar catalogo;
+    vector<string> textos;
+    for (size_t i = 0; i < cantidad; ++i) {
+        string nombre = nombre_de_prueba(generador, 12);
+        string track_id = "id" + to_string(i);
+        FilaCancion fila;
+        fila.artist_name = "artista";
+        fila.track_name = nombre;
+        fila.track_id = track_id;
+        fila.genre = "pop";
+        fila.popularity = static_cast<int>(generador() % 101);
+        fila.anio = 2000 + static_cast<int>(generador() % 24);
+        fila.duration_ms = static_cast<int>(generador() % 400000);
+        catalogo.agregar(fila);
+    }
+    return catalogo;
+}
+
+// Árbol B+ frente a un vector ordenado con el mismo criterio: altas y bajas
+// al azar, con capacidades chicas para que haya muchos préstamos y fusiones
+void probar_arbol(Comprobaciones& pruebas) {
+    mt19937 generador(7);
+    CatalogoColumnar catalogo = catalogo_de_prueba(3000, generador);
+
+    for (int capacidad : {3, 4, 5, 8, 32}) {
+        BTree arbol(capacidad, catalogo);
+        vector<uint32_t> referencia;
+        auto antes = [&arbol](uint32_t a, uint32_t b) { return arbol.antes(a, b); };
+        string caso = "árbol de capacidad " + to_string(capacidad);
+
+        auto comparar = [&](const string& momento) {
+            string error = arbol.revisar();
+            pruebas.verificar(error.empty(), caso + " " + momento + ": " + error);
+            pruebas.verificar(arbol.size() == referencia.size(), caso + " " + momento + ": size()");
+            pruebas.verificar(arbol.listar() == referencia, caso + " " + momento + ": listar()");
+            for (int i = 0; i < 20 && !referencia.empty(); ++i) {
+                size_t k = generador() % referencia.size();
+                pruebas.verificar(arbol.seleccionar(k) == referencia[k],
+                                  caso + " " + momento + ": seleccionar(" + to_string(k) + ")");
+                size_t cantidad = generador() % (3 * capacidad + 2);
+                size_t fin = min(referencia.size(), k + cantidad);
+                vector<uint32_t> ascendente(referencia.begin() + k, referencia.begin() + fin);
+                vector<uint32_t> descendente(referencia.rbegin() + k, referencia.rbegin() + fin);
+                pruebas.verificar(arbol.rango(k, cantidad) == ascendente,
+                                  caso + " " + momento + ": rango ascendente desde " + to_string(k));
+                pruebas.verificar(arbol.rango(k, cantidad, false) == descendente,
+                                  caso + " " + momento + ": rango descendente desde " + to_string(k));
             }
-            
-            size_t seleccion;
-            cout << "Seleccione el número de la canción a eliminar: ";
-            cin >> seleccion;
-            
-            if (seleccion < 1 || seleccion > canciones.size()) {
-                cout << "Selección inválida.\n";
-                return false;
+            bool fuera_de_rango = false;
+            try {
+                arbol.seleccionar(referencia.size());
+            } catch (const out_of_range&) {
+                fuera_de_rango = true;
+            }
+            pruebas.verificar(fuera_de_rango, caso + " " + momento + ": seleccionar tras el final");
+        };
+
+        for (int ronda = 0; ronda < 6; ++ronda) {
+            // Las rondas pares llenan el árbol y las impares lo vacían casi entero
+            bool llenar = ronda % 2 == 0;
+            for (int paso = 0; paso < 4000; ++paso) {
+                uint32_t id = generador() % catalogo.size();
+                auto pos = lower_bound(referencia.begin(), referencia.end(), id, antes);
+                bool esta = pos != referencia.end() && *pos == id;
+                pruebas.verificar(arbol.contiene(id) == esta, caso + ": contiene(" + to_string(id) + ")");
+                if (generador() % 4 != 0 ? llenar : !llenar) {
+                    pruebas.verificar(arbol.insertar(id) == !esta, caso + ": insertar(" + to_string(id) + ")");
+                    if (!esta) {
+                        referencia.insert(pos, id);
+                    }
+                } else {
+                    pruebas.verificar(arbol.eliminar(id) == esta, caso + ": eliminar(" + to_string(id) + ")");
+                    if (esta) {
+                        referencia.erase(pos);
+                    }
+                }
+                if (paso % 500 == 499) {
+                    comparar("en la ronda " + to_string(ronda));
+                }
             }
-            
-            return eliminar_cancion(canciones[seleccion - 1].track_id);
         }
-        
-        // Si solo hay una canción
-        return eliminar_cancion(canciones[0].track_id);
+
+        // Construcción ascendente y vaciado completo en orden al azar
+        arbol.construir_desde_ordenado(vector<uint32_t>(referencia));
+        comparar("tras construir_desde_ordenado");
+        vector<uint32_t> pendientes = referencia;
+        shuffle(pendientes.begin(), pendientes.end(), generador);
+        for (size_t i = 0; i < pendientes.size(); ++i) {
+            arbol.eliminar(pendientes[i]);
+            referencia.erase(lower_bound(referencia.begin(), referencia.end(), pendientes[i], antes));
+            if (i % 97 == 0) {
+                comparar("al vaciar");
+            }
+        }
+        comparar("vacío");
+        pruebas.verificar(arbol.altura() == 1, caso + ": el árbol vacío es una hoja");
     }
-    
-    void mover_cancion_por_nombre(const string& nombre, size_t nueva_posicion, bool por_artista = false) {
-        auto canciones = buscar_canciones_por_trie(nombre, por_artista);
-        
-        if (canciones.empty()) {
-            cout << "No se encontraron canciones.\n";
-            return;
+    pruebas.informar("Árbol B+ (bajas, rebalanceo y cuentas de posición)");
+}
+
+// Trie compacto frente a recorrer todas las palabras: búsquedas por prefijo,
+// los k de mayor peso y poda de nodos al eliminar
+void probar_trie(Comprobaciones& pruebas) {
+    mt19937 generador(11);
+    vector<TrieCompacto::Entrada> entradas;
+    for (uint32_t id = 0; id < 4000; ++id) {
+        entradas.push_back({nombre_de_prueba(generador, 7), id, static_cast<uint8_t>(generador() % 101)});
+    }
+    auto minusculas = [](string texto) {
+        for (char& c : texto) {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
         }
-        
-        // Si hay múltiples canciones, mostrar opciones
-        if (canciones.size() > 1) {
-            cout << "Se encontraron múltiples canciones:\n";
-            for (size_t i = 0; i < canciones.size(); ++i) {
-                cout << i + 1 << ". " 
-                     << canciones[i].track_name 
-                     << " - " << canciones[i].artist_name 
-                     << " (ID: " << canciones[i].track_id << ")\n";
+        return texto;
+    };
+    vector<string> palabras;  // en minúsculas, por id
+    for (const auto& entrada : entradas) {
+        palabras.push_back(minusculas(entrada.palabra));
+    }
+    vector<uint8_t> pesos;
+    for (const auto& entrada : entradas) {
+        pesos.push_back(entrada.peso);
+    }
+    vector<bool> presente(entradas.size(), true);
+
+    // La primera mitad entra en lote y la segunda de a una
+    TrieCompacto trie;
+    vector<TrieCompacto::Entrada> lote(entradas.begin(), entradas.begin() + entradas.size() / 2);
+    trie.insertar_lote(lote);
+    for (size_t i = entradas.size() / 2; i < entradas.size(); ++i) {
+        trie.insertar(entradas[i].palabra, entradas[i].id, entradas[i].peso);
+    }
+
+    vector<string> prefijos{"", "a", "A", "b", "c", " ", "zz"};
+    for (const char* primero : {"a", "b", "c", " "}) {
+        for (const char* segundo : {"a", "b", "c", " "}) {
+            prefijos.push_back(string(primero) + segundo);
+        }
+    }
+    for (int i = 0; i < 20; ++i) {
+        prefijos.push_back(nombre_de_prueba(generador, 5));
+    }
+
+    auto comparar = [&](const string& momento) {
+        for (const string& prefijo : prefijos) {
+            string buscado = minusculas(prefijo);
+            vector<uint32_t> esperados;
+            for (uint32_t id = 0; id < palabras.size(); ++id) {
+                if (presente[id] && palabras[id].compare(0, buscado.size(), buscado) == 0) {
+                    esperados.push_back(id);
+                }
             }
-            
-            size_t seleccion;
-            cout << "Seleccione el número de la canción a mover: ";
-            cin >> seleccion;
-            
-            if (seleccion < 1 || seleccion > canciones.size()) {
-                cout << "Selección inválida.\n";
-                return;
+            string caso = "trie " + momento + ", prefijo \"" + prefijo + "\"";
+
+            vector<uint32_t> encontrados = trie.buscar_prefijo(prefijo);
+            bool alfabetico = true;
+            for (size_t i = 1; i < encontrados.size(); ++i) {
+                alfabetico = alfabetico && palabras[encontrados[i - 1]] <= palabras[encontrados[i]];
             }
-            
-            try {
-                bTree.mover_cancion(canciones[seleccion - 1].track_id, nueva_posicion);
-                cout << "Canción movida.\n";
-            } catch (const exception& e) {
-                cout << "Error: " << e.what() << "\n";
+            pruebas.verificar(alfabetico, caso + ": buscar_prefijo fuera de orden alfabético");
+            sort(encontrados.begin(), encontrados.end());
+            pruebas.verificar(encontrados == esperados, caso + ": buscar_prefijo");
+
+            // Con pesos empatados cualquier id vale; se comparan los pesos
+            size_t k = 1 + generador() % 30;
+            vector<uint8_t> pesos_esperados;
+            for (uint32_t id : esperados) {
+                pesos_esperados.push_back(pesos[id]);
             }
-            return;
+            sort(pesos_esperados.rbegin(), pesos_esperados.rend());
+            pesos_esperados.resize(min(k, pesos_esperados.size()));
+            vector<uint32_t> mejores = trie.buscar_top_k(prefijo, k);
+            vector<uint8_t> pesos_obtenidos;
+            bool coinciden = true;
+            for (uint32_t id : mejores) {
+                pesos_obtenidos.push_back(pesos[id]);
+                coinciden = coinciden && binary_search(esperados.begin(), esperados.end(), id);
+            }
+            pruebas.verificar(coinciden && pesos_obtenidos == pesos_esperados,
+                              caso + ": buscar_top_k(" + to_string(k) + ")");
         }
-        
-        // Si solo hay una canción
-        try {
-            bTree.mover_cancion(canciones[0].track_id, nueva_posicion);
-            cout << "Canción movida.\n";
-        } catch (const exception& e) {
-            cout << "Error: " << e.what() << "\n";
+    };
+    comparar("recién armado");
+
+    vector<uint32_t> orden(entradas.size());
+    iota(orden.begin(), orden.end(), 0);
+    shuffle(orden.begin(), orden.end(), generador);
+    for (size_t i = 0; i < orden.size(); ++i) {
+        uint32_t id = orden[i];
+        // Una palabra equivocada o un id que ya no está no borran nada
+        pruebas.verificar(!trie.eliminar(palabras[id] + "x", id), "trie: eliminar con otra palabra");
+        pruebas.verificar(trie.eliminar(entradas[id].palabra, id), "trie: eliminar(" + to_string(id) + ")");
+        pruebas.verificar(!trie.eliminar(entradas[id].palabra, id), "trie: eliminar dos veces");
+        presente[id] = false;
+
+        if (i % 500 == 499) {
+            comparar("tras " + to_string(i + 1) + " bajas");
+            // La poda deja el trie igual que si solo se hubieran insertado las que quedan
+            TrieCompacto nuevo;
+            for (uint32_t otro = 0; otro < entradas.size(); ++otro) {
+                if (presente[otro]) {
+                    nuevo.insertar(entradas[otro].palabra, otro, entradas[otro].peso);
+                }
+            }
+            pruebas.verificar(trie.total_nodos() == nuevo.total_nodos(),
+                              "trie tras " + to_string(i + 1) + " bajas: " + to_string(trie.total_nodos()) +
+                              " nodos, armado de cero tiene " + to_string(nuevo.total_nodos()));
+        }
+    }
+    pruebas.verificar(trie.total_nodos() == 1, "trie vacío: solo queda la raíz");
+    pruebas.informar("Trie (búsquedas y poda al eliminar)");
+}
+
+// Cola de reproducción frente a un vector: cada operación desplaza los
+// elementos del vector y se compara posición por posición
+void probar_cola(Comprobaciones& pruebas) {
+    mt19937 generador(13);
+    SecuenciaReproduccion cola;
+    vector<uint32_t> referencia;
+    constexpr uint32_t IDS = 3000;
+
+    auto comparar = [&](const string& momento) {
+        string caso = "cola " + momento;
+        string error = cola.revisar();
+        pruebas.verificar(error.empty(), caso + ": " + error);
+        pruebas.verificar(cola.size() == referencia.size(), caso + ": size()");
+        pruebas.verificar(cola.listar() == referencia, caso + ": listar()");
+        for (int i = 0; i < 20 && !referencia.empty(); ++i) {
+            size_t pos = generador() % referencia.size();
+            size_t cantidad = generador() % 50;
+            pruebas.verificar(cola.en(pos) == referencia[pos], caso + ": en(" + to_string(pos) + ")");
+            pruebas.verificar(cola.posicion_de(referencia[pos]) == pos,
+                              caso + ": posicion_de(" + to_string(referencia[pos]) + ")");
+            vector<uint32_t> tramo(referencia.begin() + pos,
+                                   referencia.begin() + min(referencia.size(), pos + cantidad));
+            pruebas.verificar(cola.rango(pos, cantidad) == tramo, caso + ": rango desde " + to_string(pos));
+        }
+    };
+
+    for (int paso = 0; paso < 20000; ++paso) {
+        uint32_t id = generador() % IDS;
+        bool esta = find(referencia.begin(), referencia.end(), id) != referencia.end();
+        pruebas.verificar(cola.contiene(id) == esta, "cola: contiene(" + to_string(id) + ")");
+        switch (generador() % 6) {
+            case 0:
+            case 1: {
+                size_t pos = generador() % (referencia.size() + 1);
+                pruebas.verificar(cola.insertar_en(pos, id) == !esta, "cola: insertar_en");
+                if (!esta) {
+                    referencia.insert(referencia.begin() + pos, id);
+                }
+                break;
+            }
+            case 2:
+                if (!referencia.empty()) {
+                    size_t pos = generador() % referencia.size();
+                    pruebas.verificar(cola.eliminar_en(pos) == referencia[pos], "cola: eliminar_en");
+                    referencia.erase(referencia.begin() + pos);
+                }
+                break;
+            case 3:
+                pruebas.verificar(cola.eliminar(id) == esta, "cola: eliminar(" + to_string(id) + ")");
+                if (esta) {
+                    referencia.erase(find(referencia.begin(), referencia.end(), id));
+                }
+                break;
+            case 4:
+                if (!referencia.empty()) {
+                    size_t desde = generador() % referencia.size();
+                    size_t hasta = generador() % referencia.size();
+                    cola.mover(desde, hasta);
+                    uint32_t movido = referencia[desde];
+                    referencia.erase(referencia.begin() + desde);
+                    referencia.insert(referencia.begin() + hasta, movido);
+                }
+                break;
+            default: {
+                // Un lote con repetidos: los que ya están se ignoran
+                vector<uint32_t> lote;
+                for (size_t i = generador() % 40; i > 0; --i) {
+                    lote.push_back(generador() % IDS);
+                }
+                cola.agregar_al_final(lote);
+                for (uint32_t nuevo : lote) {
+                    if (find(referencia.begin(), referencia.end(), nuevo) == referencia.end()) {
+                        referencia.push_back(nuevo);
+                    }
+                }
+            }
+        }
+        if (paso % 1000 == 999) {
+            comparar("tras " + to_string(paso + 1) + " operaciones");
+        }
+    }
+
+    bool fuera_de_rango = false;
+    try {
+        cola.en(referencia.size());
+    } catch (const out_of_range&) {
+        fuera_de_rango = true;
+    }
+    pruebas.verificar(fuera_de_rango, "cola: en() tras el final");
+    while (!referencia.empty()) {
+        size_t pos = generador() % referencia.size();
+        pruebas.verificar(cola.eliminar_en(pos) == referencia[pos], "cola: vaciar con eliminar_en");
+        referencia.erase(referencia.begin() + pos);
+    }
+    comparar("vacía");
+    pruebas.informar("Cola de reproducción (treap implícito)");
+}
+
+// Mapas de bits frente a vectores ordenados: grupos dispersos (arreglos) y
+// densos (mapas), que pasan de un tipo a otro al agregar y quitar
+void probar_mapas_de_bits(Comprobaciones& pruebas) {
+    mt19937 generador(17);
+    auto conjunto_al_azar = [&generador](MapaBits& mapa, vector<uint32_t>& referencia) {
+        for (uint32_t grupo = 0; grupo < 6; ++grupo) {
+            // Entre vacío y más que MAXIMO_ARREGLO ids en el grupo
+            size_t cantidad = generador() % 4 == 0 ? 0 : generador() % (2 * MapaBits::MAXIMO_ARREGLO);
+            for (size_t i = 0; i < cantidad; ++i) {
+                uint32_t x = (grupo << 16) | (generador() % 65536);
+                mapa.agregar(x);
+                referencia.push_back(x);
+            }
+        }
+        sort(referencia.begin(), referencia.end());
+        referencia.erase(unique(referencia.begin(), referencia.end()), referencia.end());
+    };
+    auto comparar = [&pruebas, &generador](const MapaBits& mapa, const vector<uint32_t>& referencia,
+                                           const string& caso) {
+        pruebas.verificar(mapa.cardinalidad() == referencia.size(), caso + ": cardinalidad");
+        pruebas.verificar(mapa.vacio() == referencia.empty(), caso + ": vacio()");
+        pruebas.verificar(mapa.rango(0, SIZE_MAX) == referencia, caso + ": contenido");
+        for (int i = 0; i < 20; ++i) {
+            uint32_t x = generador() % (6 << 16);
+            pruebas.verificar(mapa.contiene(x) == binary_search(referencia.begin(), referencia.end(), x),
+                              caso + ": contiene(" + to_string(x) + ")");
+            size_t inicio = generador() % (referencia.size() + 1);
+            size_t cantidad = generador() % 5000;
+            vector<uint32_t> tramo(referencia.begin() + inicio,
+                                   referencia.begin() + min(referencia.size(), inicio + cantidad));
+            pruebas.verificar(mapa.rango(inicio, cantidad) == tramo, caso + ": rango desde " + to_string(inicio));
+        }
+    };
+
+    for (int ronda = 0; ronda < 30; ++ronda) {
+        MapaBits a, b;
+        vector<uint32_t> ref_a, ref_b;
+        conjunto_al_azar(a, ref_a);
+        conjunto_al_azar(b, ref_b);
+        string caso = "mapas de bits, ronda " + to_string(ronda);
+        comparar(a, ref_a, caso);
+
+        vector<uint32_t> ambos, alguno;
+        set_intersection(ref_a.begin(), ref_a.end(), ref_b.begin(), ref_b.end(), back_inserter(ambos));
+        set_union(ref_a.begin(), ref_a.end(), ref_b.begin(), ref_b.end(), back_inserter(alguno));
+        comparar(MapaBits::interseccion(a, b), ambos, caso + ", intersección");
+        comparar(MapaBits::union_de(a, b), alguno, caso + ", unión");
+
+        // Retener por rango de valores, con un valor al azar por id
+        vector<float> valores(6 << 16);
+        for (float& v : valores) {
+            v = static_cast<float>(generador() % 1000) / 1000.0f;
+        }
+        float minimo = static_cast<float>(generador() % 500) / 1000.0f;
+        float maximo = minimo + static_cast<float>(generador() % 500) / 1000.0f;
+        vector<uint32_t> en_rango;
+        for (uint32_t x : alguno) {
+            if (valores[x] >= minimo && valores[x] <= maximo) {
+                en_rango.push_back(x);
+            }
+        }
+        MapaBits retenidos = MapaBits::union_de(a, b);
+        retenidos.retener_en_rango(valores, minimo, maximo);
+        comparar(retenidos, en_rango, caso + ", retener_en_rango");
+
+        // Quitar la mayoría de a obliga a los mapas densos a volver a arreglos
+        vector<uint32_t> quedan;
+        for (uint32_t x : ref_a) {
+            if (generador() % 10 < 8) {
+                a.quitar(x);
+            } else {
+                quedan.push_back(x);
+            }
+        }
+        a.quitar(6u << 16);  // quitar lo que no está no cambia nada
+        comparar(a, quedan, caso + ", tras quitar");
+        ambos.clear();
+        set_intersection(quedan.begin(), quedan.end(), ref_b.begin(), ref_b.end(), back_inserter(ambos));
+        comparar(MapaBits::interseccion(a, b), ambos, caso + ", intersección tras quitar");
+    }
+    pruebas.informar("Mapas de bits (intersección, unión y rangos)");
+}
+
+// CSV con el esquema de spotify_data.csv, más filas inválidas y track_id
+// repetidos lejos de su primera aparición (en otro rango de la carga paralela)
+void escribir_csv_de_prueba(const string& ruta, size_t filas, mt19937& generador) {
+    ofstream archivo(ruta, ios::binary);
+    if (!archivo) {
+        throw runtime_error("No se pudo crear " + ruta);
+    }
+    archivo << ",artist_name,track_name,track_id,popularity,year,genre,danceability,energy,"
+               "key,loudness,mode,speechiness,acousticness,instrumentalness,liveness,"
+               "valence,tempo,duration_ms,time_signature\n";
+    for (size_t i = 0; i < filas; ++i) {
+        size_t numero = generador() % 20 == 0 ? generador() % (i + 1) : i;
+        archivo << i << ",Artista " << generador() % 300 << ',' << nombre_de_prueba(generador, 12)
+                << ",pista" << numero << ',';
+        switch (generador() % 50) {
+            case 0: archivo << "no_es_numero"; break;
+            case 1: archivo << "300"; break;  // no cabe en la columna
+            default: archivo << generador() % 101;
+        }
+        archivo << ',' << 1990 + generador() % 34 << ",genero" << generador() % 12 << ','
+                << generador() % 1000 / 1000.0 << ',' << generador() % 1000 / 1000.0 << ','
+                << generador() % 12 << ",-" << generador() % 60000 / 1000.0 << ',' << generador() % 2
+                << ',' << generador() % 1000 / 1000.0 << ',' << generador() % 1000 / 1000.0 << ','
+                << generador() % 1000 / 1000.0 << ',' << generador() % 1000 / 1000.0 << ','
+                << generador() % 1000 / 1000.0 << ',' << 60 + generador() % 140000 / 1000.0 << ','
+                << 30000 + generador() % 400000;
+        if (generador() % 100 == 0) {
+            archivo << "\n";  // fila cortada: le faltan campos
+            continue;
+        }
+        archivo << ',' << 3 + generador() % 3 << '\n';
+    }
+}
+
+bool filas_iguales(const FilaCancion& a, const FilaCancion& b) {
+    return a.artist_name == b.artist_name && a.track_name == b.track_name && a.track_id == b.track_id &&
+           a.popularity == b.popularity && a.anio == b.anio && a.genre == b.genre &&
+           a.danceability == b.danceability && a.energy == b.energy && a.key == b.key &&
+           a.loudness == b.loudness && a.mode == b.mode && a.speechiness == b.speechiness &&
+           a.acousticness == b.acousticness && a.instrumentalness == b.instrumentalness &&
+           a.liveness == b.liveness && a.valence == b.valence && a.tempo == b.tempo &&
+           a.duration_ms == b.duration_ms && a.time_signature == b.time_signature;
+}
+
+void comparar_catalogos(Comprobaciones& pruebas, const CatalogoColumnar& obtenido,
+                        const CatalogoColumnar& esperado, const string& caso) {
+    pruebas.verificar(obtenido.size() == esperado.size() && obtenido.total_vivas() == esperado.total_vivas(),
+                      caso + ": cantidad de canciones");
+    size_t distintas = 0;
+    for (uint32_t id = 0; id < min(obtenido.size(), esperado.size()); ++id) {
+        if (obtenido.esta_viva(id) != esperado.esta_viva(id) ||
+            !filas_iguales(obtenido.fila(id), esperado.fila(id)) ||
+            obtenido.buscar_id(esperado.track_id(id)) != (esperado.esta_viva(id) ? id : CatalogoColumnar::SIN_CANCION)) {
+            distintas++;
+        }
+    }
+    pruebas.verificar(distintas == 0, caso + ": " + to_string(distintas) + " filas distintas");
+}
+
+// La carga paralela debe dar el mismo catálogo, fila por fila, que la secuencial
+void probar_carga_csv(Comprobaciones& pruebas, const string& ruta_csv) {
+    EstadisticasCarga secuencial;
+    CatalogoColumnar esperado = cargar_csv_mapeado(ruta_csv, &secuencial);
+    pruebas.verificar(secuencial.filas_invalidas > 0 && secuencial.filas_repetidas > 0,
+                      "CSV de prueba sin filas inválidas o repetidas");
+    pruebas.verificar(secuencial.filas_validas == esperado.total_vivas(), "carga secuencial: filas válidas");
+    for (size_t hilos : {1, 2, 3, 5, 8}) {
+        EstadisticasCarga paralela;
+        CatalogoColumnar obtenido = cargar_csv_paralelo(ruta_csv, hilos, &paralela);
+        string caso = "carga paralela con " + to_string(hilos) + " hilos";
+        pruebas.verificar(paralela.filas_validas == secuencial.filas_validas &&
+                          paralela.filas_invalidas == secuencial.filas_invalidas &&
+                          paralela.filas_repetidas == secuencial.filas_repetidas,
+                          caso + ": estadísticas");
+        comparar_catalogos(pruebas, obtenido, esperado, caso);
+    }
+    pruebas.informar("Carga del CSV (paralela frente a secuencial)");
+}
+
+// Los filtros de la lista frente a recorrer el catálogo fila por fila
+void probar_filtros(Comprobaciones& pruebas, const string& ruta_csv) {
+    ListaReproduccion lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(ruta_csv));
+    mt19937 generador(19);
+    vector<Cancion> canciones = lista.listar_canciones();
+    for (size_t i = 0; i < canciones.size() / 4; ++i) {
+        lista.eliminar_cancion(canciones[generador() % canciones.size()].track_id);
+    }
+    const CatalogoColumnar& catalogo = lista.catalogo;
+
+    for (int ronda = 0; ronda < 40; ++ronda) {
+        FiltroCanciones filtro;
+        auto algunos = [&generador](int desde, int hasta) {
+            vector<int> valores;
+            for (int v = desde; v <= hasta; ++v) {
+                if (generador() % 3 == 0) {
+                    valores.push_back(v);
+                }
+            }
+            return valores;
+        };
+        if (generador() % 2) {
+            for (int g : algunos(0, 12)) {
+                filtro.generos.push_back("genero" + to_string(g));  // genero12 no existe
+            }
+        }
+        if (generador() % 2) {
+            filtro.anio_desde = 1990 + static_cast<int>(generador() % 34);
+            filtro.anio_hasta = filtro.anio_desde + static_cast<int>(generador() % 10);
+        }
+        if (generador() % 2) {
+            filtro.tonalidades = algunos(0, 11);
+        }
+        if (generador() % 3 == 0) {
+            filtro.modos = algunos(0, 1);
+        }
+        if (generador() % 3 == 0) {
+            filtro.compases = algunos(3, 5);
+        }
+        if (generador() % 2) {
+            float minimo = static_cast<float>(generador() % 100) / 100.0f;
+            filtro.rasgos.push_back({generador() % MatrizRasgos::NUM_RASGOS, minimo, minimo + 0.5f});
+        }
+
+        auto en = [](const auto& valores, const auto& valor) {
+            return valores.empty() || find(valores.begin(), valores.end(), valor) != valores.end();
+        };
+        vector<uint32_t> esperados;
+        for (uint32_t id = 0; id < catalogo.size(); ++id) {
+            bool cumple = catalogo.esta_viva(id) &&
+                en(filtro.generos, string(catalogo.generos.obtener(catalogo.genero[id]))) &&
+                catalogo.anio[id] >= filtro.anio_desde && catalogo.anio[id] <= filtro.anio_hasta &&
+                en(filtro.tonalidades, catalogo.key[id]) && en(filtro.modos, catalogo.mode[id]) &&
+                en(filtro.compases, catalogo.time_signature[id]);
+            for (const auto& rango : filtro.rasgos) {
+                float valor = MatrizRasgos::columna(catalogo, rango.rasgo)[id];
+                cumple = cumple && valor >= rango.minimo && valor <= rango.maximo;
+            }
+            if (cumple) {
+                esperados.push_back(id);
+            }
+        }
+        CursorFiltro cursor = lista.filtrar(filtro);
+        string caso = "filtro " + to_string(ronda);
+        pruebas.verificar(cursor.total() == esperados.size(), caso + ": total()");
+        vector<uint32_t> obtenidos;
+        while (!cursor.terminado()) {
+            vector<uint32_t> pagina = cursor.siguientes(1 + generador() % 700);
+            obtenidos.insert(obtenidos.end(), pagina.begin(), pagina.end());
+        }
+        pruebas.verificar(obtenidos == esperados, caso + ": canciones");
+    }
+    pruebas.informar("Filtros (mapas de bits de la lista)");
+}
+
+vector<string> track_ids(const vector<Cancion>& canciones) {
+    vector<string> ids;
+    for (const Cancion& cancion : canciones) {
+        ids.push_back(cancion.track_id);
+    }
+    return ids;
+}
+
+// Guardar la instantánea y abrirla en otra lista debe dar las mismas respuestas
+void probar_instantanea(Comprobaciones& pruebas, const string& ruta_csv) {
+    string ruta = ruta_csv + ".snap";
+    ListaReproduccion original;
+    original.cargar_catalogo(cargar_csv_paralelo(ruta_csv));
+    mt19937 generador(5);
+    vector<Cancion> canciones = original.listar_canciones();
+    for (size_t i = 0; i < canciones.size() / 5; ++i) {
+        original.eliminar_cancion(canciones[generador() % canciones.size()].track_id);
+    }
+    original.guardar_instantanea(ruta, ruta_csv);
+
+    ListaReproduccion abierta;
+    pruebas.verificar(abierta.abrir_instantanea(ruta, ruta_csv), "instantánea: no se pudo abrir");
+    pruebas.verificar(abierta.total_canciones == original.total_canciones, "instantánea: total de canciones");
+    pruebas.verificar(track_ids(abierta.listar_canciones()) == track_ids(original.listar_canciones()),
+                      "instantánea: orden por nombre");
+    for (bool ascendente : {true, false}) {
+        pruebas.verificar(track_ids(abierta.listar_por_popularidad(ascendente)) ==
+                          track_ids(original.listar_por_popularidad(ascendente)),
+                          "instantánea: orden por popularidad");
+        size_t total = original.total_canciones;
+        pruebas.verificar(track_ids(abierta.listar_por_duracion_paginado(ascendente, 1, total).canciones) ==
+                          track_ids(original.listar_por_duracion_paginado(ascendente, 1, total).canciones),
+                          "instantánea: orden por duración");
+    }
+    for (int anio = 1990; anio < 2024; ++anio) {
+        pruebas.verificar(track_ids(abierta.obtener_por_anio(anio)) == track_ids(original.obtener_por_anio(anio)),
+                          "instantánea: año " + to_string(anio));
+    }
+    for (const char* prefijo : {"a", "ab", "b", "c a", "Artista 1", "artista 29"}) {
+        for (bool por_artista : {false, true}) {
+            string caso = string("instantánea: prefijo \"") + prefijo + "\"";
+            pruebas.verificar(track_ids(abierta.buscar_canciones_por_trie(prefijo, por_artista)) ==
+                              track_ids(original.buscar_canciones_por_trie(prefijo, por_artista)),
+                              caso);
+            pruebas.verificar(track_ids(abierta.buscar_top_k(prefijo, 10, por_artista)) ==
+                              track_ids(original.buscar_top_k(prefijo, 10, por_artista)),
+                              caso + ", top 10");
+        }
+    }
+    for (int genero = 0; genero < 12; ++genero) {
+        FiltroCanciones filtro;
+        filtro.generos = {"genero" + to_string(genero)};
+        filtro.anio_desde = 2000 + genero;
+        filtro.tonalidades = {genero % 12, (genero + 5) % 12};
+        pruebas.verificar(abierta.filtrar(filtro).rango(0, SIZE_MAX) ==
+                          original.filtrar(filtro).rango(0, SIZE_MAX),
+                          "instantánea: filtro por genero" + to_string(genero));
+    }
+    error_code error;
+    filesystem::remove(ruta, error);
+    pruebas.informar("Instantánea (guardar y abrir)");
+}
+
+// Devuelve la cantidad de comprobaciones que fallaron
+size_t ejecutar_pruebas() {
+    Comprobaciones pruebas;
+    probar_arbol(pruebas);
+    probar_trie(pruebas);
+    probar_cola(pruebas);
+    probar_mapas_de_bits(pruebas);
+
+    string ruta_csv = (filesystem::temp_directory_path() / "spotify_pruebas.csv").string();
+    mt19937 generador(3);
+    // Más de 1 MB por hilo para que la carga paralela de verdad se reparta
+    escribir_csv_de_prueba(ruta_csv, 60000, generador);
+    probar_carga_csv(pruebas, ruta_csv);
+    probar_filtros(pruebas, ruta_csv);
+    probar_instantanea(pruebas, ruta_csv);
+    error_code error;
+    filesystem::remove(ruta_csv, error);
+
+    cout << (pruebas.fallas() == 0 ? "Todas las pruebas pasaron\n" : "Hubo fallas\n");
+    return pruebas.fallas();
+}
+
+// Reordenar la cola de reproducción: movimientos al azar entre posiciones
+// cualesquiera y consultas de la posición de una canción, comparados con
+// mover dentro de un vector (borrar e insertar desplazan O(n) elementos).
+void benchmark_cola(const string& file_path) {
+    ListaReproduccion lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    SecuenciaReproduccion& cola = lista.cola;
+    vector<uint32_t> vector_cola = cola.listar();
+    size_t n = cola.size();
+    if (n == 0) {
+        cout << "La cola está vacía.\n";
+        return;
+    }
+
+    mt19937 generador(7);
+    const size_t movimientos = 100000;
+    vector<pair<size_t, size_t>> posiciones(movimientos);
+    for (auto& [desde, hasta] : posiciones) {
+        desde = generador() % n;
+        hasta = generador() % n;
+    }
+
+    auto inicio = chrono::high_resolution_clock::now();
+    for (auto [desde, hasta] : posiciones) {
+        cola.mover(desde, hasta);
+    }
+    auto fin_cola = chrono::high_resolution_clock::now();
+    size_t suma = 0;
+    for (size_t i = 0; i < movimientos; ++i) {
+        suma += cola.posicion_de(vector_cola[i % n]);
+    }
+    auto fin_posicion = chrono::high_resolution_clock::now();
+    for (auto [desde, hasta] : posiciones) {
+        uint32_t id = vector_cola[desde];
+        vector_cola.erase(vector_cola.begin() + desde);
+        vector_cola.insert(vector_cola.begin() + hasta, id);
+    }
+    auto fin_vector = chrono::high_resolution_clock::now();
+
+    cout << fixed << setprecision(2);
+    cout << "Cola de " << n << " canciones, " << movimientos << " movimientos\n";
+    cout << "SecuenciaReproduccion::mover: "
+         << chrono::duration<double, micro>(fin_cola - inicio).count() / movimientos << " us por movimiento\n";
+    cout << "SecuenciaReproduccion::posicion_de: "
+         << chrono::duration<double, micro>(fin_posicion - fin_cola).count() / movimientos << " us por consulta"
+         << " (suma " << suma << ")\n";
+    cout << "vector (borrar e insertar): "
+         << chrono::duration<double, micro>(fin_vector - fin_posicion).count() / movimientos << " us por movimiento\n";
+    cout << "Mismo orden final: " << (cola.listar() == vector_cola ? "sí" : "no") << "\n";
+}
+
+// Costo de elegir la siguiente canción en cada modo del motor de reproducción
+void benchmark_reproduccion(const string& file_path) {
+    ListaReproduccion lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    MotorReproduccion& motor = lista.reproductor;
+    const size_t elecciones = 1000000;
+
+    size_t suma = 0;
+    auto inicio = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < elecciones; ++i) {
+        suma += motor.siguiente_mezcla();
+    }
+    auto fin_mezcla = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < elecciones; ++i) {
+        suma += motor.siguiente_ponderada();
+    }
+    auto fin_ponderada = chrono::high_resolution_clock::now();
+
+    cout << fixed << setprecision(1);
+    cout << motor.size() << " canciones, " << elecciones << " elecciones por modo (suma " << suma << ")\n";
+    cout << "Mezcla sin repetición: "
+         << chrono::duration<double, nano>(fin_mezcla - inicio).count() / elecciones << " ns por canción\n";
+    cout << "Ponderada por popularidad: "
+         << chrono::duration<double, nano>(fin_ponderada - fin_mezcla).count() / elecciones << " ns por canción\n";
+}
+
+void benchmark_similares(const string& file_path) {
+    ListaReproduccion lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    const CatalogoColumnar& catalogo = lista.catalogo;
+    if (lista.total_canciones == 0) {
+        return;
+    }
+    const size_t k = 10;
+    const size_t consultas = 200;
+
+    vector<string> pedidas;
+    mt19937 generador(7);
+    vector<Cancion> todas = lista.listar_canciones();
+    for (size_t i = 0; i < consultas; ++i) {
+        pedidas.push_back(todas[generador() % todas.size()].track_id);
+    }
+    todas.clear();
+
+    // Referencia: recorrer el catálogo canción por canción, ordenar todas las
+    // distancias y quedarse con las k primeras
+    MatrizRasgos matriz;
+    matriz.construir(catalogo);
+    auto directo = [&](const string& track_id) {
+        uint32_t id = catalogo.buscar_id(track_id);
+        auto consulta = matriz.rasgos_de(catalogo, id);
+        vector<pair<float, uint32_t>> distancias;
+        for (uint32_t otro = 0; otro < catalogo.size(); ++otro) {
+            if (otro == id || !catalogo.esta_viva(otro)) {
+                continue;
+            }
+            auto rasgos = matriz.rasgos_de(catalogo, otro);
+            float distancia = 0;
+            for (size_t f = 0; f < MatrizRasgos::NUM_RASGOS; ++f) {
+                distancia += (rasgos[f] - consulta[f]) * (rasgos[f] - consulta[f]);
+            }
+            distancias.emplace_back(distancia, otro);
+        }
+        sort(distancias.begin(), distancias.end());
+        return distancias.size() > k ? k : distancias.size();
+    };
+
+    cout << fixed << setprecision(3);
+    cout << lista.total_canciones << " canciones, " << consultas << " consultas de las " << k
+         << " más parecidas\n";
+
+    auto inicio = chrono::high_resolution_clock::now();
+    // La lista ya armó la suya al cargar; se mide armar otra igual
+    MatrizRasgos armada;
+    armada.construir(catalogo);
+    size_t suma = armada.filas();
+    cout << "Armar la matriz de rasgos: "
+         << chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count() << " ms\n";
+
+    const size_t consultas_directas = 5;
+    inicio = chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < consultas_directas; ++i) {
+        suma += directo(pedidas[i]);
+    }
+    double ms_directo = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count()
+        / consultas_directas;
+    cout << "Recorrido directo y orden completo: " << ms_directo << " ms por consulta ("
+         << 1000 / ms_directo << " consultas/s)\n";
+
+    vector<size_t> opciones_hilos = {1};
+    if (hilos_disponibles() > 1) {
+        opciones_hilos.push_back(hilos_disponibles());
+    }
+    for (size_t hilos : opciones_hilos) {
+        inicio = chrono::high_resolution_clock::now();
+        for (const string& track_id : pedidas) {
+            suma += lista.buscar_similares(track_id, k, MatrizRasgos::pesos_iguales(), hilos).size();
         }
+        double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count()
+            / consultas;
+        cout << "Matriz de rasgos, " << hilos << " hilo(s): " << ms << " ms por consulta ("
+             << 1000 / ms << " consultas/s)\n";
+    }
+    cout << "(suma " << suma << ")\n";
+}
+
+void benchmark_vecinos(const string& file_path) {
+    ListaReproduccion lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    if (lista.total_canciones < 2) {
+        return;
+    }
+    const size_t k = 10;
+    const size_t consultas = 200;
+
+    vector<Cancion> todas = lista.listar_canciones();
+    mt19937 generador(11);
+    vector<string> pedidas;
+    for (size_t i = 0; i < consultas; ++i) {
+        pedidas.push_back(todas[generador() % todas.size()].track_id);
     }
-    
-    struct Pagina {
-        vector<Cancion> canciones;
-        size_t total_canciones;
-        size_t pagina_actual;
-        size_t total_paginas;
+
+    // Respuestas exactas para medir la exhaustividad (recall@k)
+    auto exactas = [&]() {
+        vector<unordered_set<string>> respuestas;
+        for (const string& track_id : pedidas) {
+            unordered_set<string> ids;
+            for (const Cancion& cancion : lista.buscar_similares(track_id, k)) {
+                ids.insert(cancion.track_id);
+            }
+            respuestas.push_back(move(ids));
+        }
+        return respuestas;
+    };
+    auto medir = [&](const vector<unordered_set<string>>& respuestas, size_t ef) {
+        size_t aciertos = 0;
+        size_t esperados = 0;
+        auto inicio = chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < consultas; ++i) {
+            for (const Cancion& cancion : lista.buscar_similares_aproximado(pedidas[i], k, ef)) {
+                aciertos += respuestas[i].count(cancion.track_id);
+            }
+            esperados += respuestas[i].size();
+        }
+        double us = chrono::duration<double, micro>(chrono::high_resolution_clock::now() - inicio).count()
+            / consultas;
+        cout << "  ef " << setw(4) << ef << ": recall@" << k << " " << setprecision(3)
+             << double(aciertos) / max<size_t>(1, esperados) << ", " << setprecision(1) << us
+             << " us por consulta (" << setprecision(0) << 1e6 / us << " consultas/s)\n";
     };
 
-    Pagina listar_canciones_paginado(size_t pagina = 1, size_t canciones_por_pagina = 200) const {
-        auto todas_canciones = bTree.listar();
-        return paginar(todas_canciones, pagina, canciones_por_pagina);
+    cout << fixed;
+    cout << lista.total_canciones << " canciones, " << consultas << " consultas de las " << k
+         << " más parecidas\n";
+    auto inicio = chrono::high_resolution_clock::now();
+    vector<unordered_set<string>> respuestas = exactas();
+    cout << "Búsqueda exacta (matriz de rasgos): " << setprecision(3)
+         << chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count() / consultas
+         << " ms por consulta\n";
+
+    const vector<size_t> opciones_ef = {10, 20, 40, 80, 160, 320};
+    IndiceHNSW::Parametros predeterminados;
+    // El último es el predeterminado, que se usa a continuación sin rehacerlo
+    for (uint32_t m : {8u, 32u, predeterminados.m}) {
+        IndiceHNSW::Parametros parametros;
+        parametros.m = m;
+        inicio = chrono::high_resolution_clock::now();
+        lista.configurar_vecinos(parametros);
+        lista.construir_indice_vecinos();
+        double segundos = chrono::duration<double>(chrono::high_resolution_clock::now() - inicio).count();
+        cout << "m " << m << ", ef_construccion " << parametros.ef_construccion << ": construcción "
+             << setprecision(2) << segundos << " s (" << setprecision(1)
+             << segundos * 1e6 / lista.total_canciones << " us por canción)\n";
+        for (size_t ef : opciones_ef) {
+            medir(respuestas, ef);
+        }
     }
 
-    Pagina listar_por_popularidad_paginado(bool ascendente = true, size_t pagina = 1, size_t canciones_por_pagina = 200) const {
-        auto canciones = bTree.listar_por_popularidad(ascendente);
-        return paginar(canciones, pagina, canciones_por_pagina);
+    // Guardar y abrir el grafo con los parámetros predeterminados
+    string ruta = file_path + ".hnsw";
+    inicio = chrono::high_resolution_clock::now();
+    lista.guardar_indice_vecinos(ruta, file_path);
+    auto fin_guardar = chrono::high_resolution_clock::now();
+    ListaReproduccion reabierta;
+    reabierta.cargar_catalogo(cargar_csv_paralelo(file_path));
+    auto inicio_abrir = chrono::high_resolution_clock::now();
+    bool abierto = reabierta.abrir_indice_vecinos(ruta, file_path);
+    auto fin_abrir = chrono::high_resolution_clock::now();
+    cout << "Guardar el grafo: " << setprecision(1)
+         << chrono::duration<double, milli>(fin_guardar - inicio).count() << " ms; abrirlo: "
+         << chrono::duration<double, milli>(fin_abrir - inicio_abrir).count() << " ms"
+         << (abierto ? "" : " (no se pudo abrir)") << '\n';
+
+    // Bajas: el 10% de las canciones queda marcado en el grafo
+    for (size_t i = 0; i < todas.size() / 10; ++i) {
+        const string& track_id = todas[generador() % todas.size()].track_id;
+        if (find(pedidas.begin(), pedidas.end(), track_id) == pedidas.end()) {
+            lista.eliminar_cancion(track_id);
+        }
     }
+    cout << "Tras eliminar " << todas.size() - lista.total_canciones << " canciones al azar:\n";
+    respuestas = exactas();
+    medir(respuestas, predeterminados.ef_busqueda);
+}
 
-    Pagina obtener_por_anio_paginado(int anio, size_t pagina = 1, size_t canciones_por_pagina = 200) const {
-        auto canciones = bTree.obtener_por_anio(anio);
-        return paginar(canciones, pagina, canciones_por_pagina);
+void benchmark_filtros(const string& file_path) {
+    ListaReproduccion lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    const CatalogoColumnar& catalogo = lista.catalogo;
+    if (lista.total_canciones == 0) {
+        return;
     }
 
-    Pagina listar_por_duracion_paginado(bool ascendente = true, size_t pagina = 1, size_t canciones_por_pagina = 200) const {
-        auto canciones = bTree.listar_por_duracion(ascendente);
-        return paginar(canciones, pagina, canciones_por_pagina);
+    auto inicio = chrono::high_resolution_clock::now();
+    IndiceFiltros indice;
+    indice.construir(catalogo);
+    double ms_construir = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count();
+    cout << fixed << setprecision(2);
+    cout << lista.total_canciones << " canciones. Mapas de bits: " << ms_construir << " ms, "
+         << indice.memoria() / 1024 << " KB\n";
+
+    // Referencia: revisar cada canción del catálogo
+    auto cumple = [&catalogo](uint32_t id, const FiltroCanciones& filtro) {
+        auto en = [](const vector<int>& valores, int valor) {
+            return valores.empty() || find(valores.begin(), valores.end(), valor) != valores.end();
+        };
+        bool genero = filtro.generos.empty() ||
+            find(filtro.generos.begin(), filtro.generos.end(),
+                 catalogo.generos.obtener(catalogo.genero[id])) != filtro.generos.end();
+        bool rasgos = all_of(filtro.rasgos.begin(), filtro.rasgos.end(), [&](const auto& rango) {
+            float valor = MatrizRasgos::columna(catalogo, rango.rasgo)[id];
+            return valor >= rango.minimo && valor <= rango.maximo;
+        });
+        return catalogo.esta_viva(id) && genero && rasgos &&
+            catalogo.anio[id] >= filtro.anio_desde && catalogo.anio[id] <= filtro.anio_hasta &&
+            en(filtro.tonalidades, catalogo.key[id]) && en(filtro.modos, catalogo.mode[id]) &&
+            en(filtro.compases, catalogo.time_signature[id]);
+    };
+
+    // Un género presente: el de la primera canción
+    string genero(catalogo.generos.obtener(catalogo.genero[lista.bTree.seleccionar(0)]));
+    const size_t ENERGY = 1;
+    const size_t TEMPO = 8;
+    vector<pair<string, FiltroCanciones>> consultas(4);
+    consultas[0].first = "genre = " + genero + ", 2015-2020, tempo 120-130, energy >= 0.8";
+    consultas[0].second.generos = {genero};
+    consultas[0].second.anio_desde = 2015;
+    consultas[0].second.anio_hasta = 2020;
+    consultas[0].second.rasgos = {{TEMPO, 120, 130}, {ENERGY, 0.8f, numeric_limits<float>::max()}};
+    consultas[1].first = "tempo 120-130, energy >= 0.8";
+    consultas[1].second.rasgos = consultas[0].second.rasgos;
+    consultas[2].first = "2015-2020, mode = 1, key en {0, 7}";
+    consultas[2].second.anio_desde = 2015;
+    consultas[2].second.anio_hasta = 2020;
+    consultas[2].second.modos = {1};
+    consultas[2].second.tonalidades = {0, 7};
+    consultas[3].first = "time_signature en {3, 5}, mode = 0";
+    consultas[3].second.compases = {3, 5};
+    consultas[3].second.modos = {0};
+
+    const int repeticiones = 20;
+    for (const auto& [descripcion, filtro] : consultas) {
+        size_t total = 0;
+        inicio = chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeticiones; ++r) {
+            CursorFiltro cursor = lista.filtrar(filtro);
+            total = cursor.total();
+            lista.filtrar_paginado(cursor, 1);
+        }
+        double ms_mapas = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count()
+            / repeticiones;
+
+        size_t total_recorrido = 0;
+        inicio = chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeticiones; ++r) {
+            vector<uint32_t> ids;
+            for (uint32_t id = 0; id < catalogo.size(); ++id) {
+                if (cumple(id, filtro)) {
+                    ids.push_back(id);
+                }
+            }
+            total_recorrido = ids.size();
+        }
+        double ms_recorrido = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count()
+            / repeticiones;
+
+        cout << descripcion << ": " << total << " canciones"
+             << (total == total_recorrido ? "" : " (¡distinto del recorrido!)") << "\n"
+             << "  mapas de bits y primera página: " << ms_mapas << " ms; recorrido completo: "
+             << ms_recorrido << " ms\n";
     }
+}
 
-  private:
+void benchmark_agrupar(const string& file_path) {
+    ListaReproduccion lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    const CatalogoColumnar& catalogo = lista.catalogo;
+    const vector<double> cuantiles = {0.5, 0.9, 0.99};
+    const int repeticiones = 5;
+    cout << fixed << setprecision(2);
+    cout << lista.total_canciones << " canciones, medida tempo\n";
 
-    Pagina paginar(const vector<Cancion>& canciones, size_t pagina, size_t canciones_por_pagina) const {
-        size_t total_canciones = canciones.size();
-        size_t total_paginas = (total_canciones + canciones_por_pagina - 1) / canciones_por_pagina;
+    // Referencia: un mapa por nombre del grupo con todos sus valores
+    auto inicio = chrono::high_resolution_clock::now();
+    unordered_map<string, vector<float>> por_genero;
+    for (uint32_t id = 0; id < catalogo.size(); ++id) {
+        if (catalogo.esta_viva(id)) {
+            por_genero[string(catalogo.generos.obtener(catalogo.genero[id]))].push_back(catalogo.tempo[id]);
+        }
+    }
+    for (auto& [genero, valores] : por_genero) {
+        sort(valores.begin(), valores.end());
+    }
+    cout << "Referencia (mapa de cadenas y orden completo), por género: "
+         << chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count() << " ms\n";
 
-        // Validar página
-        pagina = min(max(pagina, static_cast<size_t>(1)), total_paginas);
+    vector<size_t> opciones_hilos = {1};
+    if (hilos_disponibles() > 1) {
+        opciones_hilos.push_back(hilos_disponibles());
+    }
+    const pair<Agrupacion, const char*> agrupaciones[] = {
+        {Agrupacion::GENERO, "género"}, {Agrupacion::ANIO, "año"}, {Agrupacion::ARTISTA, "artista"}};
+    for (const auto& [agrupacion, nombre] : agrupaciones) {
+        size_t grupos = 0;
+        for (size_t hilos : opciones_hilos) {
+            for (bool con_cuantiles : {false, true}) {
+                inicio = chrono::high_resolution_clock::now();
+                for (int r = 0; r < repeticiones; ++r) {
+                    grupos = lista.agrupar(agrupacion, Medida::TEMPO,
+                                           con_cuantiles ? cuantiles : vector<double>{}, hilos).size();
+                }
+                double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - inicio).count()
+                    / repeticiones;
+                cout << "Por " << nombre << " (" << grupos << " grupos), " << hilos << " hilo(s)"
+                     << (con_cuantiles ? ", con p50/p90/p99: " : ": ") << ms << " ms\n";
+            }
+        }
+    }
+}
 
-        // Calcular rango de canciones para la página
-        size_t inicio = (pagina - 1) * canciones_por_pagina;
-        size_t fin = min(inicio + canciones_por_pagina, total_canciones);
+void benchmark_concurrencia(const string& file_path) {
+    ListaConcurrente lista;
+    lista.cargar_catalogo(cargar_csv_paralelo(file_path));
+    vector<Cancion> canciones = lista.leer()->listar_canciones();
+    if (canciones.empty()) {
+        cout << "El archivo no tiene canciones.\n";
+        return;
+    }
+    const auto duracion = chrono::milliseconds(1000);
+    const size_t por_lote = 64;
+    cout << fixed << setprecision(0);
+    cout << canciones.size() << " canciones; cada lectura es una página de 50 o las 10 más populares de un prefijo\n";
+
+    // Una lectura de la mezcla: los prefijos salen de los nombres de la lista
+    auto leer_una = [&canciones](const ListaReproduccion& l, mt19937& generador) {
+        const Cancion& cancion = canciones[generador() % canciones.size()];
+        if (generador() % 2) {
+            return l.buscar_top_k(cancion.track_name.substr(0, 3), 10).size();
+        }
+        return l.listar_canciones_paginado(1 + generador() % 1000, 50).canciones.size();
+    };
 
-        vector<Cancion> canciones_pagina(
-            canciones.begin() + inicio, 
-            canciones.begin() + fin
-        );
+    // El escritor elimina y vuelve a agregar canciones por lotes hasta que
+    // terminan los lectores; `aplicar_lote` publica un lote completo
+    auto medir = [&](size_t lectores, auto&& leer_con, auto&& aplicar_lote) {
+        atomic<bool> terminado{false};
+        atomic<size_t> lecturas{0};
+        size_t lotes = 0;
+        thread escritor([&]() {
+            mt19937 generador(3);
+            while (!terminado.load()) {
+                vector<ListaConcurrente::Cambio> lote;
+                for (size_t i = 0; i < por_lote / 2; ++i) {
+                    const Cancion& cancion = canciones[generador() % canciones.size()];
+                    lote.push_back(ListaConcurrente::Cambio::eliminar(cancion.track_id));
+                    lote.push_back(ListaConcurrente::Cambio::agregar(cancion));
+                }
+                aplicar_lote(lote);
+                lotes++;
+            }
+        });
+        vector<thread> hilos;
+        for (size_t h = 0; h < lectores; ++h) {
+            hilos.emplace_back([&, h]() {
+                mt19937 generador(static_cast<uint32_t>(h + 1));
+                size_t propias = 0;
+                auto fin = chrono::steady_clock::now() + duracion;
+                while (chrono::steady_clock::now() < fin) {
+                    leer_con(generador);
+                    propias++;
+                }
+                lecturas += propias;
+            });
+        }
+        for (auto& hilo : hilos) {
+            hilo.join();
+        }
+        terminado = true;
+        escritor.join();
+        double segundos = chrono::duration<double>(duracion).count();
+        cout << lectores << " lector(es): " << lecturas.load() / segundos << " lecturas/s, "
+             << lotes * por_lote / segundos << " cambios/s\n";
+    };
 
-        return {
-            move(canciones_pagina),
-            total_canciones,
-            pagina,
-            total_paginas
-        };
+    vector<size_t> opciones_lectores;
+    for (size_t lectores = 1; lectores <= max<size_t>(hilos_disponibles(), 4); lectores *= 2) {
+        opciones_lectores.push_back(lectores);
     }
-};
 
-// Optimización de carga de CSV
-vector<Cancion> cargar_csv(const string& file_path) {
-    vector<Cancion> canciones;
-    
-    // Abrir el archivo con ifstream en modo binario para mayor eficiencia
-    ifstream file(file_path, ios::binary | ios::ate);
-    
-    if (!file.is_open()) {
-        throw runtime_error("No se pudo abrir el archivo: " + file_path);
+    cout << "Versiones (ListaConcurrente):\n";
+    for (size_t lectores : opciones_lectores) {
+        medir(lectores,
+            [&](mt19937& generador) {
+                auto lectura = lista.leer();
+                return leer_una(*lectura, generador);
+            },
+            [&](const vector<ListaConcurrente::Cambio>& lote) { lista.publicar(lote); });
     }
 
-    // Obtener tamaño del archivo de manera más eficiente
-    streamsize file_size = file.tellg();
-    file.seekg(0, ios::beg);
+    // Referencia: una sola lista protegida con un candado de lectores y escritor
+    ListaReproduccion protegida;
+    protegida.cargar_catalogo(cargar_csv_paralelo(file_path));
+    shared_mutex candado;
+    cout << "Referencia (shared_mutex):\n";
+    for (size_t lectores : opciones_lectores) {
+        medir(lectores,
+            [&](mt19937& generador) {
+                shared_lock<shared_mutex> lectura(candado);
+                return leer_una(protegida, generador);
+            },
+            [&](const vector<ListaConcurrente::Cambio>& lote) {
+                unique_lock<shared_mutex> escritura(candado);
+                for (const auto& cambio : lote) {
+                    if (cambio.tipo == ListaConcurrente::Cambio::Tipo::AGREGAR) {
+                        protegida.agregar_cancion(cambio.cancion);
+                    } else {
+                        protegida.eliminar_cancion(cambio.track_id);
+                    }
+                }
+            });
+    }
+}
 
-    // Reserva de memoria con tamaño más preciso
-    canciones.reserve(file_size / 250);  // Estimación más ajustada
+// Generador pseudoaleatorio splitmix64. A diferencia de las distribuciones
+// de <random>, cuya salida depende de la biblioteca estándar, da los mismos
+// números con cualquier compilador, así que el CSV sintético es idéntico
+// byte a byte entre compilaciones.
+class GeneradorDeterminista {
+public:
+    explicit GeneradorDeterminista(uint64_t semilla) : estado(semilla) {}
 
-    // Buffer para lectura de líneas
-    string linea;
-    linea.reserve(300);  // Reservar memoria para cada línea
+    uint64_t siguiente() {
+        return mezclar(estado += 0x9e3779b97f4a7c15ULL);
+    }
 
-    // Saltar encabezado
-    getline(file, linea);
+    // Entero en [0, n)
+    uint64_t entero(uint64_t n) {
+        return siguiente() % n;
+    }
 
-    // Usar vectores de strings con reserva para parsing
-    vector<string> campos;
-    campos.reserve(20);
+    // Real en [0, 1)
+    double real() {
+        return static_cast<double>(siguiente() >> 11) * 0x1.0p-53;
+    }
 
-    // Contador de progreso y medición de tiempo
-    size_t contador = 0;
-    auto inicio = chrono::high_resolution_clock::now();
+    // Biyección de 64 bits: valores distintos dan resultados distintos
+    static uint64_t mezclar(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
 
-    // Parsing más rápido con parsing manual
-    while (getline(file, linea)) {
-        campos.clear();
-        
-        // Parsing de CSV manual más rápido que stringstream
-        size_t pos = 0;
-        size_t next_pos = 0;
-        while ((next_pos = linea.find(',', pos)) != string::npos) {
-            campos.push_back(linea.substr(pos, next_pos - pos));
-            pos = next_pos + 1;
-        }
-        // Añadir último campo
-        campos.push_back(linea.substr(pos));
+private:
+    uint64_t estado;
+};
 
-        // Parseo robusto con conversiones seguras
-        try {
-            // Funciones lambda para conversiones seguras
-            auto safe_stoi = [](const string& s) { 
-                return s.empty() ? 0 : stoi(s); 
-            };
+// Escribe un CSV con el esquema de spotify_data.csv y `filas` canciones
+// inventadas. Con la misma semilla el archivo es siempre el mismo. Los
+// track_id no se repiten; los artistas son unos filas / 10 y los más
+// populares tienen más canciones.
+void generar_csv_sintetico(const string& ruta, size_t filas, uint64_t semilla = 1) {
+    static const char* const generos[] = {
+        "acoustic", "afrobeat", "alt-rock", "ambient", "black-metal", "blues", "breakbeat",
+        "cantopop", "chill", "classical", "club", "country", "dance", "dancehall",
+        "death-metal", "deep-house", "disco", "drum-and-bass", "dub", "dubstep", "edm",
+        "electro", "electronic", "emo", "folk", "funk", "garage", "gospel", "goth",
+        "grindcore", "groove", "guitar", "hard-rock", "hardcore", "hardstyle",
+        "heavy-metal", "hip-hop", "house", "indian", "indie-pop", "industrial", "jazz",
+        "k-pop", "metal", "metalcore", "minimal-techno", "new-age", "opera", "party",
+        "piano", "pop", "pop-film", "power-pop", "progressive-house", "psych-rock",
+        "punk", "punk-rock", "rock", "rock-n-roll", "romance", "sad", "salsa", "samba",
+        "sertanejo", "show-tunes", "singer-songwriter", "ska", "sleep", "songwriter",
+        "soul", "spanish", "swedish", "tango", "techno", "trance", "trip-hop"};
+    static const char* const silabas[] = {
+        "la", "mi", "so", "ra", "ne", "to", "ka", "lu", "ve", "do", "ri", "sa", "mo",
+        "ta", "be", "no", "chi", "el", "an", "or", "go", "pa", "zu", "fe", "qui", "ro"};
+    static const char caracteres[] =
+        "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    constexpr size_t NUM_GENEROS = sizeof(generos) / sizeof(generos[0]);
+    constexpr size_t NUM_SILABAS = sizeof(silabas) / sizeof(silabas[0]);
+
+    GeneradorDeterminista generador(semilla);
+    auto palabras = [&](size_t minimo, size_t maximo) {
+        string texto;
+        size_t cantidad = minimo + generador.entero(maximo - minimo + 1);
+        for (size_t p = 0; p < cantidad; ++p) {
+            if (p > 0) {
+                texto += ' ';
+            }
+            size_t inicio = texto.size();
+            for (size_t s = 1 + generador.entero(3); s > 0; --s) {
+                texto += silabas[generador.entero(NUM_SILABAS)];
+            }
+            texto[inicio] = static_cast<char>(toupper(static_cast<unsigned char>(texto[inicio])));
+        }
+        return texto;
+    };
 
-            auto safe_stof = [](const string& s) { 
-                return s.empty() ? 0.0f : stof(s); 
-            };
+    vector<string> artistas(max<size_t>(1, filas / 10));
+    for (auto& artista : artistas) {
+        artista = palabras(1, 2);
+    }
 
-            // Construcción de Cancion con move semántics
-            canciones.emplace_back(
-                move(campos[1]),    // artist_name
-                move(campos[2]),    // track_name
-                move(campos[3]),    // track_id
-                safe_stoi(campos[4]),   // popularity
-                safe_stoi(campos[5]),   // anio
-                move(campos[6]),    // genre
-                safe_stof(campos[7]),   // danceability
-                safe_stof(campos[8]),   // energy
-                safe_stoi(campos[9]),   // key
-                safe_stof(campos[10]),  // loudness
-                safe_stoi(campos[11]),  // mode
-                safe_stof(campos[12]),  // speechiness
-                safe_stof(campos[13]),  // acousticness
-                safe_stof(campos[14]),  // instrumentalness
-                safe_stof(campos[15]),  // liveness
-                safe_stof(campos[16]),  // valence
-                safe_stof(campos[17]),  // tempo
-                safe_stoi(campos[18]),  // duration_ms
-                4                       // default time_signature
-            );
+    ofstream archivo(ruta, ios::binary);
+    if (!archivo) {
+        throw runtime_error("No se pudo crear " + ruta);
+    }
+    string bloque = ",artist_name,track_name,track_id,popularity,year,genre,danceability,energy,"
+                    "key,loudness,mode,speechiness,acousticness,instrumentalness,liveness,"
+                    "valence,tempo,duration_ms,time_signature\n";
+    char numeros[256];
+    for (size_t i = 0; i < filas; ++i) {
+        // El cuadrado de un real uniforme reparte más canciones a los primeros artistas
+        double sesgo = generador.real();
+        const string& artista = artistas[static_cast<size_t>(sesgo * sesgo * artistas.size())];
+
+        // 11 caracteres de una biyección del número de fila (únicos) y 11 al azar
+        char track_id[23];
+        uint64_t unico = GeneradorDeterminista::mezclar(i ^ (semilla << 40));
+        uint64_t relleno = generador.siguiente();
+        for (size_t c = 0; c < 11; ++c) {
+            track_id[c] = caracteres[unico % 62];
+            unico /= 62;
+            track_id[11 + c] = caracteres[relleno % 62];
+            relleno /= 62;
+        }
+        track_id[22] = '\0';
+
+        int popularidad = static_cast<int>(100 * pow(generador.real(), 2.0));
+        int anio = 2000 + static_cast<int>(generador.entero(24));
+        const char* genero = generos[generador.entero(NUM_GENEROS)];
+        double baile = generador.real();
+        double energia = generador.real();
+        int tonalidad = static_cast<int>(generador.entero(12));
+        double volumen = -30.0 * generador.real();
+        int modo = static_cast<int>(generador.entero(2));
+        double habla = 0.5 * generador.real();
+        double acustica = generador.real();
+        double instrumental = generador.real();
+        double vivo = generador.real();
+        double valencia = generador.real();
+        double tempo = 60.0 + 140.0 * generador.real();
+        int duracion = 60000 + static_cast<int>(generador.entero(340000));
+        int compas = 3 + static_cast<int>(generador.entero(3));
+
+        bloque += to_string(i);
+        bloque += ',';
+        bloque += artista;
+        bloque += ',';
+        bloque += palabras(1, 3);
+        bloque += ',';
+        bloque += track_id;
+        snprintf(numeros, sizeof(numeros),
+                 ",%d,%d,%s,%.3f,%.3f,%d,%.3f,%d,%.4f,%.4f,%.6f,%.4f,%.4f,%.3f,%d,%d\n",
+                 popularidad, anio, genero, baile, energia, tonalidad, volumen, modo, habla,
+                 acustica, instrumental, vivo, valencia, tempo, duracion, compas);
+        bloque += numeros;
+        if (bloque.size() > (1 << 20)) {
+            archivo.write(bloque.data(), static_cast<streamsize>(bloque.size()));
+            bloque.clear();
+        }
+    }
+    archivo.write(bloque.data(), static_cast<streamsize>(bloque.size()));
+    if (!archivo) {
+        throw runtime_error("No se pudo escribir " + ruta);
+    }
+}
 
-            contador++;
-        } catch (const exception& e) {
-        
+// Resultados de la batería de benchmarks, que se escriben como JSON para
+// comparar una compilación con otra
+class RegistroBenchmarks {
+public:
+    // Mide `operaciones` llamadas a operacion(i), con i de 0 a operaciones - 1.
+    // Lo que devuelve cada llamada se acumula para que el compilador no la descarte.
+    template <typename Operacion>
+    void medir(const string& nombre, const char* tipo, size_t filas, size_t operaciones, Operacion&& operacion) {
+        auto inicio = chrono::steady_clock::now();
+        size_t acumulado = 0;
+        for (size_t i = 0; i < operaciones; ++i) {
+            acumulado += operacion(i);
         }
+        sumidero = sumidero + acumulado;
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - inicio).count();
+        resultados.push_back({nombre, tipo, filas, operaciones, ms});
+        cerr << "  " << nombre << ": " << fixed << setprecision(3) << ms << " ms / "
+             << operaciones << " operaciones\n";
+    }
 
-        // Cada 100,000 registros, muestra progreso
-        if (contador % 100000 == 0) {
-            auto actual = chrono::high_resolution_clock::now();
-            auto duracion = chrono::duration_cast<chrono::milliseconds>(actual - inicio);
-            cout << "Procesados " << contador << " registros. Tiempo: " 
-                 << duracion.count() << " ms\n";
+    string json(uint64_t semilla) const {
+        string salida = "{\n  \"semilla\": " + to_string(semilla) + ",\n  \"compilador\": ";
+#if defined(__VERSION__)
+        escribir_json_texto(salida, __VERSION__);
+#else
+        escribir_json_texto(salida, "desconocido");
+#endif
+        salida += ",\n  \"hilos\": " + to_string(hilos_disponibles()) + ",\n  \"resultados\": [";
+        char numeros[128];
+        for (size_t i = 0; i < resultados.size(); ++i) {
+            const Resultado& r = resultados[i];
+            salida += i > 0 ? ",\n    {\"prueba\": " : "\n    {\"prueba\": ";
+            escribir_json_texto(salida, r.nombre);
+            salida += ", \"tipo\": ";
+            escribir_json_texto(salida, r.tipo);
+            snprintf(numeros, sizeof(numeros),
+                     ", \"filas\": %zu, \"operaciones\": %zu, \"ms_total\": %.3f, \"ns_por_operacion\": %.1f}",
+                     r.filas, r.operaciones, r.ms, r.operaciones ? r.ms * 1e6 / r.operaciones : 0.0);
+            salida += numeros;
         }
+        salida += "\n  ]\n}\n";
+        return salida;
     }
 
-    // Reducir capacidad al tamaño exacto
-    canciones.shrink_to_fit();
+private:
+    struct Resultado {
+        string nombre;
+        const char* tipo;  // "macro" (una operación grande) o "micro"
+        size_t filas;
+        size_t operaciones;
+        double ms;
+    };
+    vector<Resultado> resultados;
+    volatile size_t sumidero = 0;
+};
 
-    // Mostrar estadísticas finales
-    auto fin = chrono::high_resolution_clock::now();
-    auto duracion_total = chrono::duration_cast<chrono::milliseconds>(fin - inicio);
-    
-    cout << "Carga completa. Total canciones: " << canciones.size() 
-         << ". Tiempo total: " << duracion_total.count() << " ms\n";
+// Ejecuta la batería completa sobre un CSV sintético de `filas` canciones
+// (sintetico_<filas>_s<semilla>.csv, que se genera si no existe). La semilla
+// va en el nombre para no medir con datos de otra semilla.
+void benchmark_suite_filas(RegistroBenchmarks& registro, size_t filas, uint64_t semilla) {
+    string ruta = "sintetico_" + to_string(filas) + "_s" + to_string(semilla) + ".csv";
+    error_code error;
+    if (!filesystem::exists(ruta, error)) {
+        cerr << "Generando " << ruta << "...\n";
+        generar_csv_sintetico(ruta, filas, semilla);
+    }
+    cerr << filas << " filas:\n";
+
+    // Carga
+    CatalogoColumnar catalogo;
+    registro.medir("cargar_csv_paralelo", "macro", filas, 1, [&](size_t) {
+        catalogo = cargar_csv_paralelo(ruta);
+        return catalogo.size();
+    });
+    if (filas <= 1000000) {
+        // Con más filas el vector<Cancion> completo no cabe cómodo en memoria
+        registro.medir("cargar_csv", "macro", filas, 1, [&](size_t) { return cargar_csv(ruta).size(); });
+    }
+    ListaReproduccion lista;
+    registro.medir("cargar_catalogo", "macro", filas, 1, [&](size_t) {
+        lista.cargar_catalogo(move(catalogo));
+        return lista.total_canciones;
+    });
+    size_t n = lista.total_canciones;
+    if (n == 0) {
+        return;
+    }
 
-    return canciones;
-}
+    // Consultas con ids, nombres y páginas elegidos al azar, siempre los mismos
+    GeneradorDeterminista generador(semilla);
+    vector<uint32_t> ids = lista.bTree.listar();
+    const size_t operaciones = min<size_t>(n, 100000);
+    vector<uint32_t> muestra(operaciones);
+    for (auto& id : muestra) {
+        id = ids[generador.entero(ids.size())];
+    }
+    vector<string> prefijos(1000);
+    for (auto& prefijo : prefijos) {
+        prefijo = string(lista.catalogo.track_name(ids[generador.entero(ids.size())]).substr(0, 3));
+    }
+    const size_t por_pagina = 50;
+    const size_t paginas = 1000;
+    auto pagina = [&](size_t i) { return 1 + GeneradorDeterminista::mezclar(i) % ((n + por_pagina - 1) / por_pagina); };
+
+    registro.medir("BTree::contiene", "micro", filas, operaciones, [&](size_t i) {
+        return static_cast<size_t>(lista.bTree.contiene(muestra[i]));
+    });
+    registro.medir("buscar_canciones_por_trie", "micro", filas, prefijos.size(), [&](size_t i) {
+        return lista.buscar_canciones_por_trie(prefijos[i]).size();
+    });
+    registro.medir("buscar_top_k", "micro", filas, prefijos.size(), [&](size_t i) {
+        return lista.buscar_top_k(prefijos[i], 10).size();
+    });
+    registro.medir("listar_canciones_paginado", "micro", filas, paginas, [&](size_t i) {
+        return lista.listar_canciones_paginado(pagina(i), por_pagina).canciones.size();
+    });
+    registro.medir("listar_por_popularidad_paginado", "micro", filas, paginas, [&](size_t i) {
+        return lista.listar_por_popularidad_paginado(i % 2 == 0, pagina(i), por_pagina).canciones.size();
+    });
+    registro.medir("listar_por_duracion_paginado", "micro", filas, paginas, [&](size_t i) {
+        return lista.listar_por_duracion_paginado(i % 2 == 0, pagina(i), por_pagina).canciones.size();
+    });
+    registro.medir("obtener_por_anio_paginado", "micro", filas, paginas, [&](size_t i) {
+        return lista.obtener_por_anio_paginado(2000 + static_cast<int>(i % 24), 1 + i % 20, por_pagina).canciones.size();
+    });
+    registro.medir("obtener_por_anios_paginado", "micro", filas, paginas, [&](size_t i) {
+        return lista.obtener_por_anios_paginado(2005, 2015, pagina(i), por_pagina).canciones.size();
+    });
+    registro.medir("listar_cola_paginado", "micro", filas, paginas, [&](size_t i) {
+        return lista.listar_cola_paginado(pagina(i), por_pagina).canciones.size();
+    });
+    FiltroCanciones filtro;
+    filtro.generos = {"rock", "techno"};
+    filtro.anio_desde = 2010;
+    filtro.anio_hasta = 2020;
+    filtro.compases = {3, 4};
+    filtro.rasgos.push_back({8, 110, 140});  // tempo
+    registro.medir("filtrar_paginado", "micro", filas, paginas, [&](size_t i) {
+        return lista.filtrar_paginado(lista.filtrar(filtro), 1 + i % 10, por_pagina).canciones.size();
+    });
+
+    // reproducir_aleatoria escribe en cout; se descarta para medir solo la elección
+    {
+        DesvioSalida descarte(cout, nullptr);
+        registro.medir("reproducir_aleatoria (mezcla)", "micro", filas, operaciones, [&](size_t) {
+            lista.reproducir_aleatoria(false);
+            return 1;
+        });
+        registro.medir("reproducir_aleatoria (ponderada)", "micro", filas, operaciones, [&](size_t) {
+            lista.reproducir_aleatoria(true);
+            return 1;
+        });
+    }
 
-size_t mostrar_menu_navegacion(size_t pagina, size_t total_paginas, bool& navegando) {
-    cout << "\nOpciones:\n";
-    cout << "1. Página siguiente\n";
-    cout << "2. Página anterior\n";
-    cout << "3. Ir a página específica\n";
-    cout << "4. Salir\n";
+    // Modificaciones: mover, y eliminar una décima parte para volver a agregarla
+    vector<string> track_ids;
+    for (uint32_t id : muestra) {
+        track_ids.emplace_back(lista.catalogo.track_id(id));
+    }
+    registro.medir("mover_cancion", "micro", filas, operaciones, [&](size_t i) {
+        return lista.mover_cancion(track_ids[i], GeneradorDeterminista::mezclar(i) % n);
+    });
+    vector<Cancion> quitadas;
+    unordered_set<string> vistas;
+    for (size_t i = 0; i < track_ids.size() && quitadas.size() < n / 10; ++i) {
+        if (vistas.insert(track_ids[i]).second) {
+            quitadas.push_back(*lista.buscar(track_ids[i]));
+        }
+    }
+    registro.medir("eliminar_cancion", "micro", filas, quitadas.size(), [&](size_t i) {
+        return static_cast<size_t>(lista.eliminar_cancion(quitadas[i].track_id));
+    });
+    registro.medir("agregar_cancion", "micro", filas, quitadas.size(), [&](size_t i) {
+        return static_cast<size_t>(lista.agregar_cancion(quitadas[i]));
+    });
+}
 
-    int opcion;
-    cin >> opcion;
+// Batería completa para cada tamaño; el JSON va a `ruta_json` o, si está
+// vacía, a la salida estándar. El progreso va a la salida de errores.
+void benchmark_suite(const vector<size_t>& tamanos, const string& ruta_json, uint64_t semilla = 1) {
+    RegistroBenchmarks registro;
+    {
+        DesvioSalida desvio(cout, cerr.rdbuf());
+        for (size_t filas : tamanos) {
+            benchmark_suite_filas(registro, filas, semilla);
+        }
+    }
 
-    switch (opcion) {
-        case 1:
-            return min(pagina + 1, total_paginas);
-        case 2:
-            return max(pagina - 1, static_cast<size_t>(1));
-        case 3:
-            cout << "Ingrese el número de página (1-" << total_paginas << "): ";
-            cin >> pagina;
-            return min(max(pagina, static_cast<size_t>(1)), total_paginas);
-        case 4:
-            navegando = false;
-            return pagina;
-        default:
-            return pagina;
+    string json = registro.json(semilla);
+    if (ruta_json.empty()) {
+        cout << json;
+        return;
+    }
+    ofstream archivo(ruta_json);
+    archivo << json;
+    if (!archivo) {
+        throw runtime_error("No se pudo escribir " + ruta_json);
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        string modo = argv[1];
+        string archivo = argc > 2 ? argv[2] : "spotify_data.csv";
+        try {
+            if (modo == "--benchmark-carga") {
+                benchmark_carga_masiva(archivo);
+            } else if (modo == "--benchmark-ingesta") {
+                benchmark_ingesta(archivo);
+            } else if (modo == "--benchmark-instantanea") {
+                benchmark_instantanea(archivo);
+            } else if (modo == "--benchmark-trie") {
+                benchmark_trie(archivo);
+            } else if (modo == "--benchmark-arbol") {
+                benchmark_arbol(archivo);
+            } else if (modo == "--pruebas") {
+                return ejecutar_pruebas() == 0 ? 0 : 1;
+            } else if (modo == "--benchmark-cola") {
+                benchmark_cola(archivo);
+            } else if (modo == "--benchmark-reproduccion") {
+                benchmark_reproduccion(archivo);
+            } else if (modo == "--benchmark-similares") {
+                benchmark_similares(archivo);
+            } else if (modo == "--benchmark-vecinos") {
+                benchmark_vecinos(archivo);
+            } else if (modo == "--benchmark-filtros") {
+                benchmark_filtros(archivo);
+            } else if (modo == "--benchmark-agrupar") {
+                benchmark_agrupar(archivo);
+            } else if (modo == "--benchmark-concurrencia") {
+                benchmark_concurrencia(archivo);
+            } else if (modo == "--generar-csv" && argc > 3) {
+                size_t filas;
+                uint64_t semilla = 1;
+                if (!leer_numero(string_view(argv[3]), filas) ||
+                    (argc > 4 && !leer_numero(string_view(argv[4]), semilla))) {
+                    cerr << "Uso: --generar-csv <archivo.csv> <filas> [semilla]\n";
+                    return 1;
+                }
+                generar_csv_sintetico(argv[2], filas, semilla);
+            } else if (modo == "--benchmark-suite") {
+                vector<size_t> tamanos = {10000, 100000, 1000000};
+                if (argc > 2) {
+                    tamanos.clear();
+                    for (const string& valor : leer_lista(argv[2])) {
+                        size_t filas;
+                        if (!leer_numero(valor, filas) || filas == 0) {
+                            cerr << "Tamaño inválido: " << valor << '\n';
+                            return 1;
+                        }
+                        tamanos.push_back(filas);
+                    }
+                }
+                uint64_t semilla = 1;
+                if (argc > 4 && !leer_numero(string_view(argv[4]), semilla)) {
+                    cerr << "Semilla inválida: " << argv[4] << '\n';
+                    return 1;
+                }
+                benchmark_suite(tamanos, argc > 3 ? argv[3] : "", semilla);
+            } else if (modo == "--servidor") {
+                ejecutar_servidor(argc > 2 ? argv[2] : "", "");
+            } else if (modo == "--servidor-socket" && argc > 2) {
+                ejecutar_servidor(argc > 3 ? argv[3] : "", argv[2]);
+            } else {
+                cerr << "Opción desconocida: " << modo << '\n';
+                return 1;
+            }
+        } catch (exception& e) {
+            cerr << "Error: " << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
     try {
         ListaReproduccion playlist;
         bool running = true;
@@ -785,7 +8645,11 @@ int main() {
             cout << "7. Mover una canción\n";
             cout << "8. Reproducir canción aleatoria\n";
             cout << "9. Buscar canciones por prefijo\n";
-            cout << "10. Salir\n";
+            cout << "10. Buscar canciones similares\n";
+            cout << "11. Radio: canciones similares (búsqueda aproximada)\n";
+            cout << "12. Filtrar canciones\n";
+            cout << "13. Estadísticas por grupo\n";
+            cout << "14. Salir\n";
             cout << "Seleccione una opción: ";
 
             int opcion;
@@ -796,10 +8660,7 @@ int main() {
                     string file_path = "spotify_data.csv";
                     
                     try {
-                        auto canciones = cargar_csv(file_path);
-                        for (auto& cancion : canciones) {
-                            playlist.agregar_cancion(cancion);
-                        }
+                        cargar_canciones(playlist, file_path);
                         cout << "Canciones cargadas exitosamente.\n";
                     } catch (const runtime_error& e) {
                         cerr << e.what() << '\n';
@@ -856,7 +8717,8 @@ int main() {
                         cout << "2. Ordenar por Popularidad (Ascendente)\n";
                         cout << "3. Ordenar por Duración (Descendente)\n";
                         cout << "4. Ordenar por Duración (Ascendente)\n";
-                        cout << "5. Volver al menú principal\n";
+                        cout << "5. Orden de la cola de reproducción\n";
+                        cout << "6. Volver al menú principal\n";
                         cout << "Seleccione una opción: ";
 
                         int opcion_ordenamiento;
@@ -930,7 +8792,23 @@ int main() {
                                 }
                                 break;
                             }
-                            case 5:
+                            case 5: { // Cola de reproducción, con la posición de cada canción
+                                while (navegando) {
+                                    auto resultado = playlist.listar_cola_paginado(pagina);
+
+                                    cout << "\nPágina " << resultado.pagina_actual << " de " << resultado.total_paginas 
+                                         << " (Total canciones: " << resultado.total_canciones << ")\n";
+
+                                    size_t posicion = (resultado.pagina_actual - 1) * 200;
+                                    for (auto& cancion : resultado.canciones) {
+                                        cout << posicion++ << ". " << cancion.track_name << " - " << cancion.artist_name << "\n";
+                                    }
+
+                                    pagina = mostrar_menu_navegacion(pagina, resultado.total_paginas, navegando);
+                                }
+                                break;
+                            }
+                            case 6:
                                 ordenando = false;
                                 break;
                             default:
@@ -940,17 +8818,24 @@ int main() {
                     break;
                 }           
                 case 4: { // Buscar canciones por año con paginación
-                    int anio;
-                    cout << "Ingrese el año: ";
-                    cin >> anio;
+                    string entrada;
+                    cout << "Ingrese el año o un rango (por ejemplo 2010-2015): ";
+                    cin >> entrada;
+
+                    int desde, hasta;
+                    if (!leer_rango_anios(entrada, desde, hasta)) {
+                        cout << "Año inválido.\n";
+                        break;
+                    }
 
                     size_t pagina = 1;
                     bool navegando = true;
                     while (navegando) {
-                        auto resultado = playlist.obtener_por_anio_paginado(anio, pagina);
+                        auto resultado = playlist.obtener_por_anios_paginado(desde, hasta, pagina);
 
                         cout << "\nPágina " << resultado.pagina_actual << " de " << resultado.total_paginas 
-                             << " (Total canciones del año " << anio << ": " << resultado.total_canciones << ")\n";
+                             << " (Total canciones " << (desde == hasta ? "del año " : "de los años ") << entrada
+                             << ": " << resultado.total_canciones << ")\n";
 
                         for (auto& cancion : resultado.canciones) {
                             cout << cancion.track_name << " - " << cancion.artist_name << "\n";
@@ -1021,8 +8906,11 @@ int main() {
                     }
 
                     // Agregar la canción seleccionada a la playlist
-                    playlist.agregar_cancion(resultados[seleccion - 1]);
-                    cout << "Canción agregada exitosamente.\n";
+                    if (playlist.agregar_cancion(resultados[seleccion - 1])) {
+                        cout << "Canción agregada exitosamente.\n";
+                    } else {
+                        cout << "La canción ya está en la lista.\n";
+                    }
                     break;
                 }               
                 case 6: { // Eliminar una canción
@@ -1065,7 +8953,10 @@ int main() {
                 break;
                 }  
                 case 8: { // Reproducir canción aleatoria
-                    playlist.reproducir_aleatoria();
+                    int modo_aleatorio;
+                    cout << "Reproducir:\n1. Mezcla (sin repetir hasta escuchar todas)\n2. Ponderada por popularidad\nElija una opción: ";
+                    cin >> modo_aleatorio;
+                    playlist.reproducir_aleatoria(modo_aleatorio == 2);
                     break;
                 }
                 case 9: { // Buscar canciones por prefijo
@@ -1092,7 +8983,168 @@ int main() {
                     }
                     break;
                 }
-                case 10: { // Salir
+                case 10: { // Buscar canciones similares
+                    string track_id;
+                    size_t k;
+                    int ajustar;
+                    cout << "Ingrese el track_id de la canción: ";
+                    cin >> track_id;
+                    cout << "¿Cuántas canciones similares? ";
+                    cin >> k;
+                    cout << "Pesos de los rasgos:\n1. Todos iguales\n2. Ingresar cada uno\nElija una opción: ";
+                    cin >> ajustar;
+
+                    MatrizRasgos::Pesos pesos = MatrizRasgos::pesos_iguales();
+                    if (ajustar == 2) {
+                        for (size_t f = 0; f < MatrizRasgos::NUM_RASGOS; ++f) {
+                            cout << "Peso de " << MatrizRasgos::nombre_rasgo(f) << ": ";
+                            cin >> pesos[f];
+                        }
+                    }
+
+                    try {
+                        vector<Cancion> similares = playlist.buscar_similares(track_id, k, pesos);
+                        cout << "Canciones similares:\n";
+                        for (size_t i = 0; i < similares.size(); ++i) {
+                            cout << i + 1 << ". " << similares[i].track_name << " - "
+                                 << similares[i].artist_name << " (ID: " << similares[i].track_id << ")\n";
+                        }
+                    } catch (const runtime_error& e) {
+                        cout << e.what() << ".\n";
+                    }
+                    break;
+                }
+                case 11: { // Radio: canciones similares con el grafo HNSW
+                    string track_id;
+                    size_t k;
+                    cout << "Ingrese el track_id de la canción: ";
+                    cin >> track_id;
+                    cout << "¿Cuántas canciones? ";
+                    cin >> k;
+
+                    try {
+                        bool construir = !playlist.indice_vecinos_listo();
+                        if (construir) {
+                            cout << "Construyendo el índice de vecinos...\n";
+                            playlist.construir_indice_vecinos();
+                        }
+                        vector<Cancion> radio = playlist.buscar_similares_aproximado(track_id, k);
+                        cout << "Radio:\n";
+                        for (size_t i = 0; i < radio.size(); ++i) {
+                            cout << i + 1 << ". " << radio[i].track_name << " - "
+                                 << radio[i].artist_name << " (ID: " << radio[i].track_id << ")\n";
+                        }
+                        if (construir && csv_cargado) {
+                            playlist.guardar_indice_vecinos(playlist.ruta_csv + ".hnsw", playlist.ruta_csv);
+                        }
+                    } catch (const runtime_error& e) {
+                        cout << e.what() << ".\n";
+                    }
+                    break;
+                }
+                case 12: { // Filtrar por género, año, tonalidad, modo, compás y rasgos
+                    FiltroCanciones filtro;
+                    string entrada;
+                    cout << "Los campos aceptan - (cualquiera) o varios valores separados por comas.\n";
+                    cout << "Género: ";
+                    cin >> entrada;
+                    filtro.generos = leer_lista(entrada);
+                    cout << "Año o rango (por ejemplo 2015-2020): ";
+                    cin >> entrada;
+                    if (entrada != "-" && !leer_rango_anios(entrada, filtro.anio_desde, filtro.anio_hasta)) {
+                        cout << "Año inválido.\n";
+                        break;
+                    }
+                    bool valido = true;
+                    cout << "Tonalidad (0-11): ";
+                    cin >> entrada;
+                    valido = valido && leer_lista_numeros(entrada, filtro.tonalidades);
+                    cout << "Modo (0 menor, 1 mayor): ";
+                    cin >> entrada;
+                    valido = valido && leer_lista_numeros(entrada, filtro.modos);
+                    cout << "Compás (time_signature): ";
+                    cin >> entrada;
+                    valido = valido && leer_lista_numeros(entrada, filtro.compases);
+                    if (!valido) {
+                        cout << "Valor inválido.\n";
+                        break;
+                    }
+                    while (true) {
+                        cout << "Condición sobre un rasgo:\n";
+                        for (size_t f = 0; f < MatrizRasgos::NUM_RASGOS; ++f) {
+                            cout << f + 1 << ". " << MatrizRasgos::nombre_rasgo(f) << "\n";
+                        }
+                        cout << "0. Ninguna más\nElija una opción: ";
+                        size_t rasgo;
+                        cin >> rasgo;
+                        if (rasgo == 0 || rasgo > MatrizRasgos::NUM_RASGOS) {
+                            break;
+                        }
+                        FiltroCanciones::RangoRasgo rango{rasgo - 1, 0, 0};
+                        cout << "Mínimo y máximo (incluidos): ";
+                        cin >> rango.minimo >> rango.maximo;
+                        filtro.rasgos.push_back(rango);
+                    }
+
+                    auto inicio = chrono::high_resolution_clock::now();
+                    CursorFiltro cursor = playlist.filtrar(filtro);
+                    auto fin = chrono::high_resolution_clock::now();
+                    cout << cursor.total() << " canciones cumplen el filtro ("
+                         << chrono::duration<double, milli>(fin - inicio).count() << " ms)\n";
+
+                    size_t pagina = 1;
+                    bool navegando = cursor.total() > 0;
+                    while (navegando) {
+                        auto resultado = playlist.filtrar_paginado(cursor, pagina);
+                        cout << "\nPágina " << resultado.pagina_actual << " de " << resultado.total_paginas
+                             << " (Total canciones: " << resultado.total_canciones << ")\n";
+                        for (auto& cancion : resultado.canciones) {
+                            cout << cancion.track_name << " - " << cancion.artist_name << " (" << cancion.genre
+                                 << ", " << cancion.anio << ")\n";
+                        }
+                        pagina = mostrar_menu_navegacion(pagina, resultado.total_paginas, navegando);
+                    }
+                    break;
+                }
+                case 13: { // Estadísticas por género, año o artista
+                    int tipo;
+                    cout << "Agrupar por:\n1. Género\n2. Año\n3. Artista\nElija una opción: ";
+                    cin >> tipo;
+                    if (tipo < 1 || tipo > 3) {
+                        cout << "Opción inválida.\n";
+                        break;
+                    }
+                    cout << "Medida:\n";
+                    for (size_t m = 0; m < static_cast<size_t>(Medida::NUM_MEDIDAS); ++m) {
+                        cout << m + 1 << ". " << nombre_medida(static_cast<Medida>(m)) << "\n";
+                    }
+                    cout << "Elija una opción: ";
+                    size_t opcion_medida;
+                    cin >> opcion_medida;
+                    if (opcion_medida < 1 || opcion_medida > static_cast<size_t>(Medida::NUM_MEDIDAS)) {
+                        cout << "Opción inválida.\n";
+                        break;
+                    }
+                    Medida medida = static_cast<Medida>(opcion_medida - 1);
+
+                    auto inicio = chrono::high_resolution_clock::now();
+                    auto grupos = playlist.agrupar(static_cast<Agrupacion>(tipo - 1), medida, {0.5, 0.9});
+                    auto fin = chrono::high_resolution_clock::now();
+                    cout << grupos.size() << " grupos ("
+                         << chrono::duration<double, milli>(fin - inicio).count() << " ms)\n";
+                    const size_t mostrar = 30;
+                    for (size_t i = 0; i < grupos.size() && i < mostrar; ++i) {
+                        const auto& grupo = grupos[i];
+                        cout << grupo.grupo << ": " << grupo.cantidad << " canciones, media " << grupo.media
+                             << ", mín " << grupo.minimo << ", máx " << grupo.maximo
+                             << ", mediana " << grupo.cuantiles[0] << ", p90 " << grupo.cuantiles[1] << "\n";
+                    }
+                    if (grupos.size() > mostrar) {
+                        cout << "... y " << grupos.size() - mostrar << " grupos más\n";
+                    }
+                    break;
+                }
+                case 14: { // Salir
                     running = false;
                     cout << "Saliendo del programa...\n";
                     break;